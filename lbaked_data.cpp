@@ -0,0 +1,383 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "lbaked_data.h"
+#include "ldebug.h"
+#include "core/os/file_access.h"
+#include "core/os/mutex.h"
+#include "core/math/aabb.h"
+#include "core/math/plane.h"
+
+// the endian check is stored raw, a file from a platform with different endianness will fail to load
+const char LBakedData::m_szMagic[4] = {'L', 'P', 'R', 'B'};
+const int32_t LBakedData::m_iEndianCheck = 0x01020304;
+
+LVector<LBakedData *> LBakedData::m_Shared;
+Mutex * LBakedData::m_pSharedMutex = 0;
+
+
+void LBakedData::Shared_Create()
+{
+	m_pSharedMutex = Mutex::create();
+}
+
+void LBakedData::Shared_Destroy()
+{
+	// any still acquired are leaked by the room managers, just forget them
+	m_Shared.clear(true);
+
+	if (m_pSharedMutex)
+	{
+		memdelete(m_pSharedMutex);
+		m_pSharedMutex = 0;
+	}
+}
+
+LBakedData * LBakedData::Acquire(String szFilename)
+{
+	// held while loading, so two managers loading the same file at once only read it once
+	m_pSharedMutex->lock();
+
+	for (int n=0; n<m_Shared.size(); n++)
+	{
+		LBakedData * pData = m_Shared[n];
+		if (pData->m_szFilename == szFilename)
+		{
+			pData->m_iRefCount++;
+			m_pSharedMutex->unlock();
+			return pData;
+		}
+	}
+
+	LBakedData * pData = memnew(LBakedData);
+	if (pData->Load(szFilename))
+	{
+		pData->m_szFilename = szFilename;
+		pData->m_iRefCount = 1;
+		m_Shared.push_back(pData);
+	}
+	else
+	{
+		memdelete(pData);
+		pData = 0;
+	}
+
+	m_pSharedMutex->unlock();
+	return pData;
+}
+
+void LBakedData::Release()
+{
+	m_pSharedMutex->lock();
+
+	m_iRefCount--;
+	bool bDelete = m_iRefCount == 0;
+
+	if (bDelete)
+	{
+		int id = m_Shared.find(this);
+		if (id != -1)
+			m_Shared.remove_unsorted(id);
+	}
+
+	m_pSharedMutex->unlock();
+
+	if (bDelete)
+		memdelete(this);
+}
+
+void LBakedData::Shared_Forget(String szFilename)
+{
+	m_pSharedMutex->lock();
+
+	// current users keep their block, it is freed on the last release as usual
+	for (int n=0; n<m_Shared.size(); n++)
+	{
+		if (m_Shared[n]->m_szFilename == szFilename)
+		{
+			m_Shared.remove_unsorted(n);
+			break;
+		}
+	}
+
+	m_pSharedMutex->unlock();
+}
+
+LBakedData::LBakedData()
+{
+	m_iRefCount = 0;
+	m_pBlock = 0;
+	m_pHeader = 0;
+}
+
+String LBakedData::GetString(int32_t id) const
+{
+	if ((id < 0) || (id >= GetNum(SEC_STRINGS)))
+		return "";
+
+	const LSpan &span = Get<LSpan>(SEC_STRINGS)[id];
+	return String::utf8(Get<char>(SEC_CHARS) + span.m_First, span.m_Num);
+}
+
+bool LBakedData::Span_IsValid(const LSpan &span, int pool_size)
+{
+	if ((span.m_First < 0) || (span.m_Num < 0))
+		return false;
+
+	return span.m_Num <= (pool_size - span.m_First);
+}
+
+bool LBakedData::Load(String szFilename)
+{
+	Error err;
+	FileAccess * pFile = FileAccess::open(szFilename, FileAccess::READ, &err);
+	if (!pFile)
+	{
+		LWARN(2, "LBakedData : could not open file : " + szFilename);
+		return false;
+	}
+
+	// the whole file in one read
+	uint64_t len = pFile->get_len();
+	bool bOK = (len >= sizeof (LHeader)) && (len < 0x7fffffff);
+	if (bOK)
+	{
+		m_Block.resize(len);
+		bOK = pFile->get_buffer(&m_Block[0], len) == (int) len;
+	}
+
+	pFile->close();
+	memdelete(pFile);
+
+	if (bOK)
+	{
+		m_pBlock = &m_Block[0];
+		m_pHeader = (const LHeader *) m_pBlock;
+		bOK = Validate();
+	}
+
+	if (!bOK)
+	{
+		LWARN(2, "LBakedData : file is invalid or from an old version, reconvert : " + szFilename);
+		m_Block.clear(true);
+		m_pBlock = 0;
+		m_pHeader = 0;
+		return false;
+	}
+
+	return true;
+}
+
+bool LBakedData::Validate_Sections() const
+{
+	const LHeader &header = *m_pHeader;
+
+	if (memcmp(header.m_szMagic, m_szMagic, 4) != 0)
+		return false;
+
+	if ((header.m_Version != BAKED_VERSION) || (header.m_EndianCheck != m_iEndianCheck))
+		return false;
+
+	if ((header.m_SizeRoom != sizeof (LRecRoom)) ||
+		(header.m_SizePortal != sizeof (LRecPortal)) ||
+		(header.m_SizeSob != sizeof (LRecSob)) ||
+		(header.m_SizeLight != sizeof (LRecLight)) ||
+		(header.m_SizeArea != sizeof (LRecArea)) ||
+		(header.m_SizeReal != sizeof (real_t)))
+		return false;
+
+	if (header.m_BlockSize != m_Block.size())
+		return false;
+
+	const int sizes[NUM_SECTIONS] =
+	{
+		sizeof (LRecRoom),
+		sizeof (LRecPortal),
+		sizeof (LRecSob),
+		sizeof (AABB),
+		sizeof (LRecLight),
+		sizeof (LRecArea),
+		sizeof (uint32_t),
+		sizeof (uint32_t),
+		sizeof (uint32_t),
+		sizeof (uint32_t),
+		sizeof (int32_t),
+		sizeof (Plane),
+		sizeof (Vector3),
+		sizeof (int32_t),
+		sizeof (LSpan),
+		sizeof (char),
+	};
+
+	for (int s=0; s<NUM_SECTIONS; s++)
+	{
+		const LSection &sec = header.m_Sections[s];
+
+		// sections are aligned so the pools can be used in place
+		if ((sec.m_Offset < (int) sizeof (LHeader)) || (sec.m_Offset & (SECTION_ALIGN - 1)) || (sec.m_Num < 0))
+			return false;
+
+		if ((uint64_t) sec.m_Offset + ((uint64_t) sec.m_Num * sizes[s]) > (uint64_t) m_Block.size())
+			return false;
+	}
+
+	return true;
+}
+
+bool LBakedData::Ints_AreIDsValid(const LSpan &span, int num_ids) const
+{
+	if (!Span_IsValid(span, GetNum(SEC_INTS)))
+		return false;
+
+	const int32_t * pInts = Get<int32_t>(SEC_INTS) + span.m_First;
+	for (int n=0; n<span.m_Num; n++)
+	{
+		if ((pInts[n] < 0) || (pInts[n] >= num_ids))
+			return false;
+	}
+
+	return true;
+}
+
+// check all the cross references are in range, once on load, so a corrupt file can't crash at runtime
+bool LBakedData::Validate() const
+{
+	if (!Validate_Sections())
+		return false;
+
+	int nRooms = GetNum(SEC_ROOMS);
+	int nPortals = GetNum(SEC_PORTALS);
+	int nSOBs = GetNum(SEC_SOBS);
+	int nLights = GetNum(SEC_LIGHTS);
+	int nAreas = GetNum(SEC_AREAS);
+	int nInts = GetNum(SEC_INTS);
+	int nPlanes = GetNum(SEC_PLANES);
+	int nVerts = GetNum(SEC_VERTS);
+	int nStrings = GetNum(SEC_STRINGS);
+	const int32_t * pInts = Get<int32_t>(SEC_INTS);
+
+	if (!nRooms || (GetNum(SEC_SOB_AABBS) != nSOBs))
+		return false;
+
+	const LSpan * pStrings = Get<LSpan>(SEC_STRINGS);
+	for (int n=0; n<nStrings; n++)
+	{
+		if (!Span_IsValid(pStrings[n], GetNum(SEC_CHARS)))
+			return false;
+	}
+
+	const LRecRoom * pRooms = Get<LRecRoom>(SEC_ROOMS);
+
+	// the public room IDs must be a permutation of the room IDs
+	LVector<int> public_ids;
+	public_ids.resize(nRooms);
+	for (int n=0; n<nRooms; n++)
+		public_ids[n] = 0;
+
+	for (int n=0; n<nRooms; n++)
+	{
+		const LRecRoom &rec = pRooms[n];
+
+		if ((rec.m_PublicID < 0) || (rec.m_PublicID >= nRooms) || public_ids[rec.m_PublicID]) return false;
+		public_ids[rec.m_PublicID] = 1;
+
+		if (!Span_IsValid(rec.m_SOBs, nSOBs)) return false;
+		if (!Span_IsValid(rec.m_Portals, nPortals)) return false;
+		if (!Span_IsValid(rec.m_ShadowCasters, GetNum(SEC_SHADOW_CASTERS))) return false;
+		if (!Span_IsValid(rec.m_Planes, nPlanes)) return false;
+		if (!Span_IsValid(rec.m_BoundVerts, nVerts)) return false;
+		if (!Span_IsValid(rec.m_BoundFacePlanes, nPlanes)) return false;
+		if (!Span_IsValid(rec.m_BoundFaces, nInts)) return false;
+		if (!Ints_AreIDsValid(rec.m_LocalLights, nLights)) return false;
+		if (!Ints_AreIDsValid(rec.m_GlobalLights, nLights)) return false;
+		if (!Ints_AreIDsValid(rec.m_Areas, nAreas)) return false;
+
+		// faces are a count followed by the indices
+		int nBoundVerts = rec.m_BoundVerts.m_Num;
+		int nFaces = 0;
+		int i = rec.m_BoundFaces.m_First;
+		int iEnd = i + rec.m_BoundFaces.m_Num;
+		while (i < iEnd)
+		{
+			int nIndices = pInts[i++];
+			if ((nIndices < 0) || (nIndices > (iEnd - i)))
+				return false;
+
+			for (int c=0; c<nIndices; c++)
+			{
+				int index = pInts[i++];
+				if ((index < 0) || (index >= nBoundVerts))
+					return false;
+			}
+			nFaces++;
+		}
+		if (nFaces != rec.m_BoundFacePlanes.m_Num)
+			return false;
+	}
+
+	const LRecPortal * pPortals = Get<LRecPortal>(SEC_PORTALS);
+	for (int n=0; n<nPortals; n++)
+	{
+		const LRecPortal &rec = pPortals[n];
+		if ((rec.m_RoomNum < 0) || (rec.m_RoomNum >= nRooms)) return false;
+		if (!Span_IsValid(rec.m_Verts, nVerts)) return false;
+	}
+
+	const LRecLight * pLights = Get<LRecLight>(SEC_LIGHTS);
+	for (int n=0; n<nLights; n++)
+	{
+		const LRecLight &rec = pLights[n];
+		if ((rec.m_RoomID < -1) || (rec.m_RoomID >= nRooms)) return false;
+		if ((rec.m_AreaID < -1) || (rec.m_AreaID >= nAreas)) return false;
+		if (!Span_IsValid(rec.m_Casters, GetNum(SEC_LIGHT_CASTERS))) return false;
+		if (!Ints_AreIDsValid(rec.m_AffectedRooms, nRooms)) return false;
+	}
+
+	const LRecArea * pAreas = Get<LRecArea>(SEC_AREAS);
+	for (int n=0; n<nAreas; n++)
+	{
+		const LRecArea &rec = pAreas[n];
+		if (!Span_IsValid(rec.m_Rooms, GetNum(SEC_AREA_ROOMS))) return false;
+		if (!Span_IsValid(rec.m_Lights, GetNum(SEC_AREA_LIGHTS))) return false;
+	}
+
+	// flat lists of IDs
+	const eSection id_sections[4] = {SEC_LIGHT_CASTERS, SEC_SHADOW_CASTERS, SEC_AREA_LIGHTS, SEC_AREA_ROOMS};
+	const int id_limits[4] = {nSOBs, nSOBs, nLights, nRooms};
+	for (int s=0; s<4; s++)
+	{
+		const uint32_t * pIDs = Get<uint32_t>(id_sections[s]);
+		for (int n=0; n<GetNum(id_sections[s]); n++)
+		{
+			if (pIDs[n] >= (uint32_t) id_limits[s])
+				return false;
+		}
+	}
+
+	const int32_t * pDeleted = Get<int32_t>(SEC_DELETED_NODES);
+	for (int n=0; n<GetNum(SEC_DELETED_NODES); n++)
+	{
+		if ((pDeleted[n] < 0) || (pDeleted[n] >= nStrings))
+			return false;
+	}
+
+	return true;
+}
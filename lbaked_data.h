@@ -0,0 +1,193 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+#include "core/ustring.h"
+#include "core/math/aabb.h"
+#include "core/math/plane.h"
+
+class Mutex;
+
+// A read only block of converted level data, as saved by LRoomBaker.
+// The whole file is read into the block in one go, and used in place. All references within the block
+// are byte offsets from the start, or indices, so the block is relocatable (and could be memory mapped).
+// The geometry pools are stored as the engine types (so depend on the size of real_t), and the rooms,
+// portals and SOBs refer to their planes, verts and bounds in the block rather than taking copies.
+// Room managers loading the same file share the block, it is freed when the last one releases it.
+class LBakedData
+{
+public:
+	enum
+	{
+		// increment this whenever the file layout changes, old files will fail to load
+		BAKED_VERSION = 6,
+
+		// sections are aligned for the largest type they contain (real_t may be double)
+		SECTION_ALIGN = 8,
+	};
+
+	enum eSection
+	{
+		SEC_ROOMS,
+		SEC_PORTALS,
+		SEC_SOBS,
+		SEC_SOB_AABBS, // AABB, one per SOB
+		SEC_LIGHTS,
+		SEC_AREAS,
+		SEC_LIGHT_CASTERS, // uint32_t
+		SEC_SHADOW_CASTERS, // uint32_t
+		SEC_AREA_LIGHTS, // uint32_t
+		SEC_AREA_ROOMS, // uint32_t
+		SEC_INTS, // int32_t pool
+		SEC_PLANES, // Plane pool
+		SEC_VERTS, // Vector3 pool
+		SEC_DELETED_NODES, // string IDs of the nodes deleted by conversion
+		SEC_STRINGS, // spans in the chars
+		SEC_CHARS, // utf8
+		NUM_SECTIONS,
+	};
+
+	// first and number within a pool
+	struct LSpan
+	{
+		int32_t m_First;
+		int32_t m_Num;
+	};
+
+	struct LSection
+	{
+		int32_t m_Offset; // bytes from the start of the block
+		int32_t m_Num;
+	};
+
+	struct LHeader
+	{
+		char m_szMagic[4];
+		int32_t m_Version;
+		int32_t m_EndianCheck;
+		// record sizes, in case of a layout change without a version bump
+		int32_t m_SizeRoom;
+		int32_t m_SizePortal;
+		int32_t m_SizeSob;
+		int32_t m_SizeLight;
+		int32_t m_SizeArea;
+		int32_t m_SizeReal;
+		int32_t m_BlockSize;
+		LSection m_Sections[NUM_SECTIONS];
+	};
+
+	struct LRecRoom
+	{
+		int32_t m_Path; // string
+		int32_t m_Name; // string
+		int32_t m_PublicID; // room ID used by the API, rooms may be reordered by conversion
+		LSpan m_SOBs;
+		LSpan m_Portals;
+		LSpan m_ShadowCasters;
+		Vector3 m_ptCentre;
+		AABB m_AABB;
+		LSpan m_Planes; // planes
+		LSpan m_LocalLights; // ints
+		LSpan m_GlobalLights; // ints
+		LSpan m_Areas; // ints
+		LSpan m_BoundVerts; // verts, for debug drawing
+		LSpan m_BoundFaces; // ints, number of indices followed by the indices
+		LSpan m_BoundFacePlanes; // planes, 1 per face
+		int32_t m_ManualBound; // hull kept for rebuilding the room
+	};
+
+	struct LRecPortal
+	{
+		int32_t m_Name; // string
+		int32_t m_RoomNum;
+		int32_t m_Mirror;
+		Plane m_Plane;
+		Vector3 m_ptCentre;
+		LSpan m_Verts; // verts
+	};
+
+	// the bound is in the SOB AABBs section
+	struct LRecSob
+	{
+		int32_t m_Path; // string
+	};
+
+	struct LRecLight
+	{
+		int32_t m_Path; // string
+		int32_t m_Area; // string
+		int32_t m_AreaID;
+		int32_t m_RoomID;
+		LSpan m_Casters; // in the light casters section
+		LSpan m_AffectedRooms; // ints
+	};
+
+	struct LRecArea
+	{
+		int32_t m_Name; // string
+		LSpan m_Rooms; // in the area rooms section
+		LSpan m_Lights; // in the area lights section
+	};
+
+	static const char m_szMagic[4];
+	static const int32_t m_iEndianCheck;
+
+	// call on module register / unregister
+	static void Shared_Create();
+	static void Shared_Destroy();
+
+	// returns the shared block for the file, loading it if necessary, or NULL if the file is missing or invalid.
+	// Each successful acquire must be matched by a release.
+	static LBakedData * Acquire(String szFilename);
+	void Release();
+
+	// the file has been rewritten, later acquires should load it again
+	static void Shared_Forget(String szFilename);
+
+	template <class T> const T * Get(eSection section) const {return (const T *) (m_pBlock + m_pHeader->m_Sections[section].m_Offset);}
+	int GetNum(eSection section) const {return m_pHeader->m_Sections[section].m_Num;}
+	String GetString(int32_t id) const;
+
+	static bool Span_IsValid(const LSpan &span, int pool_size);
+
+private:
+	LBakedData();
+	bool Load(String szFilename);
+	bool Validate() const;
+	bool Validate_Sections() const;
+	bool Ints_AreIDsValid(const LSpan &span, int num_ids) const;
+
+	String m_szFilename;
+	int m_iRefCount;
+
+	LVector<uint8_t> m_Block;
+	const uint8_t * m_pBlock;
+	const LHeader * m_pHeader;
+
+	static LVector<LBakedData *> m_Shared;
+	static Mutex * m_pSharedMutex;
+};
@@ -36,6 +36,32 @@ void LBitField_Dynamic_IT::CopyFrom(const LBitField_Dynamic_IT &source)
 	memcpy(m_pucData, source.GetData(), source.GetNumBytes());
 }
 
+void LBitField_Dynamic_IT::Resize(unsigned int uiNumBits)
+{
+	unsigned char * pucOld = m_pucData;
+	unsigned int uiOldBits = m_uiNumBits;
+	unsigned int uiOldBytes = m_uiNumBytes;
+
+	// don't let create free the old data
+	m_pucData = 0;
+	Create(uiNumBits, true);
+
+	if (pucOld)
+	{
+		if (m_pucData)
+		{
+			unsigned int uiCopyBytes = (uiOldBytes < m_uiNumBytes) ? uiOldBytes : m_uiNumBytes;
+			memcpy(m_pucData, pucOld, uiCopyBytes);
+
+			// clear any bits past the old end in the last byte that was copied
+			for (unsigned int n=uiOldBits; n<(uiCopyBytes * 8); n++)
+				SetBit(n, false);
+		}
+
+		delete[] pucOld;
+	}
+}
+
 
 void LBitField_Dynamic_IT::Create(unsigned int uiNumBits, bool bBlank)
 {
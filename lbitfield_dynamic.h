@@ -29,6 +29,8 @@ public:
 	void Blank(bool bSetOrZero = false);
 	void Invert();
 	void CopyFrom(const LBitField_Dynamic_IT &source);
+	// keeps the existing bits, any new bits are blank
+	void Resize(unsigned int uiNumBits);
 
 	// loading / saving
 	unsigned char * GetData() {return m_pucData;}
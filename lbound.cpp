@@ -66,3 +66,230 @@ bool LBound::IsPointWithin(const Vector3 &pt, float epsilon) const
 	return true;
 }
 
+
+// the vertices of the convex hull formed by the planes, where any 3 planes meet inside the rest
+void LBound::FindCorners(LVector<Vector3> &corners) const
+{
+	corners.clear();
+
+	int nPlanes = m_Planes.size();
+
+	for (int i=0; i<nPlanes; i++)
+	{
+		for (int j=i+1; j<nPlanes; j++)
+		{
+			for (int k=j+1; k<nPlanes; k++)
+			{
+				Vector3 pt;
+				if (!m_Planes[i].intersect_3(m_Planes[j], m_Planes[k], &pt))
+					continue;
+
+				if (IsPointWithin(pt, 0.001f))
+					corners.push_back(pt);
+			}
+		}
+	}
+}
+
+// After the last plane has been added, update the corners to match, without testing every triple of planes.
+// Old corners behind the new plane are kept, and the new corners all lie on the new plane.
+void LBound::AddPlaneCorners(LVector<Vector3> &corners) const
+{
+	int nPlanes = m_Planes.size();
+	const Plane &plane = m_Planes[nPlanes-1];
+
+	for (int n=corners.size()-1; n>=0; n--)
+	{
+		if (plane.distance_to(corners[n]) > 0.001f)
+			corners.remove_unsorted(n);
+	}
+
+	for (int i=0; i<nPlanes-1; i++)
+	{
+		for (int j=i+1; j<nPlanes-1; j++)
+		{
+			Vector3 pt;
+			if (!plane.intersect_3(m_Planes[i], m_Planes[j], &pt))
+				continue;
+
+			if (IsPointWithin(pt, 0.001f))
+				corners.push_back(pt);
+		}
+	}
+}
+
+// Greedy simplification. Start with the AABB of the hull, which is conservative, then repeatedly
+// add the original plane that the worst corner is furthest in front of, until out of planes.
+// As every plane used touches the original hull, the result is never smaller than the original.
+float LBound::Simplify(int max_planes, const LBoundHull &hull)
+{
+	const LBakedVector<Vector3> &hull_pts = hull.m_Verts;
+
+	// need at least the AABB
+	max_planes = CLAMP(max_planes, 6, (int) SIMPLIFY_MAX_PLANES);
+
+	if ((m_Planes.size() <= max_planes) || (!hull_pts.size()))
+		return 0.0f;
+
+	Vector3 mins = hull_pts[0];
+	Vector3 maxs = hull_pts[0];
+	for (int n=1; n<hull_pts.size(); n++)
+	{
+		const Vector3 &pt = hull_pts[n];
+		for (int c=0; c<3; c++)
+		{
+			mins[c] = MIN(mins[c], pt[c]);
+			maxs[c] = MAX(maxs[c], pt[c]);
+		}
+	}
+
+	LVector<Plane> orig;
+	for (int n=0; n<m_Planes.size(); n++)
+		orig.push_back(m_Planes[n]);
+
+	m_Planes.clear();
+	m_Planes.push_back(Plane(Vector3(1, 0, 0), maxs.x));
+	m_Planes.push_back(Plane(Vector3(-1, 0, 0), -mins.x));
+	m_Planes.push_back(Plane(Vector3(0, 1, 0), maxs.y));
+	m_Planes.push_back(Plane(Vector3(0, -1, 0), -mins.y));
+	m_Planes.push_back(Plane(Vector3(0, 0, 1), maxs.z));
+	m_Planes.push_back(Plane(Vector3(0, 0, -1), -mins.z));
+
+	LVector<Vector3> corners;
+	FindCorners(corners);
+
+	while (m_Planes.size() < max_planes)
+	{
+		// the plane the corners are furthest in front of. This is only a lower bound on how far
+		// a corner is outside the hull, but is enough to choose the next plane.
+		float worst = 0.001f; // ignore tiny errors, the corners are only within epsilon of the planes in use
+		int worst_plane = -1;
+
+		for (int c=0; c<corners.size(); c++)
+		{
+			for (int p=0; p<orig.size(); p++)
+			{
+				float d = orig[p].distance_to(corners[c]);
+				if (d > worst)
+				{
+					worst = d;
+					worst_plane = p;
+				}
+			}
+		}
+
+		if (worst_plane == -1)
+			break;
+
+		m_Planes.push_back(orig[worst_plane]);
+		AddPlaneCorners(corners);
+	}
+
+	// the furthest the simplified bound extends outside the hull is at one of its corners
+	float error = 0.0f;
+	for (int c=0; c<corners.size(); c++)
+		error = MAX(error, hull.GetDistanceTo(corners[c]));
+
+	return error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void LBoundHull::Create(const Geometry::MeshData &md)
+{
+	Clear();
+
+	for (int n=0; n<md.vertices.size(); n++)
+		m_Verts.push_back(md.vertices[n]);
+
+	for (int f=0; f<md.faces.size(); f++)
+	{
+		const Geometry::MeshData::Face &face = md.faces[f];
+
+		m_Faces.push_back(face.indices.size());
+		for (int i=0; i<face.indices.size(); i++)
+			m_Faces.push_back(face.indices[i]);
+
+		m_FacePlanes.push_back(face.plane);
+	}
+}
+
+// the nearest point on a convex hull to a point outside is on a face the point is in front of
+float LBoundHull::GetDistanceTo(const Vector3 &pt) const
+{
+	float best = FLT_MAX;
+	bool bOutside = false;
+
+	int i = 0;
+	for (int f=0; f<m_FacePlanes.size(); f++)
+	{
+		int count = m_Faces[i++];
+		int first = i;
+		i += count;
+
+		const Plane &plane = m_FacePlanes[f];
+		float d = plane.distance_to(pt);
+		if (d <= 0.0f)
+			continue;
+
+		bOutside = true;
+
+		// within the face, the nearest point is straight down onto the plane
+		Vector3 ptProj = pt - (plane.normal * d);
+		int nPos = 0;
+		int nNeg = 0;
+
+		for (int e=0; e<count; e++)
+		{
+			const Vector3 &a = m_Verts[m_Faces[first + e]];
+			const Vector3 &b = m_Verts[m_Faces[first + ((e+1) % count)]];
+
+			float side = (b - a).cross(ptProj - a).dot(plane.normal);
+			if (side > 0.0f)
+				nPos++;
+			else if (side < 0.0f)
+				nNeg++;
+		}
+
+		if (!nPos || !nNeg)
+		{
+			best = MIN(best, d);
+			continue;
+		}
+
+		// otherwise it is on one of the edges
+		for (int e=0; e<count; e++)
+		{
+			const Vector3 &a = m_Verts[m_Faces[first + e]];
+			const Vector3 &b = m_Verts[m_Faces[first + ((e+1) % count)]];
+
+			Vector3 edge = b - a;
+			float len_sq = edge.length_squared();
+			float t = 0.0f;
+			if (len_sq > 0.0f)
+				t = CLAMP(edge.dot(pt - a) / len_sq, 0.0f, 1.0f);
+
+			best = MIN(best, pt.distance_to(a + (edge * t)));
+		}
+	}
+
+	if (!bOutside)
+		return 0.0f;
+
+	return best;
+}
+
+void LBoundHull::Clear()
+{
+	m_Verts.clear();
+	m_Faces.clear();
+	m_FacePlanes.clear();
+}
+
+// take copies, before the baked data it points into is released
+void LBoundHull::MakeOwned()
+{
+	m_Verts.make_owned();
+	m_Faces.make_owned();
+	m_FacePlanes.make_owned();
+}
@@ -25,11 +25,17 @@
 
 
 #include "lvector.h"
+#include "core/math/geometry.h"
+
+class LBoundHull;
 
 // optional convex hull around rooms, to make it easier to determine which room a point is within
 class LBound
 {
 public:
+	// simplifying costs roughly the cube of the planes for each plane added, so the limit is kept small
+	enum {SIMPLIFY_MAX_PLANES = 64};
+
 	bool IsPointWithin(const Vector3 &pt, float epsilon = 0.0f) const;
 
 	// get distance behind all planes and return the smallest..
@@ -39,5 +45,34 @@ public:
 	// the bound is optional .. not all rooms have a bound
 	bool IsActive() const {return m_Planes.size() != 0;}
 
-	LVector<Plane> m_Planes;
+	// reduce to at most max_planes (minimum 6, maximum SIMPLIFY_MAX_PLANES), from the original hull.
+	// The simplified bound always contains the original, returns the furthest it extends outside.
+	float Simplify(int max_planes, const LBoundHull &hull);
+
+	// may point into baked data
+	LBakedVector<Plane> m_Planes;
+
+private:
+	void FindCorners(LVector<Vector3> &corners) const;
+	void AddPlaneCorners(LVector<Vector3> &corners) const;
+};
+
+// The convex hull a bound was made from, retained for debugging visualization, and the hull of manual bounds.
+// Read only once created, and may point into baked data.
+class LBoundHull
+{
+public:
+	void Create(const Geometry::MeshData &md);
+	void Clear();
+	void MakeOwned();
+	bool IsActive() const {return m_FacePlanes.size() != 0;}
+
+	// distance from a point to the nearest point on the hull, 0 if within
+	float GetDistanceTo(const Vector3 &pt) const;
+
+	LBakedVector<Vector3> m_Verts;
+
+	// each face is the number of indices followed by the indices
+	LBakedVector<int32_t> m_Faces;
+	LBakedVector<Plane> m_FacePlanes;
 };
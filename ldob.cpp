@@ -28,6 +28,7 @@
 
 
 bool LHidable::m_bDetach = true;
+bool LHidable::m_bDetaching = false;
 
 void LHidable::Hidable_Create(Node * pNode)
 {
@@ -44,6 +45,10 @@ void LHidable::Show(bool bShow)
 	if (bShow == m_bShow)
 		return;
 
+	// removed by incremental conversion
+	if (!m_pNode)
+		return;
+
 	// new state
 	m_bShow = bShow;
 
@@ -62,7 +67,9 @@ void LHidable::Show(bool bShow)
 		{
 			//sz = "hide ";
 			// remove from tree
+			m_bDetaching = true;
 			m_pParent->remove_child(m_pNode);
+			m_bDetaching = false;
 		}
 		//sz += m_pParent->get_name();
 		//sz += "->";
@@ -127,19 +134,22 @@ void LLight::Light_SetDefaults()
 	m_FirstCaster = 0;
 	m_NumCasters = 0;
 
+	m_FirstAffectedRoom = 0;
 	m_NumAffectedRooms = 0;
+	m_MaxAffectedRooms = 0;
 	m_iArea = -1;
-}
+	m_bRemoved = false;
 
-bool LLight::AddAffectedRoom(int room_id)
-{
-	if (m_NumAffectedRooms >= MAX_AFFECTED_ROOMS)
-		return false;
-	m_AffectedRooms[m_NumAffectedRooms++] = room_id;
-	return true;
-}
+	m_bTraced = false;
+	m_iTracedRoom = -1;
+	m_bRetracePending = false;
 
+	m_bWithinBudget = false;
+	m_bShadowSuppressed = false;
 
+	m_bCacheValid = false;
+	m_pGodotLight = 0;
+}
 
 // dynamic light update
 void LLight::Update()
@@ -155,28 +165,42 @@ String LLight::MakeDebugString() const
 }
 
 
-Light * LLight::GetGodotLight()
+Light * LLight::GetGodotLight() const
 {
-	Object * pObj = ObjectDB::get_instance(m_GodotID);
-	Light * p = Object::cast_to<Light>(pObj);
-	return p;
+	if (!m_bCacheValid)
+	{
+		Object * pObj = ObjectDB::get_instance(m_GodotID);
+		m_pGodotLight = Object::cast_to<Light>(pObj);
+		m_bCacheValid = true;
+	}
+
+	return m_pGodotLight;
 }
 
 
 /////////////////////////////////////////////////////////////////////
 
-Spatial * LSob::GetSpatial() const
+void LSob::Cache_Resolve() const
 {
 	Object * pObj = ObjectDB::get_instance(m_ID);
-	Spatial * pSpat = Object::cast_to<Spatial>(pObj);
-	return pSpat;
+	m_pSpatial = Object::cast_to<Spatial>(pObj);
+	m_pVI = Object::cast_to<VisualInstance>(pObj);
+	m_pGI = Object::cast_to<GeometryInstance>(pObj);
+	m_bCacheValid = true;
+}
+
+Spatial * LSob::GetSpatial() const
+{
+	if (!m_bCacheValid)
+		Cache_Resolve();
+
+	return m_pSpatial;
 }
 
 
 bool LSob::IsShadowCaster() const
 {
-	Object * pObj = ObjectDB::get_instance(m_ID);
-	GeometryInstance * pGI = Object::cast_to<GeometryInstance>(pObj);
+	GeometryInstance * pGI = GetGI();
 
 	if (pGI)
 	{
@@ -193,16 +217,18 @@ bool LSob::IsShadowCaster() const
 
 GeometryInstance * LSob::GetGI() const
 {
-	Object * pObj = ObjectDB::get_instance(m_ID);
-	GeometryInstance * pGI = Object::cast_to<GeometryInstance>(pObj);
-	return pGI;
+	if (!m_bCacheValid)
+		Cache_Resolve();
+
+	return m_pGI;
 }
 
 VisualInstance * LSob::GetVI() const
 {
-	Object * pObj = ObjectDB::get_instance(m_ID);
-	VisualInstance * pVI = Object::cast_to<VisualInstance>(pObj);
-	return pVI;
+	if (!m_bCacheValid)
+		Cache_Resolve();
+
+	return m_pVI;
 }
 
 
@@ -254,17 +280,26 @@ void LSob::Show(bool bShow)
 */
 
 
+void LDob::Cache_Resolve() const
+{
+	m_pSpatial = Object::cast_to<Spatial>(ObjectDB::get_instance(m_ID_Spatial));
+	m_pVI = Object::cast_to<VisualInstance>(ObjectDB::get_instance(m_ID_VI));
+	m_bCacheValid = true;
+}
+
 Spatial * LDob::GetSpatial() const
 {
-	Object * pObj = ObjectDB::get_instance(m_ID_Spatial);
-	Spatial * pSpat = Object::cast_to<Spatial>(pObj);
-	return pSpat;
+	if (!m_bCacheValid)
+		Cache_Resolve();
+
+	return m_pSpatial;
 }
 
 VisualInstance * LDob::GetVI() const
 {
-	Object * pObj = ObjectDB::get_instance(m_ID_VI);
-	VisualInstance * pVI = Object::cast_to<VisualInstance>(pObj);
-	return pVI;
+	if (!m_bCacheValid)
+		Cache_Resolve();
+
+	return m_pVI;
 }
 
@@ -31,12 +31,23 @@ class VisualInstance;
 class GeometryInstance;
 class Light;
 
+// Godot object lookups (ObjectDB::get_instance + cast_to) are resolved on first use and cached
+// on the lportal objects (rooms, SOBs, DOBs and lights), so the per frame paths don't touch ObjectDB.
+// The room manager watches the tree_exiting signal of each node, and invalidates the cache of that
+// object only, so a node freed or moved by the game is looked up again next time it is used.
+// Each room manager also invalidates all its caches whenever the godot objects may have gone away
+// (rooms converted / released, room manager leaving the tree).
+
 class LHidable
 {
 public:
 	void Hidable_Create(Node * pNode);
 	void Show(bool bShow);
 
+	// set while Show detaches a node, so the room manager can tell its own detaches
+	// from the game removing the node (detached nodes must not be freed by the game)
+	static bool m_bDetaching;
+
 	// new .. can be separated from the scene tree to cull
 	Node * m_pNode;
 	Node * m_pParent;
@@ -58,8 +69,19 @@ public:
 	//void Show(bool bShow);
 	bool IsShadowCaster() const;
 
+	LSob() {m_bCacheValid = false;}
+	void Cache_Invalidate() {m_bCacheValid = false;}
+
 	ObjectID m_ID; // godot object
-	AABB m_aabb; // world space
+
+private:
+	void Cache_Resolve() const;
+
+	// cached godot pointers, see LHidable
+	mutable bool m_bCacheValid;
+	mutable Spatial * m_pSpatial;
+	mutable VisualInstance * m_pVI;
+	mutable GeometryInstance * m_pGI;
 };
 
 // dynamic object
@@ -69,13 +91,41 @@ public:
 	Spatial * GetSpatial() const;
 	VisualInstance * GetVI() const;
 
+	// must be called whenever the godot IDs change (dobs are zeroed with memset, so no constructor)
+	void Cache_Invalidate() {m_bCacheValid = false;}
+
 	bool m_bSlotTaken;
-	bool m_bVisible;
+	bool m_bVisible; // whether currently shown
+	uint32_t m_uiLayerMask; // camera / light layers currently shown on
 	float m_fRadius;
 	int m_iRoomID;
 
+	// position from the last update, used for culling
+	Vector3 m_ptPos;
+
+	// frame the dob was last found visible to the camera, or casting a shadow into view
+	unsigned int m_uiFrameVisible;
+	unsigned int m_uiFrameCaster;
+
+	// LDobQueue drain the dob was last updated on
+	unsigned int m_uiDrainQueued;
+
+	// cell in the room LDobGrid, or -1 if the room has no grid
+	int m_iGridCell;
+
+	// for the LDobList handles and free list
+	int m_iGeneration;
+	int m_iNextFree;
+
 	ObjectID m_ID_Spatial;
 	ObjectID m_ID_VI;
+
+private:
+	void Cache_Resolve() const;
+
+	mutable bool m_bCacheValid;
+	mutable Spatial * m_pSpatial;
+	mutable VisualInstance * m_pVI;
 };
 
 
@@ -128,8 +178,6 @@ private:
 class LLight : public LHidable
 {
 public:
-	enum {MAX_AFFECTED_ROOMS=64};
-
 	LSource m_Source;
 	ObjectID m_GodotID;
 	int m_DOB_id;
@@ -147,17 +195,36 @@ public:
 	String MakeDebugString() const;
 
 	void Light_SetDefaults();
-	Light * GetGodotLight();
-
+	Light * GetGodotLight() const;
+	void Cache_Invalidate() {m_bCacheValid = false;}
 
-	bool AddAffectedRoom(int room_id);
-	void ClearAffectedRooms() {m_NumAffectedRooms = 0;}
 
-	// keep a list of the rooms affected by this light
-	uint16_t m_AffectedRooms[MAX_AFFECTED_ROOMS];
+	// keep a list of the rooms affected by this light, as a span in LRoomManager::m_LightAffectedRooms
+	// (use the LRoomManager::Light_ functions to change).
+	// The span has room for m_MaxAffectedRooms, and is moved to the end of the pool when it needs to grow.
+	int m_FirstAffectedRoom;
 	int m_NumAffectedRooms;
+	int m_MaxAffectedRooms;
+
+	// dynamic lights, source at the last retrace of the affected rooms
+	bool m_bTraced;
+	Vector3 m_ptTracedPos;
+	Vector3 m_ptTracedDir;
+	int m_iTracedRoom;
+	bool m_bRetracePending; // waiting in the time sliced retrace list
+
+	// light budget
+	bool m_bWithinBudget; // last frame
+	bool m_bShadowSuppressed; // shadow turned off because over budget
+
+	// removed along with its room by incremental conversion (the light ID is kept)
+	bool m_bRemoved;
 
 	// for global lights, this is the area or -1 if unset
 	int m_iArea;
 	String m_szArea; // set to the area string in the case of area lights, else ""
+
+private:
+	mutable bool m_bCacheValid;
+	mutable Light * m_pGodotLight;
 };
@@ -0,0 +1,193 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "ldob_grid.h"
+#include "ldoblist.h"
+#include "ldebug.h"
+
+
+void LDobGrid::Create(LDobList &dobs, const AABB &bb, const LVector<int> &dob_ids)
+{
+	m_ptMins = bb.position;
+
+	// cells as near to cubes as possible, with the longest axis having the most cells
+	float longest = MAX(bb.size.x, MAX(bb.size.y, bb.size.z));
+	float target_size = MAX(longest / MAX_CELLS_PER_AXIS, 0.01f);
+
+	int nCells = 1;
+	for (int c=0; c<3; c++)
+	{
+		int d = (int) (bb.size[c] / target_size);
+		d = CLAMP(d, 1, (int) MAX_CELLS_PER_AXIS);
+		m_iDims[c] = d;
+		m_ptCellSize[c] = MAX(bb.size[c] / d, 0.01f);
+		nCells *= d;
+	}
+
+	m_Cells.resize(nCells);
+	for (int n=0; n<nCells; n++)
+	{
+		m_Cells[n].m_DOBs.clear();
+		m_Cells[n].m_fExpand = 0.0f;
+	}
+
+	m_bActive = true;
+
+	for (int n=0; n<dob_ids.size(); n++)
+		Add(dobs, dob_ids[n]);
+
+	LPRINT(2, "LDobGrid created " + itos(m_iDims[0]) + " x " + itos(m_iDims[1]) + " x " + itos(m_iDims[2]) + ", " + itos(dob_ids.size()) + " dobs");
+}
+
+void LDobGrid::Destroy(LDobList &dobs, const LVector<int> &dob_ids)
+{
+	for (int n=0; n<dob_ids.size(); n++)
+		dobs.GetDob(dob_ids[n]).m_iGridCell = -1;
+
+	m_Cells.clear(true);
+	m_bActive = false;
+}
+
+int LDobGrid::FindCell(const Vector3 &pt) const
+{
+	// points outside the grid go in the edge cells
+	int i[3];
+	for (int c=0; c<3; c++)
+	{
+		int d = (int) Math::floor((pt[c] - m_ptMins[c]) / m_ptCellSize[c]);
+		i[c] = CLAMP(d, 0, m_iDims[c] - 1);
+	}
+
+	return (((i[2] * m_iDims[1]) + i[1]) * m_iDims[0]) + i[0];
+}
+
+void LDobGrid::Cell_GetBound(int cell, Vector3 &ptMins, Vector3 &ptMaxs) const
+{
+	int x = cell % m_iDims[0];
+	int y = (cell / m_iDims[0]) % m_iDims[1];
+	int z = cell / (m_iDims[0] * m_iDims[1]);
+
+	ptMins = m_ptMins + Vector3(x * m_ptCellSize.x, y * m_ptCellSize.y, z * m_ptCellSize.z);
+	ptMaxs = ptMins + m_ptCellSize;
+}
+
+void LDobGrid::Cell_Insert(LDobList &dobs, int cell, int dob_id)
+{
+	m_Cells[cell].m_DOBs.push_back(dob_id);
+	dobs.GetDob(dob_id).m_iGridCell = cell;
+
+	Cell_Expand(dobs.GetDob(dob_id), cell);
+}
+
+void LDobGrid::Cell_Expand(const LDob &dob, int cell)
+{
+	// grow the cell to enclose the dob sphere (the dob may be outside the cell if it is an edge cell)
+	Vector3 ptMins, ptMaxs;
+	Cell_GetBound(cell, ptMins, ptMaxs);
+
+	float outside = 0.0f;
+	for (int a=0; a<3; a++)
+	{
+		outside = MAX(outside, ptMins[a] - dob.m_ptPos[a]);
+		outside = MAX(outside, dob.m_ptPos[a] - ptMaxs[a]);
+	}
+
+	LCell &c = m_Cells[cell];
+	c.m_fExpand = MAX(c.m_fExpand, outside + dob.m_fRadius);
+}
+
+void LDobGrid::Cell_Erase(int cell, int dob_id)
+{
+	LCell &c = m_Cells[cell];
+
+	int n = c.m_DOBs.find(dob_id);
+	if (n != -1)
+		c.m_DOBs.remove_unsorted(n);
+
+	if (!c.m_DOBs.size())
+		c.m_fExpand = 0.0f;
+}
+
+void LDobGrid::Add(LDobList &dobs, int dob_id)
+{
+	const LDob &dob = dobs.GetDob(dob_id);
+	Cell_Insert(dobs, FindCell(dob.m_ptPos), dob_id);
+}
+
+void LDobGrid::Remove(LDobList &dobs, int dob_id)
+{
+	LDob &dob = dobs.GetDob(dob_id);
+	if (dob.m_iGridCell == -1)
+		return;
+
+	Cell_Erase(dob.m_iGridCell, dob_id);
+	dob.m_iGridCell = -1;
+}
+
+void LDobGrid::Move(LDobList &dobs, int dob_id)
+{
+	const LDob &dob = dobs.GetDob(dob_id);
+
+	int cell = FindCell(dob.m_ptPos);
+	if (cell == dob.m_iGridCell)
+	{
+		// edge cells may still need expanding, if moving outside the grid
+		Cell_Expand(dob, cell);
+		return;
+	}
+
+	if (dob.m_iGridCell != -1)
+		Cell_Erase(dob.m_iGridCell, dob_id);
+
+	Cell_Insert(dobs, cell, dob_id);
+}
+
+LDobGrid::eCull LDobGrid::Cell_Cull(int cell, const LVector<Plane> &planes) const
+{
+	Vector3 ptMins, ptMaxs;
+	Cell_GetBound(cell, ptMins, ptMaxs);
+
+	float expand = m_Cells[cell].m_fExpand;
+	Vector3 ptExtents = ((ptMaxs - ptMins) * 0.5f) + Vector3(expand, expand, expand);
+	Vector3 ptCentre = (ptMins + ptMaxs) * 0.5f;
+
+	bool bInside = true;
+
+	for (int p=0; p<planes.size(); p++)
+	{
+		const Plane &pl = planes[p];
+
+		// projected radius of the box onto the plane normal
+		float r = (Math::abs(pl.normal.x) * ptExtents.x) + (Math::abs(pl.normal.y) * ptExtents.y) + (Math::abs(pl.normal.z) * ptExtents.z);
+		float dist = pl.distance_to(ptCentre);
+
+		if (dist > r)
+			return CULL_OUTSIDE;
+
+		if (dist > -r)
+			bInside = false;
+	}
+
+	if (bInside)
+		return CULL_INSIDE;
+
+	return CULL_PARTIAL;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+
+class LDobList;
+class LDob;
+
+// Optional loose grid of the dobs within a room, only created once a room has many dobs (crowds, debris etc).
+// Dobs are bucketed by their centre, and each cell is expanded to enclose the dob spheres within it,
+// so whole cells can be rejected (or accepted) against the culling planes.
+// Dobs are only moved between cells when they cross a cell boundary.
+class LDobGrid
+{
+public:
+	enum
+	{
+		// hysteresis so rooms hovering around the limit don't keep creating and destroying the grid
+		CREATE_NUM_DOBS = 64,
+		DESTROY_NUM_DOBS = 32,
+		MAX_CELLS_PER_AXIS = 8,
+	};
+
+	enum eCull
+	{
+		CULL_OUTSIDE,
+		CULL_INSIDE,
+		CULL_PARTIAL,
+	};
+
+	LDobGrid() {m_bActive = false;}
+
+	bool IsActive() const {return m_bActive;}
+	void Create(LDobList &dobs, const AABB &bb, const LVector<int> &dob_ids);
+	void Destroy(LDobList &dobs, const LVector<int> &dob_ids);
+
+	void Add(LDobList &dobs, int dob_id);
+	void Remove(LDobList &dobs, int dob_id);
+	// call after the dob position has changed, only does work if it has changed cell
+	void Move(LDobList &dobs, int dob_id);
+
+	// cells
+	int GetNumCells() const {return m_Cells.size();}
+	const LVector<int> &Cell_GetDOBs(int cell) const {return m_Cells[cell].m_DOBs;}
+	eCull Cell_Cull(int cell, const LVector<Plane> &planes) const;
+
+private:
+	class LCell
+	{
+	public:
+		LVector<int> m_DOBs;
+
+		// how far the cell bound is expanded to enclose the dobs,
+		// only grows while the cell is occupied
+		float m_fExpand;
+	};
+
+	int FindCell(const Vector3 &pt) const;
+	void Cell_GetBound(int cell, Vector3 &ptMins, Vector3 &ptMaxs) const;
+	void Cell_Insert(LDobList &dobs, int cell, int dob_id);
+	void Cell_Erase(int cell, int dob_id);
+	void Cell_Expand(const LDob &dob, int cell);
+
+	LVector<LCell> m_Cells;
+
+	Vector3 m_ptMins;
+	Vector3 m_ptCellSize;
+	int m_iDims[3];
+
+	bool m_bActive;
+};
@@ -0,0 +1,170 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "ldob_queue.h"
+#include "lroom_manager.h"
+#include "ldebug.h"
+
+
+LDobQueue::LDobQueue()
+{
+	m_iPushBuffer = 0;
+	m_iFrontResults = 0;
+	m_uiDrainCounter = 0;
+	m_bInUse = false;
+	m_pMutex = Mutex::create();
+}
+
+LDobQueue::~LDobQueue()
+{
+	if (m_pMutex)
+	{
+		memdelete(m_pMutex);
+		m_pMutex = 0;
+	}
+}
+
+void LDobQueue::Push(int dob_id, const Vector3 &pos)
+{
+	m_pMutex->lock();
+
+	LItem * pItem = m_Items[m_iPushBuffer].request();
+	pItem->m_DobID = dob_id;
+	pItem->m_ptPos = pos;
+	m_bInUse = true;
+
+	m_pMutex->unlock();
+}
+
+int LDobQueue::GetRoomID(int dob_id) const
+{
+	if (dob_id < 0)
+		return -1;
+
+	int room_id = -1;
+
+	m_pMutex->lock();
+
+	const LVector<LResult> &results = m_Results[m_iFrontResults];
+	int slot = LDobList::Handle_GetSlot(dob_id);
+
+	if (slot < results.size())
+	{
+		const LResult &res = results[slot];
+		if (res.m_DobID == dob_id)
+			room_id = res.m_RoomID;
+	}
+
+	m_pMutex->unlock();
+
+	return room_id;
+}
+
+void LDobQueue::Drain(LRoomManager &manager, bool bApply)
+{
+	// swap buffers so other threads can carry on pushing while we process
+	m_pMutex->lock();
+	bool bInUse = m_bInUse;
+	int process_buffer = m_iPushBuffer;
+	if (bInUse)
+		m_iPushBuffer = 1 - m_iPushBuffer;
+	m_pMutex->unlock();
+
+	if (!bInUse)
+		return;
+
+	LVector<LItem> &items = m_Items[process_buffer];
+
+	m_uiDrainCounter++;
+	m_Collapsed.clear();
+
+	// held updates are older than anything just pushed, so are collapsed last
+	Collapse(manager, items);
+	Collapse(manager, m_Held);
+
+	items.clear();
+	m_Held.clear();
+
+	if (!bApply)
+	{
+		m_Held.copy_from(m_Collapsed);
+		return;
+	}
+
+	LDobList &dobs = manager.m_DobList;
+
+	for (int n=0; n<m_Collapsed.size(); n++)
+	{
+		const LItem &item = m_Collapsed[n];
+		dobs.UpdateDob(manager, item.m_DobID, item.m_ptPos);
+	}
+
+	Publish(manager);
+}
+
+void LDobQueue::Collapse(LRoomManager &manager, const LVector<LItem> &items)
+{
+	LDobList &dobs = manager.m_DobList;
+
+	// go backwards so the most recent update for each dob is used, and earlier ones skipped
+	for (int n=items.size()-1; n>=0; n--)
+	{
+		const LItem &item = items[n];
+
+		// may have been unregistered since the push
+		if (!dobs.IsValid(item.m_DobID))
+			continue;
+
+		LDob &dob = dobs.GetDob(item.m_DobID);
+		if (dob.m_uiDrainQueued == m_uiDrainCounter)
+			continue;
+		dob.m_uiDrainQueued = m_uiDrainCounter;
+
+		m_Collapsed.push_back(item);
+	}
+}
+
+void LDobQueue::Publish(LRoomManager &manager)
+{
+	const LDobList &dobs = manager.m_DobList;
+
+	// fill the back buffer, which no other thread reads
+	int back = 1 - m_iFrontResults;
+	LVector<LResult> &results = m_Results[back];
+
+	int nSlots = dobs.GetNumSlots();
+	results.resize(nSlots);
+
+	for (int n=0; n<nSlots; n++)
+	{
+		LResult &res = results[n];
+		res.m_DobID = dobs.GetSlotHandle(n);
+
+		if (res.m_DobID != -1)
+			res.m_RoomID = dobs.GetDob(res.m_DobID).m_iRoomID;
+		else
+			res.m_RoomID = -1;
+	}
+
+	m_pMutex->lock();
+	m_iFrontResults = back;
+	m_pMutex->unlock();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+#include "core/os/mutex.h"
+
+class LRoomManager;
+
+// Queue of dob position updates that can be pushed from any thread (e.g. the physics thread).
+// The main thread drains the queue at the start of each frame, the most recent position for each dob wins.
+// The resulting room IDs are published back in a double buffered table, swapped after each drain.
+// The lock is only held to push a single update, or to swap the buffers, never while the rooms are searched.
+// A mutex is used rather than the atomics in safe_refcount.h because the push buffers grow on demand,
+// which a lock-free push can't do without a fixed capacity, and because GetRoomID must finish reading
+// the front results before the next Publish can rewrite them as the back buffer.
+class LDobQueue
+{
+public:
+	LDobQueue();
+	~LDobQueue();
+
+	// ANY THREAD
+	void Push(int dob_id, const Vector3 &pos);
+	// room ID from the last drain, or -1 if the dob was not registered at that time
+	int GetRoomID(int dob_id) const;
+
+	// MAIN THREAD ONLY
+	// if the rooms can't be searched (inactive or converting) the updates are held,
+	// collapsed to the most recent for each dob, and applied on a later drain
+	void Drain(LRoomManager &manager, bool bApply);
+
+private:
+	void Publish(LRoomManager &manager);
+
+	class LItem
+	{
+	public:
+		int m_DobID;
+		Vector3 m_ptPos;
+	};
+
+	class LResult
+	{
+	public:
+		int m_DobID; // handle, to detect stale lookups
+		int m_RoomID;
+	};
+
+	void Collapse(LRoomManager &manager, const LVector<LItem> &items);
+
+	// items are pushed to one buffer while the other is processed
+	LVector<LItem> m_Items[2];
+	int m_iPushBuffer;
+
+	// most recent update per dob, held while the rooms are unavailable
+	LVector<LItem> m_Held;
+	LVector<LItem> m_Collapsed;
+
+	// indexed by dob slot
+	LVector<LResult> m_Results[2];
+	int m_iFrontResults;
+
+	// incremented each drain, to detect duplicate updates for a dob
+	unsigned int m_uiDrainCounter;
+
+	// set once anything has been pushed, so there is no publishing cost when the queue is not used.
+	// Written and read under the mutex.
+	bool m_bInUse;
+
+	Mutex * m_pMutex;
+};
@@ -2,6 +2,97 @@
 #include "lroom_manager.h"
 #include "ldebug.h"
 
+int LDobList::Request()
+{
+	int slot;
+
+	if (m_iFirstFree != -1)
+	{
+		// reuse a free slot
+		slot = m_iFirstFree;
+		m_iFirstFree = m_List[slot].m_iNextFree;
+	}
+	else
+	{
+		// none free, create new
+		if (m_List.size() > HANDLE_SLOT_MASK)
+		{
+			WARN_PRINT_ONCE("LDobList::Request : too many dobs");
+			return -1;
+		}
+
+		slot = m_List.size();
+		LDob * p = m_List.request();
+		memset(p, 0, sizeof (LDob));
+		p->m_iGeneration = m_iNewSlotGeneration;
+	}
+
+	LDob &dob = m_List[slot];
+	dob.m_bSlotTaken = true;
+	dob.m_iRoomID = -1;
+	dob.m_iGridCell = -1;
+	dob.m_iNextFree = -1;
+	m_iNumUsed++;
+
+	return Handle_Make(slot, dob.m_iGeneration);
+}
+
+bool LDobList::DeleteDob(int handle)
+{
+	if (!IsValid(handle))
+		return false;
+
+	int slot = Handle_GetSlot(handle);
+	LDob &dob = m_List[slot];
+	dob.m_bSlotTaken = false;
+	dob.Cache_Invalidate();
+
+	// any outstanding handles to this slot are now stale
+	dob.m_iGeneration = (dob.m_iGeneration + 1) & HANDLE_GENERATION_MASK;
+
+	dob.m_iNextFree = m_iFirstFree;
+	m_iFirstFree = slot;
+	m_iNumUsed--;
+
+	// if mostly empty, give back the unused slots at the end of the list
+	if ((m_List.size() >= COMPACT_MIN_SIZE) && (m_iNumUsed < (m_List.size() / 4)))
+		Compact();
+
+	return true;
+}
+
+// Live dobs can't be moved because the handles refer to the slot,
+// so compacting can only remove the free slots from the end of the list.
+void LDobList::Compact()
+{
+	int new_size = m_List.size();
+	while (new_size && !m_List[new_size-1].m_bSlotTaken)
+	{
+		new_size--;
+
+		int gen = m_List[new_size].m_iGeneration;
+		if (gen > m_iNewSlotGeneration)
+			m_iNewSlotGeneration = gen;
+	}
+
+	if (new_size == m_List.size())
+		return;
+
+	m_List.resize(new_size, true);
+
+	// rebuild the free list, lowest slots first
+	m_iFirstFree = -1;
+	for (int n=new_size-1; n>=0; n--)
+	{
+		LDob &dob = m_List[n];
+		if (!dob.m_bSlotTaken)
+		{
+			dob.m_iNextFree = m_iFirstFree;
+			m_iFirstFree = n;
+		}
+	}
+}
+
 // returns whether changed room
 bool LDobList::FindDOBOldAndNewRoom(LRoomManager &manager, int dob_id, const Vector3 &pos, int &old_room_id, int &new_room_id)
 {
@@ -68,36 +159,45 @@ bool LDobList::FindDOBOldAndNewRoom(LRoomManager &manager, int dob_id, const Vec
 	return false;
 }
 
-void LDobList::UpdateVisibility(LRoomManager &manager, Spatial * pDOBSpatial, int dob_id)
+void LDobList::ShowDob(int dob_id, bool bVisible, bool bCaster)
 {
 	LDob &dob = GetDob(dob_id);
 
-	// get the room
-	LRoom * pRoom = manager.GetRoom(dob.m_iRoomID);
-	bool bRoomVisible = pRoom->IsVisible();
+	uint32_t mask = 0;
+	if (bVisible) mask |= LRoom::LAYER_MASK_CAMERA;
+	if (bCaster) mask |= LRoom::LAYER_MASK_LIGHT;
 
-	Spatial * pDOB = pDOBSpatial;
+	bool bShow = mask != 0;
 
-	bool bDobVis = pDOB->is_visible_in_tree();
-	if (bDobVis != bRoomVisible)
-	{
-		//String sz = "DOB " + pDOB->get_name() + "\t";
+	// noop
+	if ((dob.m_bVisible == bShow) && (dob.m_uiLayerMask == mask))
+		return;
 
-		if (bRoomVisible)
-		{
-			pDOB->show();
-			//sz += "coming into view";
-		}
-		else
+	VisualInstance * pVI = dob.GetVI();
+	if (!pVI)
+		return;
+
+#ifdef LPORTAL_DOBS_NO_SOFTSHOW
+	// hidden dobs keep their layers, only changed when shown
+	if (bShow)
+	{
+		if (dob.m_uiLayerMask != mask)
 		{
-			pDOB->hide();
-			//sz += "exiting view";
+			LRoom::SoftShow(pVI, mask);
+			dob.m_uiLayerMask = mask;
 		}
 
-		//print_line(sz);
+		if (!dob.m_bVisible)
+			pVI->show();
 	}
+	else
+		pVI->hide();
+#else
+	LRoom::SoftShow(pVI, mask);
+	dob.m_uiLayerMask = mask;
+#endif
 
-
+	dob.m_bVisible = bShow;
 }
 
 
@@ -105,23 +205,59 @@ void LDobList::UpdateVisibility(LRoomManager &manager, Spatial * pDOBSpatial, in
 int LDobList::UpdateDob(LRoomManager &manager, int dob_id, const Vector3 &pos)
 {
 	LDob &dob = GetDob(dob_id);
-
-	// get the VI for showing / hiding
-	Spatial * pSpat = (Spatial *) dob.GetVI();
+	dob.m_ptPos = pos;
 
 	int old_room, new_room;
 
 	if (FindDOBOldAndNewRoom(manager, dob_id, pos, old_room, new_room))
 	{
+		// keep the room lists of dobs up to date
+		if (old_room != -1)
+		{
+			LRoom * pOldRoom = manager.GetRoom(old_room);
+			if (pOldRoom)
+				pOldRoom->DOB_Remove(manager, dob_id);
+		}
+
+		LRoom * pNewRoom = manager.GetRoom(new_room);
+		if (pNewRoom)
+			pNewRoom->DOB_Add(manager, dob_id);
+
 		dob.m_iRoomID = new_room;
-	}
 
-	if (dob_id != manager.m_DOB_id_camera)
-		UpdateVisibility(manager, pSpat, dob_id);
+		// entering a room that is not visible, hide straight away.
+		// Otherwise visibility is determined by the camera trace each frame.
+		if ((dob_id != manager.m_DOB_id_camera) && ((!pNewRoom) || (!pNewRoom->IsVisible())))
+			ShowDob(dob_id, false, false);
+	}
+	else if (dob.m_iRoomID != -1)
+	{
+		// same room, may have moved cell
+		LRoom * pRoom = manager.GetRoom(dob.m_iRoomID);
+		if (pRoom)
+			pRoom->DOB_Move(manager, dob_id);
+	}
 
 	return dob.m_iRoomID;
 }
 
+void LDobList::UpdateDobs(LRoomManager &manager, const int * pDobIDs, const Vector3 * pPositions, int num, int * pRoomIDs)
+{
+	for (int n=0; n<num; n++)
+	{
+		int dob_id = pDobIDs[n];
+
+		if (!IsValid(dob_id))
+		{
+			WARN_PRINT_ONCE("LDobList::UpdateDobs : invalid dob ID");
+			pRoomIDs[n] = -1;
+			continue;
+		}
+
+		pRoomIDs[n] = UpdateDob(manager, dob_id, pPositions[n]);
+	}
+}
+
 /*
 	// get _global_transform DOES NOT WORK when detached from scene tree (or hidden)
 	const Vector3 &pt = pDOB->get_global_transform().origin;
@@ -5,54 +5,86 @@
 
 class LRoomManager;
 
+// The dob IDs handed out are handles, containing the slot in the list and a generation.
+// The generation is incremented each time a slot is freed, so stale IDs can be detected.
+// Free slots are kept in an intrusive linked list, so register / unregister / lookup are all O(1).
 class LDobList
 {
 public:
-	// getting
-	LDob &GetDob(int n) {return m_List[n];}
-	const LDob &GetDob(int n) const {return m_List[n];}
+	enum
+	{
+		HANDLE_SLOT_BITS = 20,
+		HANDLE_SLOT_MASK = (1 << HANDLE_SLOT_BITS) - 1,
+		HANDLE_GENERATION_MASK = (1 << (31 - HANDLE_SLOT_BITS)) - 1,
+		// don't bother compacting tiny lists
+		COMPACT_MIN_SIZE = 64,
+	};
+
+	LDobList() {m_iFirstFree = -1; m_iNumUsed = 0; m_iNewSlotGeneration = 0;}
+
+	// getting (the handle must be valid, check with IsValid at the API boundary)
+	LDob &GetDob(int handle) {return m_List[Handle_GetSlot(handle)];}
+	const LDob &GetDob(int handle) const {return m_List[Handle_GetSlot(handle)];}
+	bool IsValid(int handle) const;
+
+	// for iterating over all the slots, returns the handle of the dob in the slot or -1 if free
+	int GetNumSlots() const {return m_List.size();}
+	int GetSlotHandle(int slot) const;
+	static int Handle_GetSlot(int handle) {return handle & HANDLE_SLOT_MASK;}
 
 	// request delete
 	int Request();
-	void DeleteDob(int id);
+	bool DeleteDob(int handle);
 
 	// funcs
 	int UpdateDob(LRoomManager &manager, int dob_id, const Vector3 &pos);
-	void UpdateVisibility(LRoomManager &manager, Spatial * pDOBSpatial, int dob_id);
+	// batched version, writes the room ID (or -1 for invalid dobs) for each dob to pRoomIDs
+	void UpdateDobs(LRoomManager &manager, const int * pDobIDs, const Vector3 * pPositions, int num, int * pRoomIDs);
+	// show or hide the dob (noop if no change).
+	// Dobs that are only casting shadows are shown on the light layer only.
+	void ShowDob(int dob_id, bool bVisible, bool bCaster);
 
 private:
 	bool FindDOBOldAndNewRoom(LRoomManager &manager, int dob_id, const Vector3 &pos, int &old_room_id, int &new_room_id);
 
+	static int Handle_Make(int slot, int generation) {return ((generation & HANDLE_GENERATION_MASK) << HANDLE_SLOT_BITS) | slot;}
+	void Compact();
+
 	LVector<LDob> m_List;
+
+	// intrusive free list through LDob::m_iNextFree
+	int m_iFirstFree;
+	int m_iNumUsed;
+
+	// slots that are removed by compacting lose their generation, so new slots
+	// start after the highest generation that has been discarded
+	int m_iNewSlotGeneration;
 };
 
 
 /////////////////////////////////////////////////////////
 
-inline void LDobList::DeleteDob(int id)
+inline bool LDobList::IsValid(int handle) const
 {
-	GetDob(id).m_bSlotTaken = false;
-}
+	if (handle < 0)
+		return false;
+
+	int slot = Handle_GetSlot(handle);
+	if (slot >= m_List.size())
+		return false;
+
+	const LDob &dob = m_List[slot];
+	if (!dob.m_bSlotTaken)
+		return false;
 
+	return Handle_Make(slot, dob.m_iGeneration) == handle;
+}
 
-inline int LDobList::Request()
+inline int LDobList::GetSlotHandle(int slot) const
 {
-	for (int n=0; n<m_List.size(); n++)
-	{
-		LDob &d = m_List[n];
-		if (d.m_bSlotTaken == false)
-		{
-			d.m_bSlotTaken = true;
-			return n;
-		}
-	}
-
-	// none found, create new
-	LDob * p = m_List.request();
-	memset(p, 0, sizeof (LDob));
-
-	p->m_bSlotTaken = true;
-	p->m_iRoomID = -1;
-
-	return m_List.size()-1;
+	const LDob &dob = m_List[slot];
+	if (!dob.m_bSlotTaken)
+		return -1;
+
+	return Handle_Make(slot, dob.m_iGeneration);
 }
@@ -23,6 +23,7 @@
 #include "lroom.h"
 #include "ldebug.h"
 #include "lroom_manager.h"
+#include "lspatial_hash.h"
 
 /////////////////////////////////////////////////////////////////////
 
@@ -81,7 +82,7 @@ void LPortal::Debug_CheckPlaneValidity(const Plane &p) const
 // preprocess
 void LPortal::AddLightPlanes(LRoomManager &manager, const LLight &light, LVector<Plane> &planes, bool bReverse) const
 {
-	const Vector<Vector3> &pts = m_ptsWorld;
+	const LBakedVector<Vector3> &pts = m_ptsWorld;
 
 	int nPoints = pts.size();
 	ERR_FAIL_COND(nPoints < 3);
@@ -162,34 +163,53 @@ void LPortal::AddLightPlanes(LRoomManager &manager, const LLight &light, LVector
 
 
 // add clipping planes to the vector formed by each portal edge and the camera
-void LPortal::AddPlanes(LRoomManager &manager, const Vector3 &ptCam, LVector<Plane> &planes) const
+// The plane through the camera and a portal edge. With a radius the camera may be anywhere within the sphere,
+// so the plane is pivoted about the edge until the sphere is just outside it, which contains every view through the edge.
+void LPortal::AddEdgePlane(const Vector3 &ptCam, const Vector3 &ptA, const Vector3 &ptB, float fCamRadius, LVector<Plane> &planes) const
+{
+	Plane p(ptCam, ptA, ptB);
+
+	if (fCamRadius > 0.0f)
+	{
+		// perpendicular from the edge to the camera
+		Vector3 ptEdgeDir = (ptB - ptA).normalized();
+		Vector3 ptPerp = ptCam - ptA;
+		ptPerp -= ptEdgeDir * ptPerp.dot(ptEdgeDir);
+
+		// the sphere reaches the edge, nothing can be culled by it
+		float dist = ptPerp.length();
+		if (dist <= fCamRadius)
+			return;
+
+		float fSin = fCamRadius / dist;
+		float fCos = Math::sqrt(1.0f - (fSin * fSin));
+		p.normal = (p.normal * fCos) + (ptPerp * (fSin / dist));
+		p.d = p.normal.dot(ptA);
+	}
+
+	// detect null plane
+//	if (p.normal.length_squared() < 0.1f)
+//	{
+//		print("NULL plane detected from points : ");
+//		print(ptCam + ptA + ptB);
+//	}
+	planes.push_back(p);
+	Debug_CheckPlaneValidity(p);
+}
+
+void LPortal::AddPlanes(LRoomManager &manager, const Vector3 &ptCam, LVector<Plane> &planes, float fCamRadius) const
 {
 	// short version
-	const Vector<Vector3> &pts = m_ptsWorld;
+	const LBakedVector<Vector3> &pts = m_ptsWorld;
 
 	int nPoints = pts.size();
 	ERR_FAIL_COND(nPoints < 3);
 
-	Plane p;
-
 	for (int n=1; n<nPoints; n++)
-	{
-		p = Plane(ptCam, pts[n], pts[n-1]);
-
-		// detect null plane
-//		if (p.normal.length_squared() < 0.1f)
-//		{
-//			print("NULL plane detected from points : ");
-//			print(ptCam + pts[n] + pts[n-1]);
-//		}
-		planes.push_back(p);
-		Debug_CheckPlaneValidity(p);
-	}
+		AddEdgePlane(ptCam, pts[n], pts[n-1], fCamRadius, planes);
 
 	// first and last
-	p = Plane(ptCam, pts[0], pts[nPoints-1]);
-	planes.push_back(p);
-	Debug_CheckPlaneValidity(p);
+	AddEdgePlane(ptCam, pts[0], pts[nPoints-1], fCamRadius, planes);
 
 	// debug
 	if (!manager.m_bDebugPlanes)
@@ -235,6 +255,7 @@ void LPortal::CreateGeometry(PoolVector<Vector3> p_vertices, const Transform &tr
 	ERR_FAIL_COND(nPoints < 3);
 
 	m_ptsWorld.clear();
+	LVertexHash vertex_hash(0.001f);
 
 	//print("\t\t\tLPortal::CreateGeometry nPoints : " + itos(nPoints));
 
@@ -250,18 +271,8 @@ void LPortal::CreateGeometry(PoolVector<Vector3> p_vertices, const Transform &tr
 
 		// new!! test for duplicates. Some geometry may contain duplicate verts in portals which will muck up
 		// the winding etc...
-		bool bDuplicate = false;
-		for (int m=0; m<m_ptsWorld.size(); m++)
-		{
-			Vector3 ptDiff = ptWorld - m_ptsWorld[m];
-			if (ptDiff.length() < 0.001f)
-			{
-				bDuplicate = true;
-				break;
-			}
-		}
-
-		if (!bDuplicate)
+		// hashed so large portals don't need to test against every vertex so far
+		if (vertex_hash.AddIfUnique(ptWorld))
 		{
 			m_ptsWorld.push_back(ptWorld);
 			m_ptCentre += ptWorld;
@@ -278,7 +289,7 @@ void LPortal::CreateGeometry(PoolVector<Vector3> p_vertices, const Transform &tr
 
 void LPortal::SortVertsClockwise(bool bPortalPlane_Convention)
 {
-	Vector<Vector3> &verts = m_ptsWorld;
+	LBakedVector<Vector3> &verts = m_ptsWorld;
 
 	// We first assumed first 3 determine the desired normal
 
@@ -358,8 +369,8 @@ void LPortal::SortVertsClockwise(bool bPortalPlane_Convention)
 
 void LPortal::ReverseWindingOrder()
 {
-	Vector<Vector3> &verts = m_ptsWorld;
-	Vector<Vector3> copy = verts;
+	LBakedVector<Vector3> &verts = m_ptsWorld;
+	LBakedVector<Vector3> copy = verts;
 
 	for (int n=0; n<verts.size(); n++)
 	{
@@ -55,14 +55,15 @@ public:
 	String m_szName;
 
 	LPortal::eClipResult ClipWithPlane(const Plane &p) const;
-	void AddPlanes(LRoomManager &manager, const Vector3 &ptCam, LVector<Plane> &planes) const;
+	// with a radius, the planes cover the view through the portal from anywhere within that distance of ptCam
+	void AddPlanes(LRoomManager &manager, const Vector3 &ptCam, LVector<Plane> &planes, float fCamRadius = 0.0f) const;
 
 	// reverse direction if we are going back through portals TOWARDS the light rather than away from it
 	// (the planes will need reversing because the portal winding will be opposite)
 	void AddLightPlanes(LRoomManager &manager, const LLight &light, LVector<Plane> &planes, bool bReverse) const;
 
-	// normal determined by winding order
-	Vector<Vector3> m_ptsWorld;
+	// normal determined by winding order, may point into baked data
+	LBakedVector<Vector3> m_ptsWorld;
 	Vector3 m_ptCentre; // world
 	Plane m_Plane;
 
@@ -86,6 +87,7 @@ public:
 	static String FindNameAfter(Node * pNode, String szStart);
 
 private:
+	void AddEdgePlane(const Vector3 &ptCam, const Vector3 &ptA, const Vector3 &ptB, float fCamRadius, LVector<Plane> &planes) const;
 	void Debug_CheckPlaneValidity(const Plane &p) const;
 };
 
@@ -18,6 +18,8 @@
 #include "register_types.cpp"
 #include "ldebug.cpp"
 #include "ldoblist.cpp"
+#include "ldob_queue.cpp"
+#include "ldob_grid.cpp"
 #include "lroom.cpp"
 #include "lroom_manager.cpp"
 #include "lroom_converter.cpp"
@@ -28,8 +30,14 @@
 #include "lbitfield_dynamic.cpp"
 #include "lhelper.cpp"
 #include "lscene_saver.cpp"
+#include "lroom_baker.cpp"
+#include "lbaked_data.cpp"
+#include "lworker_pool.cpp"
+#include "lroom_streamer.cpp"
+#include "lspatial_hash.cpp"
 #include "ltrace.cpp"
 #include "lmain_camera.cpp"
 #include "larea.cpp"
+#include "lroom_bvh.cpp"
 #include "ldae_exporter.cpp"
 
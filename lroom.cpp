@@ -30,6 +30,8 @@
 LRoom::LRoom() {
 	m_RoomID = -1;
 	m_uiFrameTouched = 0;
+	m_iFrameDepth = 0;
+	m_uiLightMark = 0;
 	m_iFirstPortal = 0;
 	m_iNumPortals = 0;
 	m_bVisible = true;
@@ -39,6 +41,12 @@ LRoom::LRoom() {
 
 	m_iFirstShadowCaster_SOB = 0;
 	m_iNumShadowCasters_SOB = 0;
+
+	m_bRemoved = false;
+	m_bManualBound = false;
+
+	m_bCacheValid = false;
+	m_pGodotRoom = 0;
 }
 
 
@@ -46,12 +54,62 @@ LRoom::LRoom() {
 
 Spatial * LRoom::GetGodotRoom() const
 {
-	Object *pObj = ObjectDB::get_instance(m_GodotID);
+	if (!m_bCacheValid)
+	{
+		Object *pObj = ObjectDB::get_instance(m_GodotID);
+
+		// assuming is a portal
+		m_pGodotRoom = Object::cast_to<Spatial>(pObj);
+		m_bCacheValid = true;
+	}
+
+	return m_pGodotRoom;
+}
 
-	// assuming is a portal
-	Spatial * pSpat = Object::cast_to<Spatial>(pObj);
 
-	return pSpat;
+void LRoom::DOB_Add(LRoomManager &manager, int dob_id)
+{
+	m_DOBs.push_back(dob_id);
+
+	if (m_DobGrid.IsActive())
+		m_DobGrid.Add(manager.m_DobList, dob_id);
+	else if (m_DOBs.size() >= LDobGrid::CREATE_NUM_DOBS)
+		m_DobGrid.Create(manager.m_DobList, m_AABB, m_DOBs);
+}
+
+bool LRoom::DOB_Remove(LRoomManager &manager, int dob_id)
+{
+	int n = m_DOBs.find(dob_id);
+	if (n == -1)
+		return false;
+
+	m_DOBs.remove_unsorted(n);
+
+	if (m_DobGrid.IsActive())
+	{
+		m_DobGrid.Remove(manager.m_DobList, dob_id);
+
+		if (m_DOBs.size() < LDobGrid::DESTROY_NUM_DOBS)
+			m_DobGrid.Destroy(manager.m_DobList, m_DOBs);
+	}
+
+	return true;
+}
+
+void LRoom::DOB_Move(LRoomManager &manager, int dob_id)
+{
+	if (m_DobGrid.IsActive())
+		m_DobGrid.Move(manager.m_DobList, dob_id);
+}
+
+void LRoom::DOBs_Hide(LRoomManager &manager)
+{
+	for (int n=0; n<m_DOBs.size(); n++)
+	{
+		int dob_id = m_DOBs[n];
+		if (dob_id != manager.m_DOB_id_camera)
+			manager.m_DobList.ShowDob(dob_id, false, false); // any casters are reshown after the light traces
+	}
 }
 
 
@@ -321,42 +379,24 @@ void LRoom::FinalizeVisibility(LRoomManager &manager)
 
 	//print_line("FinalizeVisibility room " + get_name() + " NumSOBs " + itos(m_SOBs.size()) + ", NumDOBs " + itos(m_DOBs.size()));
 
-#ifndef LPORTAL_DOBS_NO_SOFTSHOW
+	// dobs that were found by the camera trace are shown, the rest are culled,
+	// unless they were found by a light trace to be casting a shadow into view
+	unsigned int uiFrame = manager.m_uiFrameCounter;
+
 	for (int n=0; n<m_DOBs.size(); n++)
 	{
-		const LDob &dob = m_DOBs[n];
+		int dob_id = m_DOBs[n];
 
 		// don't cull the main camera
-		//if (dob.m_ID_Spatial == manager.m_ID_camera)
-		//	continue;
+		if (dob_id == manager.m_DOB_id_camera)
+			continue;
 
-		VisualInstance * pVI = dob.GetVI();
-		if (pVI)
-		{
-			uint32_t mask = 0;
-			if (dob.m_bVisible)
-			{
-				mask = LRoom::LAYER_MASK_CAMERA | LRoom::LAYER_MASK_LIGHT;
-			}
-			else
-			{
-				// special case
-				// don't cull the main camera
-				if (dob.m_ID_Spatial == manager.m_ID_camera)
-					mask = LRoom::LAYER_MASK_CAMERA | LRoom::LAYER_MASK_LIGHT;
-			}
+		const LDob &dob = manager.m_DobList.GetDob(dob_id);
+		bool bVisible = dob.m_uiFrameVisible == uiFrame;
+		bool bCaster = dob.m_uiFrameCaster == uiFrame;
 
-			SoftShow(pVI, mask);
-//			if (dob.m_bVisible)
-//			{
-//				//print("LRoom::FinalizeVisibility making visible dob " + pS->get_name());
-//				pS->show();
-//			}
-//			else
-//				pS->hide();
-		}
+		manager.m_DobList.ShowDob(dob_id, bVisible, bCaster);
 	}
-#endif
 
 }
 
@@ -521,7 +561,7 @@ void LRoom::DetermineVisibility_Recursive(LRoomManager &manager, int depth, cons
 
 
 		// estimate the radius .. for now
-		const AABB &bb = sob.m_aabb;
+		const AABB &bb = manager.m_SOB_AABBs[n];
 
 //		print("\t\t\tculling object " + pObj->get_name());
 
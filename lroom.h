@@ -31,6 +31,7 @@
 #include "lvector.h"
 #include "ldob.h"
 #include "lbound.h"
+#include "ldob_grid.h"
 
 
 namespace Lawn {class LBitField_Dynamic;}
@@ -57,8 +58,11 @@ public:
 	int m_iFirstSOB;
 	int m_iNumSOBs;
 
-	// dynamic objects
-	//LVector<uint32_t> m_DOB_ids;
+	// dynamic objects within the room (dob IDs), maintained by the dob updates
+	LVector<int> m_DOBs;
+
+	// only active for rooms containing many dobs
+	LDobGrid m_DobGrid;
 
 	// local lights affecting this room
 	LVector<int> m_LocalLights;
@@ -87,12 +91,25 @@ public:
 
 	// frame counter when last touched .. prevents handling rooms multiple times
 	unsigned int m_uiFrameTouched;
+	// portal depth from the camera when last touched
+	int m_iFrameDepth;
+
+	// for finding the difference between light affected room sets
+	unsigned int m_uiLightMark;
 
 	// optional bounding convex hull, for accurate detection of which room to start in
 	// when registering DOBs and teleporting them
 	LBound m_Bound;
 
+	// the bound came from a bound_ mesh, which is deleted on conversion,
+	// so the hull is kept to build the bound again on rebuilding the room
+	bool m_bManualBound;
+
 	String m_szName;
+
+	// removed by incremental conversion, the slot is kept so the other room IDs stay valid
+	// and is reused by the next room added
+	bool m_bRemoved;
 	////////////////////////////////////////////////////////////
 
 	const String &get_name() const {return m_szName;}
@@ -115,21 +132,24 @@ public:
 	// naive version, adds all the non visible objects in visible rooms as shadow casters
 	void AddShadowCasters(LRoomManager &manager);
 
-//	void DOB_Add(int id);
-//	int DOB_GetID(unsigned int ui) const {return m_DOB_ids[ui];}
-//	unsigned int DOB_Find(int id) const;
-//	bool DOB_Remove(unsigned int ui);
-//	LRoom * DOB_Update(LRoomManager &manager, Spatial * pDOB);
+	// the dob position must be up to date before calling these
+	void DOB_Add(LRoomManager &manager, int dob_id);
+	bool DOB_Remove(LRoomManager &manager, int dob_id);
+	void DOB_Move(LRoomManager &manager, int dob_id);
+
+	// hide all the dobs in the room, when the room is no longer visible
+	void DOBs_Hide(LRoomManager &manager);
 
 	LRoom();
 	Spatial * GetGodotRoom() const;
+	void Cache_Invalidate() {m_bCacheValid = false;}
 
 	// light casting .. changing the local light list
 	bool RemoveLocalLight(int light_id);
 	void AddLocalLight(int light_id) {m_LocalLights.push_back(light_id);}
 
-	// retained purely for debugging visualization
-	Geometry::MeshData m_Bound_MeshData;
+	// the hull the bound was made from
+	LBoundHull m_BoundHull;
 
 	bool IsVisible() const {return m_bVisible;}
 	// instead of directly showing and hiding objects we now set their layer,
@@ -143,6 +163,9 @@ private:
 	// this allows us to show / hide dobs as they cross room boundaries
 	bool m_bVisible;
 
+	// cached godot room, see LHidable
+	mutable bool m_bCacheValid;
+	mutable Spatial * m_pGodotRoom;
 };
 
 
@@ -0,0 +1,587 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "lroom_baker.h"
+#include "lroom_manager.h"
+#include "ldebug.h"
+#include "core/os/file_access.h"
+#include "scene/3d/light.h"
+
+#define LMAN m_pManager
+
+
+void LRoomBaker::Clear()
+{
+	m_Rooms.clear(true);
+	m_Portals.clear(true);
+	m_SOBs.clear(true);
+	m_Lights.clear(true);
+	m_Areas.clear(true);
+
+	m_Ints.clear(true);
+	m_Planes.clear(true);
+	m_Verts.clear(true);
+	m_Strings.clear(true);
+	m_Chars.clear(true);
+	m_DeletedNodes.clear(true);
+
+	m_pData = 0;
+	m_pInts = 0;
+	m_pPlanes = 0;
+	m_pVerts = 0;
+}
+
+LRoomBaker::LSpan LRoomBaker::Ints_Add(const LVector<int> &ints)
+{
+	LSpan span = Span_Make(m_Ints.size(), ints.size());
+
+	for (int n=0; n<ints.size(); n++)
+		m_Ints.push_back(ints[n]);
+
+	return span;
+}
+
+LRoomBaker::LSpan LRoomBaker::Ints_Add(const LBakedVector<int32_t> &ints)
+{
+	LSpan span = Span_Make(m_Ints.size(), ints.size());
+
+	for (int n=0; n<ints.size(); n++)
+		m_Ints.push_back(ints[n]);
+
+	return span;
+}
+
+LRoomBaker::LSpan LRoomBaker::Verts_Add(const LBakedVector<Vector3> &pts)
+{
+	LSpan span = Span_Make(m_Verts.size(), pts.size());
+
+	for (int n=0; n<pts.size(); n++)
+		m_Verts.push_back(pts[n]);
+
+	return span;
+}
+
+LRoomBaker::LSpan LRoomBaker::Planes_Add(const LBakedVector<Plane> &planes)
+{
+	LSpan span = Span_Make(m_Planes.size(), planes.size());
+
+	for (int n=0; n<planes.size(); n++)
+		m_Planes.push_back(planes[n]);
+
+	return span;
+}
+
+int32_t LRoomBaker::Strings_Add(const String &sz)
+{
+	CharString cs = sz.utf8();
+	const char * pc = cs.get_data();
+
+	m_Strings.push_back(Span_Make(m_Chars.size(), cs.length()));
+	for (int n=0; n<cs.length(); n++)
+		m_Chars.push_back(pc[n]);
+
+	return m_Strings.size() - 1;
+}
+
+// paths are stored relative to the room list
+int32_t LRoomBaker::Strings_AddPath(Node * pNode)
+{
+	if (!pNode)
+		return -1;
+
+	NodePath path = m_pRoomList->get_path_to(pNode);
+	return Strings_Add(path);
+}
+
+void LRoomBaker::Ints_Get(const LSpan &span, LVector<int> &ints) const
+{
+	ints.resize(span.m_Num);
+
+	for (int n=0; n<span.m_Num; n++)
+		ints[n] = m_pInts[span.m_First + n];
+}
+
+Node * LRoomBaker::Strings_FindNode(int32_t id) const
+{
+	if (id < 0)
+		return 0;
+
+	NodePath path = m_pData->GetString(id);
+	if (!m_pRoomList->has_node(path))
+		return 0;
+
+	return m_pRoomList->get_node(path);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool LRoomBaker::Save(LRoomManager &manager, String szFilename)
+{
+	m_pManager = &manager;
+	m_pRoomList = manager.GetRoomList();
+	Clear();
+
+	if (!LMAN->m_Rooms.size())
+	{
+		LWARN(2, "rooms_save_baked : no rooms converted");
+		return false;
+	}
+
+	// removed rooms and gaps in the lists
+	if (LMAN->m_Incremental.m_bChanged)
+	{
+		LWARN(2, "rooms_save_baked : rooms have been changed since conversion, call rooms_convert before saving");
+		return false;
+	}
+
+	Error err;
+	m_pFile = FileAccess::open(szFilename, FileAccess::WRITE, &err);
+	if (!m_pFile)
+	{
+		LWARN(2, "rooms_save_baked : could not open file : " + szFilename);
+		return false;
+	}
+
+	Save_Rooms();
+	Save_Portals();
+	Save_SOBs();
+	Save_Lights();
+	Save_Areas();
+
+	for (int n=0; n<LMAN->m_ConvertDeletedNodes.size(); n++)
+		m_DeletedNodes.push_back(Strings_Add(LMAN->m_ConvertDeletedNodes[n]));
+
+	Save_SetSection(LBakedData::SEC_ROOMS, m_Rooms);
+	Save_SetSection(LBakedData::SEC_PORTALS, m_Portals);
+	Save_SetSection(LBakedData::SEC_SOBS, m_SOBs);
+	Save_SetSection(LBakedData::SEC_SOB_AABBS, LMAN->m_SOB_AABBs);
+	Save_SetSection(LBakedData::SEC_LIGHTS, m_Lights);
+	Save_SetSection(LBakedData::SEC_AREAS, m_Areas);
+	Save_SetSection(LBakedData::SEC_LIGHT_CASTERS, LMAN->m_LightCasters_SOB);
+	Save_SetSection(LBakedData::SEC_SHADOW_CASTERS, LMAN->m_ShadowCasters_SOB);
+	Save_SetSection(LBakedData::SEC_AREA_LIGHTS, LMAN->m_AreaLights);
+	Save_SetSection(LBakedData::SEC_AREA_ROOMS, LMAN->m_AreaRooms);
+	Save_SetSection(LBakedData::SEC_INTS, m_Ints);
+	Save_SetSection(LBakedData::SEC_PLANES, m_Planes);
+	Save_SetSection(LBakedData::SEC_VERTS, m_Verts);
+	Save_SetSection(LBakedData::SEC_DELETED_NODES, m_DeletedNodes);
+	Save_SetSection(LBakedData::SEC_STRINGS, m_Strings);
+	Save_SetSection(LBakedData::SEC_CHARS, m_Chars);
+
+	Save_Write();
+
+	m_pFile->close();
+	memdelete(m_pFile);
+	m_pFile = 0;
+
+	// any managers sharing an older version of the file keep it, new loads will read the new one
+	LBakedData::Shared_Forget(szFilename);
+
+	LPRINT(5, "rooms_save_baked : " + szFilename + ", " + itos(m_Rooms.size()) + " rooms, " + itos(m_SOBs.size()) + " SOBs, " + itos(m_Lights.size()) + " lights");
+
+	Clear();
+	return true;
+}
+
+template <class T> void LRoomBaker::Save_SetSection(LBakedData::eSection section, const T &vec)
+{
+	LSectionData &sd = m_Sections[section];
+	sd.m_iNum = vec.size();
+	sd.m_iBytes = vec.size() ? (vec.size() * sizeof (vec[0])) : 0;
+	sd.m_pData = vec.size() ? (const uint8_t *) &vec[0] : 0;
+}
+
+void LRoomBaker::Save_Write()
+{
+	LBakedData::LHeader header;
+	memset(&header, 0, sizeof (header));
+	memcpy(header.m_szMagic, LBakedData::m_szMagic, 4);
+	header.m_Version = LBakedData::BAKED_VERSION;
+	header.m_EndianCheck = LBakedData::m_iEndianCheck;
+	header.m_SizeRoom = sizeof (LRecRoom);
+	header.m_SizePortal = sizeof (LRecPortal);
+	header.m_SizeSob = sizeof (LRecSob);
+	header.m_SizeLight = sizeof (LRecLight);
+	header.m_SizeArea = sizeof (LRecArea);
+	header.m_SizeReal = sizeof (real_t);
+
+	// lay out the sections one after another, aligned so they can be used in place
+	const int align = LBakedData::SECTION_ALIGN;
+	int offset = (sizeof (header) + align - 1) & ~(align - 1);
+	for (int s=0; s<LBakedData::NUM_SECTIONS; s++)
+	{
+		header.m_Sections[s].m_Offset = offset;
+		header.m_Sections[s].m_Num = m_Sections[s].m_iNum;
+		offset = (offset + m_Sections[s].m_iBytes + align - 1) & ~(align - 1);
+	}
+	header.m_BlockSize = offset;
+
+	const uint8_t padding[LBakedData::SECTION_ALIGN] = {0};
+
+	m_pFile->store_buffer((const uint8_t *) &header, sizeof (header));
+	int written = sizeof (header);
+
+	for (int s=0; s<LBakedData::NUM_SECTIONS; s++)
+	{
+		m_pFile->store_buffer(padding, header.m_Sections[s].m_Offset - written);
+		written = header.m_Sections[s].m_Offset;
+
+		if (m_Sections[s].m_iBytes)
+			m_pFile->store_buffer(m_Sections[s].m_pData, m_Sections[s].m_iBytes);
+		written += m_Sections[s].m_iBytes;
+	}
+
+	m_pFile->store_buffer(padding, header.m_BlockSize - written);
+}
+
+void LRoomBaker::Save_Rooms()
+{
+	for (int n=0; n<LMAN->m_Rooms.size(); n++)
+	{
+		const LRoom &lroom = LMAN->m_Rooms[n];
+
+		LRecRoom rec;
+		rec.m_Path = Strings_AddPath(lroom.GetGodotRoom());
+		rec.m_Name = Strings_Add(lroom.m_szName);
+		rec.m_PublicID = LMAN->RoomID_ToPublic(n);
+		rec.m_SOBs = Span_Make(lroom.m_iFirstSOB, lroom.m_iNumSOBs);
+		rec.m_Portals = Span_Make(lroom.m_iFirstPortal, lroom.m_iNumPortals);
+		rec.m_ShadowCasters = Span_Make(lroom.m_iFirstShadowCaster_SOB, lroom.m_iNumShadowCasters_SOB);
+
+		rec.m_ptCentre = lroom.m_ptCentre;
+		rec.m_AABB = lroom.m_AABB;
+
+		rec.m_Planes = Planes_Add(lroom.m_Bound.m_Planes);
+		rec.m_LocalLights = Ints_Add(lroom.m_LocalLights);
+		rec.m_GlobalLights = Ints_Add(lroom.m_GlobalLights);
+		rec.m_Areas = Ints_Add(lroom.m_Areas);
+
+		// bound hull, for debug drawing and rebuilding manual bounds
+		const LBoundHull &hull = lroom.m_BoundHull;
+		rec.m_BoundVerts = Verts_Add(hull.m_Verts);
+		rec.m_BoundFaces = Ints_Add(hull.m_Faces);
+		rec.m_BoundFacePlanes = Planes_Add(hull.m_FacePlanes);
+		rec.m_ManualBound = lroom.m_bManualBound ? 1 : 0;
+
+		m_Rooms.push_back(rec);
+	}
+}
+
+void LRoomBaker::Save_Portals()
+{
+	for (int n=0; n<LMAN->m_Portals.size(); n++)
+	{
+		const LPortal &port = LMAN->m_Portals[n];
+
+		LRecPortal rec;
+		rec.m_Name = Strings_Add(port.m_szName);
+		rec.m_RoomNum = port.m_iRoomNum;
+		rec.m_Mirror = port.m_bMirror;
+		rec.m_Plane = port.m_Plane;
+		rec.m_ptCentre = port.m_ptCentre;
+		rec.m_Verts = Verts_Add(port.m_ptsWorld);
+
+		m_Portals.push_back(rec);
+	}
+}
+
+void LRoomBaker::Save_SOBs()
+{
+	for (int n=0; n<LMAN->m_SOBs.size(); n++)
+	{
+		const LSob &sob = LMAN->m_SOBs[n];
+
+		LRecSob rec;
+		rec.m_Path = Strings_AddPath(sob.m_pNode);
+
+		m_SOBs.push_back(rec);
+	}
+}
+
+void LRoomBaker::Save_Lights()
+{
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		const LLight &light = LMAN->m_Lights[n];
+
+		LRecLight rec;
+		rec.m_Path = Strings_AddPath(light.m_pNode);
+		rec.m_Area = Strings_Add(light.m_szArea);
+		rec.m_AreaID = light.m_iArea;
+		rec.m_RoomID = light.m_Source.m_RoomID;
+		rec.m_Casters = Span_Make(light.m_FirstCaster, light.m_NumCasters);
+
+		LVector<int> affected_rooms;
+		for (int r=0; r<light.m_NumAffectedRooms; r++)
+			affected_rooms.push_back(LMAN->Light_GetAffectedRoom(light, r));
+		rec.m_AffectedRooms = Ints_Add(affected_rooms);
+
+		m_Lights.push_back(rec);
+	}
+}
+
+void LRoomBaker::Save_Areas()
+{
+	for (int n=0; n<LMAN->m_Areas.size(); n++)
+	{
+		const LArea &area = LMAN->m_Areas[n];
+
+		LRecArea rec;
+		rec.m_Name = Strings_Add(area.m_szName);
+		rec.m_Rooms = Span_Make(area.m_iFirstRoom, area.m_iNumRooms);
+		rec.m_Lights = Span_Make(area.m_iFirstLight, area.m_iNumLights);
+
+		m_Areas.push_back(rec);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool LRoomBaker::Load(LRoomManager &manager, String szFilename)
+{
+	m_pManager = &manager;
+	m_pRoomList = manager.GetRoomList();
+	Clear();
+
+	// shared with any other managers that have loaded the same file
+	LBakedData * pData = LBakedData::Acquire(szFilename);
+	if (!pData)
+		return false;
+
+	m_pData = pData;
+	m_pInts = pData->Get<int32_t>(LBakedData::SEC_INTS);
+	m_pPlanes = pData->Get<Plane>(LBakedData::SEC_PLANES);
+	m_pVerts = pData->Get<Vector3>(LBakedData::SEC_VERTS);
+
+	// from here on we are replacing the manager state
+	LMAN->ReleaseResources(false);
+
+	// the order matters, lights refer to areas, and rooms must exist before the lights add their affected rooms
+	bool bOK = Load_Areas() && Load_Rooms() && Load_Portals() && Load_SOBs() && Load_Lights();
+
+	if (!bOK)
+	{
+		// nodes not found, the scene has changed since baking
+		LWARN(2, "rooms_load_baked : scene does not match the file, reconvert : " + szFilename);
+		LMAN->ReleaseResources(false);
+		pData->Release();
+		Clear();
+		return false;
+	}
+
+	// the flat lists are used in place
+	LMAN->m_pBakedData = pData;
+	LMAN->m_SOB_AABBs.set_external(pData->Get<AABB>(LBakedData::SEC_SOB_AABBS), pData->GetNum(LBakedData::SEC_SOB_AABBS));
+	LMAN->m_LightCasters_SOB.set_external(pData->Get<uint32_t>(LBakedData::SEC_LIGHT_CASTERS), pData->GetNum(LBakedData::SEC_LIGHT_CASTERS));
+	LMAN->m_ShadowCasters_SOB.set_external(pData->Get<uint32_t>(LBakedData::SEC_SHADOW_CASTERS), pData->GetNum(LBakedData::SEC_SHADOW_CASTERS));
+	LMAN->m_AreaLights.set_external(pData->Get<uint32_t>(LBakedData::SEC_AREA_LIGHTS), pData->GetNum(LBakedData::SEC_AREA_LIGHTS));
+	LMAN->m_AreaRooms.set_external(pData->Get<uint32_t>(LBakedData::SEC_AREA_ROOMS), pData->GetNum(LBakedData::SEC_AREA_ROOMS));
+
+	LMAN->m_RoomBVH.Create(LMAN->m_Rooms);
+	LMAN->CreateBitfields();
+	LMAN->ObjectCache_WatchAll();
+
+	// so the scene ends up the same as after conversion
+	Load_DeleteNodes();
+
+	LPRINT(5, "rooms_load_baked : " + szFilename + ", " + itos(LMAN->m_Rooms.size()) + " rooms, " + itos(LMAN->m_SOBs.size()) + " SOBs, " + itos(LMAN->m_Lights.size()) + " lights");
+
+	Clear();
+	return true;
+}
+
+bool LRoomBaker::Load_Rooms()
+{
+	const LRecRoom * pRecs = m_pData->Get<LRecRoom>(LBakedData::SEC_ROOMS);
+	int nRooms = m_pData->GetNum(LBakedData::SEC_ROOMS);
+	LMAN->m_Rooms.resize(nRooms);
+
+	for (int n=0; n<nRooms; n++)
+	{
+		const LRecRoom &rec = pRecs[n];
+		LRoom &lroom = LMAN->m_Rooms[n];
+
+		Spatial * pGRoom = Object::cast_to<Spatial>(Strings_FindNode(rec.m_Path));
+		if (!pGRoom)
+		{
+			LWARN(2, "rooms_load_baked : room not found : " + m_pData->GetString(rec.m_Path));
+			return false;
+		}
+
+		lroom.m_GodotID = pGRoom->get_instance_id();
+		lroom.m_RoomID = n;
+		lroom.m_szName = m_pData->GetString(rec.m_Name);
+
+		lroom.m_iFirstSOB = rec.m_SOBs.m_First;
+		lroom.m_iNumSOBs = rec.m_SOBs.m_Num;
+		lroom.m_iFirstPortal = rec.m_Portals.m_First;
+		lroom.m_iNumPortals = rec.m_Portals.m_Num;
+		lroom.m_iFirstShadowCaster_SOB = rec.m_ShadowCasters.m_First;
+		lroom.m_iNumShadowCasters_SOB = rec.m_ShadowCasters.m_Num;
+
+		lroom.m_ptCentre = rec.m_ptCentre;
+		lroom.m_AABB = rec.m_AABB;
+
+		// the geometry is used in place
+		lroom.m_Bound.m_Planes.set_external(m_pPlanes + rec.m_Planes.m_First, rec.m_Planes.m_Num);
+
+		Ints_Get(rec.m_LocalLights, lroom.m_LocalLights);
+		Ints_Get(rec.m_GlobalLights, lroom.m_GlobalLights);
+		Ints_Get(rec.m_Areas, lroom.m_Areas);
+
+		lroom.m_bManualBound = rec.m_ManualBound != 0;
+
+		LBoundHull &hull = lroom.m_BoundHull;
+		hull.m_Verts.set_external(m_pVerts + rec.m_BoundVerts.m_First, rec.m_BoundVerts.m_Num);
+		hull.m_Faces.set_external(m_pInts + rec.m_BoundFaces.m_First, rec.m_BoundFaces.m_Num);
+		hull.m_FacePlanes.set_external(m_pPlanes + rec.m_BoundFacePlanes.m_First, rec.m_BoundFacePlanes.m_Num);
+	}
+
+	// the rooms may have been reordered on conversion
+	LVector<int> to_public;
+	for (int n=0; n<nRooms; n++)
+		to_public.push_back(pRecs[n].m_PublicID);
+	LMAN->RoomID_SetRemap(to_public);
+
+	return true;
+}
+
+bool LRoomBaker::Load_Portals()
+{
+	const LRecPortal * pRecs = m_pData->Get<LRecPortal>(LBakedData::SEC_PORTALS);
+	int nPortals = m_pData->GetNum(LBakedData::SEC_PORTALS);
+
+	for (int n=0; n<nPortals; n++)
+	{
+		const LRecPortal &rec = pRecs[n];
+
+		LPortal &port = *LMAN->m_Portals.request();
+		port = LPortal();
+		port.m_szName = m_pData->GetString(rec.m_Name);
+		port.m_iRoomNum = rec.m_RoomNum;
+		port.m_bMirror = rec.m_Mirror != 0;
+		port.m_Plane = rec.m_Plane;
+		port.m_ptCentre = rec.m_ptCentre;
+		port.m_ptsWorld.set_external(m_pVerts + rec.m_Verts.m_First, rec.m_Verts.m_Num);
+	}
+
+	return true;
+}
+
+bool LRoomBaker::Load_SOBs()
+{
+	const LRecSob * pRecs = m_pData->Get<LRecSob>(LBakedData::SEC_SOBS);
+	int nSOBs = m_pData->GetNum(LBakedData::SEC_SOBS);
+
+	for (int n=0; n<nSOBs; n++)
+	{
+		const LRecSob &rec = pRecs[n];
+
+		VisualInstance * pVI = Object::cast_to<VisualInstance>(Strings_FindNode(rec.m_Path));
+		if (!pVI)
+		{
+			LWARN(2, "rooms_load_baked : SOB not found : " + m_pData->GetString(rec.m_Path));
+			return false;
+		}
+
+		LSob sob;
+		sob.m_ID = pVI->get_instance_id();
+		sob.Hidable_Create(pVI);
+		LMAN->m_SOBs.push_back(sob);
+
+		// as on conversion, take away layer 0 from the sob, so it can be culled effectively
+		pVI->set_layer_mask(0);
+	}
+
+	return true;
+}
+
+bool LRoomBaker::Load_Lights()
+{
+	const LRecLight * pRecs = m_pData->Get<LRecLight>(LBakedData::SEC_LIGHTS);
+	int nLights = m_pData->GetNum(LBakedData::SEC_LIGHTS);
+
+	for (int n=0; n<nLights; n++)
+	{
+		const LRecLight &rec = pRecs[n];
+
+		Light * pLight = Object::cast_to<Light>(Strings_FindNode(rec.m_Path));
+		if (!pLight || !LMAN->LightCreate(pLight, rec.m_RoomID, m_pData->GetString(rec.m_Area)))
+		{
+			LWARN(2, "rooms_load_baked : light not found : " + m_pData->GetString(rec.m_Path));
+			return false;
+		}
+
+		LLight &light = LMAN->m_Lights[LMAN->m_Lights.size() - 1];
+		light.m_iArea = rec.m_AreaID;
+		light.m_FirstCaster = rec.m_Casters.m_First;
+		light.m_NumCasters = rec.m_Casters.m_Num;
+
+		for (int r=0; r<rec.m_AffectedRooms.m_Num; r++)
+			LMAN->Light_AddAffectedRoom(light, m_pInts[rec.m_AffectedRooms.m_First + r]);
+	}
+
+	return true;
+}
+
+bool LRoomBaker::Load_Areas()
+{
+	const LRecArea * pRecs = m_pData->Get<LRecArea>(LBakedData::SEC_AREAS);
+	int nAreas = m_pData->GetNum(LBakedData::SEC_AREAS);
+
+	for (int n=0; n<nAreas; n++)
+	{
+		const LRecArea &rec = pRecs[n];
+
+		LArea area;
+		area.Create(m_pData->GetString(rec.m_Name));
+		area.m_iFirstRoom = rec.m_Rooms.m_First;
+		area.m_iNumRooms = rec.m_Rooms.m_Num;
+		area.m_iFirstLight = rec.m_Lights.m_First;
+		area.m_iNumLights = rec.m_Lights.m_Num;
+		LMAN->m_Areas.push_back(area);
+	}
+
+	return true;
+}
+
+void LRoomBaker::Load_DeleteNodes()
+{
+	const int32_t * pIDs = m_pData->Get<int32_t>(LBakedData::SEC_DELETED_NODES);
+	int nIDs = m_pData->GetNum(LBakedData::SEC_DELETED_NODES);
+
+	for (int n=0; n<nIDs; n++)
+	{
+		Node * pNode = Strings_FindNode(pIDs[n]);
+
+		// may already have gone, e.g. a hidden portal mesh is recorded twice
+		if (!pNode)
+			continue;
+
+		LMAN->m_ConvertDeletedNodes.push_back(m_pData->GetString(pIDs[n]));
+
+		if (pNode->get_parent())
+			pNode->get_parent()->remove_child(pNode);
+		pNode->queue_delete();
+	}
+}
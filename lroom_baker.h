@@ -0,0 +1,120 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+#include "lbaked_data.h"
+
+class LRoomManager;
+class Node;
+class FileAccess;
+
+// Saves the converted state of the room manager to a versioned binary file, and loads it back
+// instead of calling rooms_convert. Loading skips the scene walk, the bound hulls, portal creation and light tracing.
+// The file is a single relocatable block (see LBakedData), of fixed size records and pools of ints, planes, verts
+// and strings that the records index into. The flat lists and geometry in the block are used in place by the manager.
+// Godot nodes are referred to by NodePath relative to the room list, so the file is only valid
+// for the same scene it was saved from.
+class LRoomBaker
+{
+public:
+	bool Save(LRoomManager &manager, String szFilename);
+	bool Load(LRoomManager &manager, String szFilename);
+
+private:
+	typedef LBakedData::LSpan LSpan;
+	typedef LBakedData::LRecRoom LRecRoom;
+	typedef LBakedData::LRecPortal LRecPortal;
+	typedef LBakedData::LRecSob LRecSob;
+	typedef LBakedData::LRecLight LRecLight;
+	typedef LBakedData::LRecArea LRecArea;
+
+	LSpan Span_Make(int first, int num) const {LSpan span; span.m_First = first; span.m_Num = num; return span;}
+
+	// saving
+	LSpan Ints_Add(const LVector<int> &ints);
+	LSpan Ints_Add(const LBakedVector<int32_t> &ints);
+	LSpan Verts_Add(const LBakedVector<Vector3> &pts);
+	LSpan Planes_Add(const LBakedVector<Plane> &planes);
+	int32_t Strings_Add(const String &sz);
+	int32_t Strings_AddPath(Node * pNode);
+
+	void Save_Rooms();
+	void Save_Portals();
+	void Save_SOBs();
+	void Save_Lights();
+	void Save_Areas();
+	template <class T> void Save_SetSection(LBakedData::eSection section, const T &vec);
+	void Save_Write();
+
+	// loading
+	void Ints_Get(const LSpan &span, LVector<int> &ints) const;
+	Node * Strings_FindNode(int32_t id) const;
+
+	bool Load_Rooms();
+	bool Load_Portals();
+	bool Load_SOBs();
+	bool Load_Lights();
+	bool Load_Areas();
+	void Load_DeleteNodes();
+
+	void Clear();
+
+	// set up on entry
+	LRoomManager * m_pManager;
+	Node * m_pRoomList;
+
+	// saving
+	LVector<LRecRoom> m_Rooms;
+	LVector<LRecPortal> m_Portals;
+	LVector<LRecSob> m_SOBs;
+	LVector<LRecLight> m_Lights;
+	LVector<LRecArea> m_Areas;
+
+	LVector<int32_t> m_Ints;
+	LVector<Plane> m_Planes;
+	LVector<Vector3> m_Verts;
+	LVector<LSpan> m_Strings;
+	LVector<char> m_Chars;
+
+	// string IDs of the nodes that were deleted by the conversion
+	LVector<int32_t> m_DeletedNodes;
+
+	struct LSectionData
+	{
+		const uint8_t * m_pData;
+		int m_iNum;
+		int m_iBytes;
+	} m_Sections[LBakedData::NUM_SECTIONS];
+
+	FileAccess * m_pFile;
+
+	// loading, pools in the block
+	const LBakedData * m_pData;
+	const int32_t * m_pInts;
+	const Plane * m_pPlanes;
+	const Vector3 * m_pVerts;
+};
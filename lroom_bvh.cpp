@@ -0,0 +1,289 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+#include "lroom_bvh.h"
+#include "lroom.h"
+#include "ldebug.h"
+
+
+void LRoomBVH::Clear()
+{
+	m_Nodes.clear(true);
+	m_RoomIDs.clear(true);
+}
+
+void LRoomBVH::Create(const LVector<LRoom> &rooms)
+{
+	Clear();
+
+	int nRooms = rooms.size();
+	if (!nRooms)
+		return;
+
+	// rooms removed by incremental conversion are left out
+	for (int n=0; n<nRooms; n++)
+	{
+		if (!rooms[n].m_bRemoved)
+			m_RoomIDs.push_back(n);
+	}
+
+	if (!m_RoomIDs.size())
+		return;
+
+	Build_Recursive(rooms, 0, m_RoomIDs.size(), 0);
+
+	LPRINT(5, "LRoomBVH created, " + itos(m_Nodes.size()) + " nodes");
+}
+
+
+void LRoomBVH::Build_CalculateBound(const LVector<LRoom> &rooms, LNode &node) const
+{
+	float ma = FLT_MAX;
+	float mi = -FLT_MAX;
+	node.m_ptMins = Vector3(ma, ma, ma);
+	node.m_ptMaxs = Vector3(mi, mi, mi);
+	node.m_ptCentreMins = node.m_ptMins;
+	node.m_ptCentreMaxs = node.m_ptMaxs;
+
+	for (int n=0; n<node.m_iNum; n++)
+	{
+		const LRoom &lroom = rooms[m_RoomIDs[node.m_iFirst + n]];
+
+		const AABB &bb = lroom.m_AABB;
+		Vector3 ptMaxs = bb.position + bb.size;
+		const Vector3 &ptCentre = lroom.m_ptCentre;
+
+		for (int c=0; c<3; c++)
+		{
+			node.m_ptMins[c] = MIN(node.m_ptMins[c], bb.position[c]);
+			node.m_ptMaxs[c] = MAX(node.m_ptMaxs[c], ptMaxs[c]);
+			node.m_ptCentreMins[c] = MIN(node.m_ptCentreMins[c], ptCentre[c]);
+			node.m_ptCentreMaxs[c] = MAX(node.m_ptCentreMaxs[c], ptCentre[c]);
+		}
+	}
+}
+
+
+// returns the node ID
+int LRoomBVH::Build_Recursive(const LVector<LRoom> &rooms, int first, int num, int depth)
+{
+	int node_id = m_Nodes.size();
+
+	// note the pointer is only valid until the next request
+	LNode * pNode = m_Nodes.request();
+	pNode->m_iFirst = first;
+	pNode->m_iNum = num;
+	pNode->m_iChild[0] = -1;
+	pNode->m_iChild[1] = -1;
+	Build_CalculateBound(rooms, *pNode);
+
+	if ((num <= MAX_ROOMS_PER_LEAF) || (depth >= (MAX_DEPTH - 1)))
+		return node_id;
+
+	// split on the longest axis of the centres, at the midpoint
+	Vector3 ptExtents = pNode->m_ptCentreMaxs - pNode->m_ptCentreMins;
+	int axis = 0;
+	if (ptExtents.y > ptExtents[axis]) axis = 1;
+	if (ptExtents.z > ptExtents[axis]) axis = 2;
+
+	float split = pNode->m_ptCentreMins[axis] + (ptExtents[axis] * 0.5f);
+
+	// partition the room IDs either side of the split
+	int left = first;
+	int right = first + num - 1;
+	while (left <= right)
+	{
+		if (rooms[m_RoomIDs[left]].m_ptCentre[axis] < split)
+		{
+			left++;
+		}
+		else
+		{
+			int temp = m_RoomIDs[left];
+			m_RoomIDs[left] = m_RoomIDs[right];
+			m_RoomIDs[right] = temp;
+			right--;
+		}
+	}
+
+	int num_left = left - first;
+
+	// degenerate case (e.g. all centres the same), just halve
+	if ((num_left == 0) || (num_left == num))
+		num_left = num / 2;
+
+	int child_a = Build_Recursive(rooms, first, num_left, depth + 1);
+	int child_b = Build_Recursive(rooms, first + num_left, num - num_left, depth + 1);
+
+	LNode &node = m_Nodes[node_id];
+	node.m_iChild[0] = child_a;
+	node.m_iChild[1] = child_b;
+
+	return node_id;
+}
+
+
+bool LRoomBVH::PointWithin(const Vector3 &pt, const Vector3 &mins, const Vector3 &maxs)
+{
+	if ((pt.x < mins.x) || (pt.x > maxs.x)) return false;
+	if ((pt.y < mins.y) || (pt.y > maxs.y)) return false;
+	if ((pt.z < mins.z) || (pt.z > maxs.z)) return false;
+	return true;
+}
+
+float LRoomBVH::DistanceSquaredToBox(const Vector3 &pt, const Vector3 &mins, const Vector3 &maxs)
+{
+	float dist = 0.0f;
+
+	for (int c=0; c<3; c++)
+	{
+		float d = 0.0f;
+		if (pt[c] < mins[c])
+			d = mins[c] - pt[c];
+		else if (pt[c] > maxs[c])
+			d = pt[c] - maxs[c];
+
+		dist += d * d;
+	}
+
+	return dist;
+}
+
+
+// find the room the point is within, using the convex hull bounds
+int LRoomBVH::FindWithin(const LVector<LRoom> &rooms, const Vector3 &pt, float &within_dist) const
+{
+	int closest_within = -1;
+	within_dist = FLT_MAX;
+
+	int stack[MAX_DEPTH * 2];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size)
+	{
+		const LNode &node = m_Nodes[stack[--stack_size]];
+
+		if (!PointWithin(pt, node.m_ptMins, node.m_ptMaxs))
+			continue;
+
+		if (!node.IsLeaf())
+		{
+			stack[stack_size++] = node.m_iChild[0];
+			stack[stack_size++] = node.m_iChild[1];
+			continue;
+		}
+
+		for (int n=0; n<node.m_iNum; n++)
+		{
+			int room_id = m_RoomIDs[node.m_iFirst + n];
+			const LRoom &lroom = rooms[room_id];
+
+			if (!lroom.m_Bound.IsActive())
+				continue;
+
+			if (!lroom.m_AABB.has_point(pt))
+				continue;
+
+			float dist = lroom.m_Bound.GetSmallestPenetrationDistance(pt);
+
+			// ties go to the lowest room ID, to match the linear scan
+			if ((dist < within_dist) || ((dist == within_dist) && (room_id < closest_within)))
+			{
+				closest_within = room_id;
+				within_dist = dist;
+			}
+		}
+	}
+
+	return closest_within;
+}
+
+
+// branch and bound search for the closest room centre
+int LRoomBVH::FindClosestCentre(const LVector<LRoom> &rooms, const Vector3 &pt) const
+{
+	int closest = -1;
+	float closest_dist = FLT_MAX;
+
+	int stack[MAX_DEPTH * 2];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size)
+	{
+		const LNode &node = m_Nodes[stack[--stack_size]];
+
+		// can't contain anything closer
+		if (DistanceSquaredToBox(pt, node.m_ptCentreMins, node.m_ptCentreMaxs) > closest_dist)
+			continue;
+
+		if (!node.IsLeaf())
+		{
+			// visit the nearer child first (it is pushed last)
+			const LNode &a = m_Nodes[node.m_iChild[0]];
+			const LNode &b = m_Nodes[node.m_iChild[1]];
+			float da = DistanceSquaredToBox(pt, a.m_ptCentreMins, a.m_ptCentreMaxs);
+			float db = DistanceSquaredToBox(pt, b.m_ptCentreMins, b.m_ptCentreMaxs);
+
+			if (da < db)
+			{
+				stack[stack_size++] = node.m_iChild[1];
+				stack[stack_size++] = node.m_iChild[0];
+			}
+			else
+			{
+				stack[stack_size++] = node.m_iChild[0];
+				stack[stack_size++] = node.m_iChild[1];
+			}
+			continue;
+		}
+
+		for (int n=0; n<node.m_iNum; n++)
+		{
+			int room_id = m_RoomIDs[node.m_iFirst + n];
+			float d = pt.distance_squared_to(rooms[room_id].m_ptCentre);
+
+			if ((d < closest_dist) || ((d == closest_dist) && (room_id < closest)))
+			{
+				closest = room_id;
+				closest_dist = d;
+			}
+		}
+	}
+
+	return closest;
+}
+
+
+int LRoomBVH::FindClosestRoom(const LVector<LRoom> &rooms, const Vector3 &pt) const
+{
+	if (!IsActive())
+		return -1;
+
+	// same logic as the linear scan, prefer the hulls if within
+	float within_dist;
+	int closest_within = FindWithin(rooms, pt, within_dist);
+
+	if (within_dist < 1.0f)
+		return closest_within;
+
+	return FindClosestCentre(rooms, pt);
+}
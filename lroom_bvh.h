@@ -0,0 +1,79 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+
+class LRoom;
+
+// static bounding volume hierarchy over the rooms, built once at conversion.
+// Used to find which room a point is in (dob registration, teleports etc) without
+// scanning every room. Gives identical results to the linear scan.
+class LRoomBVH
+{
+public:
+	enum {MAX_ROOMS_PER_LEAF = 4, MAX_DEPTH = 64,};
+
+	void Create(const LVector<LRoom> &rooms);
+	void Clear();
+	bool IsActive() const {return m_Nodes.size() != 0;}
+
+	// returns the room the point is within (using the room bounds if present),
+	// or else the room with the closest centre, or -1 if there are no rooms
+	int FindClosestRoom(const LVector<LRoom> &rooms, const Vector3 &pt) const;
+
+private:
+	class LNode
+	{
+	public:
+		// enclosing the room AABBs, for point within queries
+		Vector3 m_ptMins;
+		Vector3 m_ptMaxs;
+
+		// enclosing the room centres, for closest centre queries
+		Vector3 m_ptCentreMins;
+		Vector3 m_ptCentreMaxs;
+
+		// leaf if m_iChild[0] is -1, the rooms are m_RoomIDs[m_iFirst] to m_RoomIDs[m_iFirst + m_iNum - 1]
+		int m_iFirst;
+		int m_iNum;
+
+		int m_iChild[2];
+
+		bool IsLeaf() const {return m_iChild[0] == -1;}
+	};
+
+	int Build_Recursive(const LVector<LRoom> &rooms, int first, int num, int depth);
+	void Build_CalculateBound(const LVector<LRoom> &rooms, LNode &node) const;
+
+	int FindWithin(const LVector<LRoom> &rooms, const Vector3 &pt, float &within_dist) const;
+	int FindClosestCentre(const LVector<LRoom> &rooms, const Vector3 &pt) const;
+
+	static bool PointWithin(const Vector3 &pt, const Vector3 &mins, const Vector3 &maxs);
+	static float DistanceSquaredToBox(const Vector3 &pt, const Vector3 &mins, const Vector3 &maxs);
+
+	LVector<LNode> m_Nodes;
+	LVector<int> m_RoomIDs;
+};
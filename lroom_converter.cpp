@@ -26,6 +26,9 @@
 #include "core/math/quick_hull.h"
 #include "ldebug.h"
 #include "scene/3d/light.h"
+#include "core/os/os.h"
+#include "lworker_pool.h"
+#include "lspatial_hash.h"
 
 // save typing, I am lazy
 #define LMAN m_pManager
@@ -33,11 +36,71 @@
 
 
 
+LRoomConverter::LRoomConverter()
+{
+	m_pManager = 0;
+	m_pRoomList = 0;
+	m_Async.m_eStage = AS_DONE;
+	m_Async.m_iItem = 0;
+	m_Async.m_bFailed = false;
+	m_Async.m_pJobThread = 0;
+	m_Async.m_bJobsDone = true;
+	m_bRoomNamesDirty = true;
+	m_bAreaNamesDirty = true;
+}
+
+LRoomConverter::~LRoomConverter()
+{
+	Async_Cancel();
+}
+
 void LRoomConverter::Convert(LRoomManager &manager, bool bVerbose, bool bPreparationRun, bool bDeleteLights, bool bSingleRoomMode)
+{
+	Convert_Prepare(manager, bVerbose, bPreparationRun, bDeleteLights, bSingleRoomMode);
+
+	int count = CountRooms();
+
+	//int num_global_lights = LMAN->m_Lights.size();
+
+	LMAN->m_Rooms.resize(count);
+
+	m_TempRooms.clear(true);
+	m_TempRooms.resize(count);
+
+
+	Convert_Rooms();
+	Convert_Portals();
+	Convert_Reorder();
+	Convert_Bounds();
+	Convert_RoomBVH();
+
+	// make sure manager bitfields are the correct size for number of rooms and objects
+	LPRINT(5,"Total SOBs " + itos(LMAN->m_SOBs.size()));
+	LMAN->CreateBitfields();
+	LMAN->ObjectCache_WatchAll();
+
+	// must be done after the bitfields
+	Convert_Lights();
+	Convert_ShadowCasters();
+	Convert_AreaLights();
+
+	// hide all in preparation for first frame
+	//LMAN->ShowAll(false);
+
+	// temp rooms no longer needed
+	m_TempRooms.clear(true);
+
+	// clear out the local room lights, leave only global lights
+	//LMAN->m_Lights.resize(num_global_lights);
+	Lawn::LDebug::m_bRunning = true;
+}
+
+void LRoomConverter::Convert_Prepare(LRoomManager &manager, bool bVerbose, bool bPreparationRun, bool bDeleteLights, bool bSingleRoomMode)
 {
 	m_bFinalRun = (bPreparationRun == false);
 	m_bDeleteLights = bDeleteLights;
 	m_bSingleRoomMode = bSingleRoomMode;
+	m_bIncremental = false;
 
 	// This just is simply used to set how much debugging output .. more during conversion, less during running
 	// except when requested by explicitly clearing this flag.
@@ -59,55 +122,412 @@ void LRoomConverter::Convert(LRoomManager &manager, bool bVerbose, bool bPrepara
 
 	// force clear all arrays
 	manager.ReleaseResources(true);
+	m_bRoomNamesDirty = true;
+	m_bAreaNamesDirty = true;
+}
 
-	int count = CountRooms();
 
-	//int num_global_lights = LMAN->m_Lights.size();
 
-	// make sure bitfield is right size for number of rooms
-	LMAN->m_BF_visible_rooms.Create(count);
-	LMAN->m_LightRender.m_BF_Temp_Visible_Rooms.Create(count);
+///////////////////////////////////////////////////
+// time sliced conversion
+// The same steps as Convert, but split into items that can be spread over frames. Anything touching the scene tree
+// is done an item at a time on the main thread, and the bound hulls and light traces run on the worker pool
+// on a background thread while the main thread carries on with the frame.
+
+void LRoomConverter::Async_Begin(LRoomManager &manager, bool bVerbose, bool bDeleteLights)
+{
+	Convert_Prepare(manager, bVerbose, false, bDeleteLights, false);
+
+	// the rooms are listed first (creating the areas in the same order as Convert_Rooms)
+	// so they can be converted an item at a time
+	m_Async.m_RoomNodes.clear();
+	m_Async.m_RoomAreas.clear();
+	Async_GatherRooms_Recursive(LROOMLIST, -1);
 
+	int count = m_Async.m_RoomNodes.size();
 	LMAN->m_Rooms.resize(count);
 
 	m_TempRooms.clear(true);
 	m_TempRooms.resize(count);
 
+	m_Async.m_eStage = AS_ROOMS;
+	m_Async.m_iItem = 0;
+	m_Async.m_bFailed = false;
+}
 
-	Convert_Rooms();
-	Convert_Portals();
-	Convert_Bounds();
+void LRoomConverter::Async_GatherRooms_Recursive(Node * pParent, int area)
+{
+	for (int n=0; n<pParent->get_child_count(); n++)
+	{
+		Node * pChild = pParent->get_child(n);
 
-	// make sure manager bitfields are the correct size for number of objects
-	int num_sobs = LMAN->m_SOBs.size();
-	LPRINT(5,"Total SOBs " + itos(num_sobs));
-	LMAN->m_BF_caster_SOBs.Create(num_sobs);
-	LMAN->m_BF_visible_SOBs.Create(num_sobs);
-	LMAN->m_BF_master_SOBs.Create(num_sobs);
-	LMAN->m_BF_master_SOBs_prev.Create(num_sobs);
+		if (Node_IsRoom(pChild))
+		{
+			m_Async.m_RoomNodes.push_back(pChild->get_instance_id());
+			m_Async.m_RoomAreas.push_back(area);
+		}
+		else if (Node_IsArea(pChild))
+		{
+			String szArea = LPortal::FindNameAfter(pChild, "area_");
+			Async_GatherRooms_Recursive(pChild, Area_FindOrCreate(szArea));
+		}
+	}
+}
 
-	LMAN->m_LightRender.m_BF_Temp_SOBs.Create(num_sobs);
+bool LRoomConverter::Async_Step(int budget_usecs)
+{
+	uint64_t end = OS::get_singleton()->get_ticks_usec() + budget_usecs;
 
-	LMAN->m_BF_ActiveLights.Create(LMAN->m_Lights.size());
-	LMAN->m_BF_ActiveLights_prev.Create(LMAN->m_Lights.size());
-	LMAN->m_BF_ProcessedLights.Create(LMAN->m_Lights.size());
+	// always do at least one item, so conversion progresses however small the budget
+	while (m_Async.m_eStage != AS_DONE)
+	{
+		// waiting for the worker threads, try again next frame
+		if (!Async_DoItem())
+			break;
 
-	// must be done after the bitfields
-	Convert_Lights();
-	Convert_ShadowCasters();
-	Convert_AreaLights();
+		if (OS::get_singleton()->get_ticks_usec() >= end)
+			break;
+	}
 
-	// hide all in preparation for first frame
-	//LMAN->ShowAll(false);
+	return m_Async.m_eStage == AS_DONE;
+}
 
-	// temp rooms no longer needed
-	m_TempRooms.clear(true);
+void LRoomConverter::Async_NextStage(eAsyncStage stage)
+{
+	m_Async.m_eStage = stage;
+	m_Async.m_iItem = 0;
+}
 
-	// clear out the local room lights, leave only global lights
-	//LMAN->m_Lights.resize(num_global_lights);
+void LRoomConverter::Async_Fail(const String &szReason)
+{
+	LWARN(5, "rooms_convert_async : " + szReason + ", aborting");
+	m_Async.m_bFailed = true;
 	Lawn::LDebug::m_bRunning = true;
+	Async_NextStage(AS_DONE);
+}
+
+// the scene tree can change between steps, so the room nodes must be checked before each use on the main thread
+bool LRoomConverter::Async_CheckRoom(LRoom &lroom)
+{
+	// the rooms are not watched for leaving the tree until the bounds are finished
+	lroom.Cache_Invalidate();
+
+	if (lroom.GetGodotRoom())
+		return true;
+
+	Async_Fail("room '" + lroom.get_name() + "' freed during conversion");
+	return false;
+}
+
+// returns false if waiting on worker threads
+bool LRoomConverter::Async_DoItem()
+{
+	int item = m_Async.m_iItem++;
+	int num_rooms = LMAN->m_Rooms.size();
+
+	switch (m_Async.m_eStage)
+	{
+	case AS_ROOMS:
+		{
+			if (item >= num_rooms)
+			{
+				Async_NextStage(AS_PORTALS);
+				break;
+			}
+
+			Spatial * pSpat = Object::cast_to<Spatial>(ObjectDB::get_instance(m_Async.m_RoomNodes[item]));
+			if (!pSpat)
+			{
+				Async_Fail("room freed during conversion");
+				break;
+			}
+
+			Convert_Room(pSpat, item, m_Async.m_RoomAreas[item]);
+		}
+		break;
+	case AS_PORTALS:
+		{
+			if (item < num_rooms)
+			{
+				if (Async_CheckRoom(LMAN->m_Rooms[item]))
+					LRoom_DetectPortalMeshes(LMAN->m_Rooms[item], m_TempRooms[item]);
+				break;
+			}
+
+			// the remaining passes don't touch the scene tree, and are quick
+			for (int n=0; n<num_rooms; n++)
+				LRoom_MakePortalsTwoWay(LMAN->m_Rooms[n], m_TempRooms[n], n);
+
+			for (int n=0; n<num_rooms; n++)
+				LRoom_MakePortalFinalList(LMAN->m_Rooms[n], m_TempRooms[n]);
+
+			Convert_Reorder();
+			m_BoundJobs.resize(num_rooms);
+			Async_NextStage(AS_BOUNDS_GATHER);
+		}
+		break;
+	case AS_BOUNDS_GATHER:
+		{
+			if (item < num_rooms)
+			{
+				if (Async_CheckRoom(LMAN->m_Rooms[item]))
+					Bound_Gather(LMAN->m_Rooms[item], m_BoundJobs[item]);
+				break;
+			}
+
+			Async_StartJobs(Bound_Job, num_rooms, Worker_GetNumWorkers());
+			Async_NextStage(AS_BOUNDS_HULLS);
+		}
+		break;
+	case AS_BOUNDS_HULLS:
+		{
+			if (!Async_JobsFinished())
+			{
+				m_Async.m_iItem--;
+				return false;
+			}
+
+			Async_NextStage(AS_BOUNDS_FINISH);
+		}
+		break;
+	case AS_BOUNDS_FINISH:
+		{
+			if (item < num_rooms)
+			{
+				if (Async_CheckRoom(LMAN->m_Rooms[item]))
+					Bound_Finish(LMAN->m_Rooms[item], m_BoundJobs[item]);
+				break;
+			}
+
+			m_BoundJobs.clear(true);
+			Convert_RoomBVH();
+
+			LPRINT(5,"Total SOBs " + itos(LMAN->m_SOBs.size()));
+			LMAN->CreateBitfields();
+			LMAN->ObjectCache_WatchAll();
+
+			Convert_Lights_Gather();
+			int num_workers = Light_TraceJobs_Begin();
+			Async_StartJobs(Light_Job, m_LightJobs.size(), num_workers);
+			Async_NextStage(AS_LIGHTS);
+		}
+		break;
+	case AS_LIGHTS:
+		{
+			if (!Async_JobsFinished())
+			{
+				m_Async.m_iItem--;
+				return false;
+			}
+
+			Light_TraceJobs_End();
+			Async_NextStage(AS_SHADOW_CASTERS);
+		}
+		break;
+	case AS_SHADOW_CASTERS:
+		{
+			if (item < LMAN->m_Lights.size())
+			{
+				Convert_ShadowCasters_Light(item);
+				break;
+			}
+
+			Convert_AreaLights();
+
+			m_TempRooms.clear(true);
+			Lawn::LDebug::m_bRunning = true;
+			Async_NextStage(AS_DONE);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+// rough, by stage, and by item within the stages done on the main thread
+float LRoomConverter::Async_GetProgress() const
+{
+	// fraction of the total time taken by each stage, roughly
+	const float stage_weights[AS_DONE] = {0.2f, 0.1f, 0.15f, 0.15f, 0.05f, 0.25f, 0.1f};
+
+	if (m_Async.m_eStage == AS_DONE)
+		return 1.0f;
+
+	float progress = 0.0f;
+	for (int n=0; n<m_Async.m_eStage; n++)
+		progress += stage_weights[n];
+
+	int num_items = 0;
+	switch (m_Async.m_eStage)
+	{
+	case AS_ROOMS:
+	case AS_PORTALS:
+	case AS_BOUNDS_GATHER:
+	case AS_BOUNDS_FINISH:
+		num_items = LMAN->m_Rooms.size();
+		break;
+	case AS_SHADOW_CASTERS:
+		num_items = LMAN->m_Lights.size();
+		break;
+	default:
+		break;
+	}
+
+	if (num_items)
+		progress += stage_weights[m_Async.m_eStage] * MIN((float) m_Async.m_iItem / num_items, 1.0f);
+
+	return progress;
+}
+
+String LRoomConverter::Async_GetStageName() const
+{
+	switch (m_Async.m_eStage)
+	{
+	case AS_ROOMS: return "rooms";
+	case AS_PORTALS: return "portals";
+	case AS_BOUNDS_GATHER:
+	case AS_BOUNDS_HULLS:
+	case AS_BOUNDS_FINISH: return "bounds";
+	case AS_LIGHTS: return "lights";
+	case AS_SHADOW_CASTERS: return "shadow casters";
+	default:
+		break;
+	}
+
+	return "done";
+}
+
+void LRoomConverter::Async_Cancel()
+{
+	// the jobs may be using the converter and manager data
+	if (m_Async.m_pJobThread)
+	{
+		Thread::wait_to_finish(m_Async.m_pJobThread);
+		memdelete(m_Async.m_pJobThread);
+		m_Async.m_pJobThread = 0;
+	}
+
+	for (int n=0; n<m_LightWorkers.size(); n++)
+		memdelete(m_LightWorkers[n]);
+	m_LightWorkers.clear(true);
+
+	if (m_Async.m_eStage != AS_DONE)
+	{
+		m_Async.m_bFailed = true;
+		Lawn::LDebug::m_bRunning = true;
+		Async_NextStage(AS_DONE);
+	}
+}
+
+// runs the worker pool from a background thread, so the main thread isn't held up
+void LRoomConverter::Async_StartJobs(LWorkerPool::WorkFunc pFunc, int num_items, int num_workers)
+{
+	m_Async.m_pJobFunc = pFunc;
+	m_Async.m_iJobItems = num_items;
+	m_Async.m_iJobWorkers = num_workers;
+	m_Async.m_bJobsDone = false;
+	m_Async.m_pJobThread = Thread::create(Async_JobThread, this);
+}
+
+void LRoomConverter::Async_JobThread(void * pUserData)
+{
+	LRoomConverter * pConverter = (LRoomConverter *) pUserData;
+	LAsync &async = pConverter->m_Async;
+
+	LWorkerPool pool;
+	pool.Run(async.m_pJobFunc, pConverter, async.m_iJobItems, async.m_iJobWorkers);
+
+	async.m_bJobsDone = true;
+}
+
+bool LRoomConverter::Async_JobsFinished()
+{
+	if (!m_Async.m_bJobsDone)
+		return false;
+
+	// joining makes the results visible to this thread
+	Thread::wait_to_finish(m_Async.m_pJobThread);
+	memdelete(m_Async.m_pJobThread);
+	m_Async.m_pJobThread = 0;
+	return true;
+}
+
+// must be done after the bounds, as these alter the room AABBs
+void LRoomConverter::Convert_RoomBVH()
+{
+	LPRINT(5,"Convert_RoomBVH");
+
+	LMAN->m_RoomBVH.Create(LMAN->m_Rooms);
+
+	// only bother in verbose mode
+	if (!Lawn::LDebug::m_bRunning)
+		Convert_RoomBVH_Benchmark();
 }
 
+// compare the BVH against the linear scan, for speed and correctness
+void LRoomConverter::Convert_RoomBVH_Benchmark()
+{
+	const LVector<LRoom> &rooms = LMAN->m_Rooms;
+	if (!rooms.size())
+		return;
+
+	// sample a grid over the whole level, plus a margin to test points outside all rooms
+	AABB bb = rooms[0].m_AABB;
+	for (int n=1; n<rooms.size(); n++)
+		bb.merge_with(rooms[n].m_AABB);
+	bb.grow_by(2.0f);
+
+	const int grid_size = 16;
+	Vector<Vector3> pts;
+	for (int z=0; z<grid_size; z++)
+	{
+		for (int y=0; y<grid_size; y++)
+		{
+			for (int x=0; x<grid_size; x++)
+			{
+				Vector3 pt = Vector3(x + 0.5f, y + 0.5f, z + 0.5f) / grid_size;
+				pts.push_back(bb.position + (bb.size * pt));
+			}
+		}
+	}
+
+	// the room centres are the common case for dobs
+	for (int n=0; n<rooms.size(); n++)
+		pts.push_back(rooms[n].m_ptCentre);
+
+	int nPoints = pts.size();
+	Vector<int> res_linear;
+	Vector<int> res_bvh;
+	res_linear.resize(nPoints);
+	res_bvh.resize(nPoints);
+
+	uint64_t before = OS::get_singleton()->get_ticks_usec();
+	for (int n=0; n<nPoints; n++)
+		res_linear.set(n, LMAN->FindClosestRoom_Linear(pts[n]));
+
+	uint64_t mid = OS::get_singleton()->get_ticks_usec();
+	for (int n=0; n<nPoints; n++)
+		res_bvh.set(n, LMAN->m_RoomBVH.FindClosestRoom(rooms, pts[n]));
+
+	uint64_t after = OS::get_singleton()->get_ticks_usec();
+
+	int mismatches = 0;
+	for (int n=0; n<nPoints; n++)
+	{
+		if (res_linear[n] != res_bvh[n])
+			mismatches++;
+	}
+
+	LPRINT(5, "FindClosestRoom benchmark, " + itos(nPoints) + " queries, " + itos(rooms.size()) + " rooms");
+	LPRINT(5, "\tlinear " + itos(mid - before) + " usec, BVH " + itos(after - mid) + " usec");
+
+	if (mismatches)
+	{
+		LWARN(5, "FindClosestRoom BVH mismatches linear scan : " + itos(mismatches));
+	}
+}
 
 
 int LRoomConverter::Convert_Rooms_Recursive(Node * pParent, int count, int area)
@@ -164,29 +584,72 @@ void LRoomConverter::Convert_Rooms()
 	count = Convert_Rooms_Recursive(LROOMLIST, count, area);
 }
 
-int LRoomConverter::Area_FindOrCreate(String szName)
+// where names are repeated the first wins, as with a linear search
+void LRoomConverter::RoomNames_Build()
+{
+	m_RoomsByName.clear();
+
+	for (int n=0; n<LMAN->m_Rooms.size(); n++)
+	{
+		const LRoom &lroom = LMAN->m_Rooms[n];
+		if (!lroom.m_bRemoved && !m_RoomsByName.has(lroom.m_szName))
+			m_RoomsByName.set(lroom.m_szName, n);
+	}
+
+	m_bRoomNamesDirty = false;
+}
+
+void LRoomConverter::AreaNames_Build()
 {
+	m_AreasByName.clear();
+
 	for (int n=0; n<LMAN->m_Areas.size(); n++)
 	{
-		if (LMAN->m_Areas[n].m_szName == szName)
-			return n;
+		const String &szName = LMAN->m_Areas[n].m_szName;
+		if (!m_AreasByName.has(szName))
+			m_AreasByName.set(szName, n);
 	}
 
+	m_bAreaNamesDirty = false;
+}
+
+int LRoomConverter::Area_Find(String szName)
+{
+	if (m_bAreaNamesDirty)
+		AreaNames_Build();
+
+	const int * pID = m_AreasByName.getptr(szName);
+	if (pID)
+		return *pID;
+
+	return -1;
+}
+
+int LRoomConverter::Area_FindOrCreate(String szName)
+{
+	int id = Area_Find(szName);
+	if (id != -1)
+		return id;
+
 	// create
 	LArea area;
 	area.Create(szName);
 	LMAN->m_Areas.push_back(area);
-	return LMAN->m_Areas.size() - 1;
+
+	id = LMAN->m_Areas.size() - 1;
+	m_AreasByName.set(szName, id);
+	return id;
 }
 
 
-int LRoomConverter::FindRoom_ByName(String szName) const
+int LRoomConverter::FindRoom_ByName(String szName)
 {
-	for (int n=0; n<LMAN->m_Rooms.size(); n++)
-	{
-		if (LMAN->m_Rooms[n].m_szName == szName)
-			return n;
-	}
+	if (m_bRoomNamesDirty)
+		RoomNames_Build();
+
+	const int * pID = m_RoomsByName.getptr(szName);
+	if (pID)
+		return *pID;
 
 	return -1;
 }
@@ -221,7 +684,7 @@ void LRoomConverter::Convert_Room_FindObjects_Recursive(Node * pParent, LRoom &l
 		Spatial * pSpatialChild = Object::cast_to<Spatial>(pChild);
 		if (pSpatialChild && (Convert_IsVisibleInRooms(pSpatialChild) == false))
 		{
-			pSpatialChild->queue_delete();
+			Node_Delete(pSpatialChild, false);
 			continue;
 		}
 
@@ -264,11 +727,10 @@ void LRoomConverter::Convert_Room_FindObjects_Recursive(Node * pParent, LRoom &l
 			// store some info about the static object for use at runtime
 			LSob sob;
 			sob.m_ID = pVI->get_instance_id();
-			sob.m_aabb = bb;
 			sob.Hidable_Create(pChild);
 
 			//lroom.m_SOBs.push_back(sob);
-			LRoom_PushBackSOB(lroom, sob);
+			LRoom_PushBackSOB(lroom, sob, bb);
 
 			// take away layer 0 from the sob, so it can be culled effectively
 			if (m_bFinalRun)
@@ -328,6 +790,7 @@ bool LRoomConverter::Convert_Room(Spatial * pNode, int lroomID, int areaID)
 
 	// get a reference to the lroom we are writing to
 	LRoom &lroom = LMAN->m_Rooms[lroomID];
+	m_bRoomNamesDirty = true;
 
 	// store the godot room
 	lroom.m_GodotID = pNode->get_instance_id();
@@ -356,6 +819,9 @@ bool LRoomConverter::Convert_Room(Spatial * pNode, int lroomID, int areaID)
 	// recursively find statics
 	Convert_Room_FindObjects_Recursive(pNode, lroom, bb_room);
 
+	if (LMAN->m_bConvert_Reorder)
+		Convert_Room_SortSOBs(lroom, bb_room);
+
 	// store the lroom centre and bound
 	lroom.m_ptCentre = bb_room.FindCentre();
 
@@ -368,40 +834,229 @@ bool LRoomConverter::Convert_Room(Spatial * pNode, int lroomID, int areaID)
 	return true;
 }
 
-bool LRoomConverter::Bound_AddPlaneIfUnique(LVector<Plane> &planes, const Plane &p)
+// spreads the bottom 10 bits so there are 2 zero bits between each, for interleaving 3 axes
+uint32_t LRoomConverter::Morton_Spread(uint32_t v) const
 {
-	for (int n=0; n<planes.size(); n++)
-	{
-		const Plane &o = planes[n];
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
 
-		// this is a fudge factor for how close planes can be to be considered the same ...
-		// to prevent ridiculous amounts of planes
-		const float d = 0.08f;
+// sort the SOBs in the room by the Morton order of their centres, so objects close in space
+// are close in memory. Nothing refers to the SOB IDs yet at this stage of conversion.
+void LRoomConverter::Convert_Room_SortSOBs(LRoom &lroom, const LAABB &bb_room)
+{
+	int nSOBs = lroom.m_iNumSOBs;
+	if (nSOBs < 2)
+		return;
 
-		if (fabs(p.d - o.d) > d) continue;
+	int first = lroom.m_iFirstSOB;
+	Vector3 ptSize = bb_room.m_ptMaxs - bb_room.m_ptMins;
 
-		float dot = p.normal.dot(o.normal);
-		if (dot < 0.98f) continue;
+	LVector<LSortItem> keys;
+	keys.resize(nSOBs);
 
-		// match!
-		return false;
-	}
+	for (int n=0; n<nSOBs; n++)
+	{
+		const AABB &bb = LMAN->m_SOB_AABBs[first + n];
+		Vector3 pt = bb.position + (bb.size * 0.5f);
 
-	// test
-//	Vector3 va(1, 0, 0);
-//	Vector3 vb(1, 0.2, 0);
-//	vb.normalize();
-//	float dot = va.dot(vb);
-//	print("va dot vb is " + String(Variant(dot)));
+		uint32_t key = 0;
+		for (int c=0; c<3; c++)
+		{
+			float f = 0.0f;
+			if (ptSize[c] > 0.0f)
+				f = (pt[c] - bb_room.m_ptMins[c]) / ptSize[c];
 
-	// is unique
-//	print("\t\t\t\tAdding bound plane : " + p);
+			int i = CLAMP((int) (f * 1023.0f), 0, 1023);
+			key |= Morton_Spread(i) << c;
+		}
 
-	planes.push_back(p);
-	return true;
-}
+		keys[n].m_uiKey = key;
+		keys[n].m_iID = first + n;
+	}
 
-bool LRoomConverter::Convert_Bound_FromPoints(LRoom &lroom, const Vector<Vector3> &points)
+	keys.sort();
+
+	LVector<LSob> sobs;
+	LVector<AABB> aabbs;
+	for (int n=0; n<nSOBs; n++)
+	{
+		sobs.push_back(LMAN->m_SOBs[keys[n].m_iID]);
+		aabbs.push_back(LMAN->m_SOB_AABBs[keys[n].m_iID]);
+	}
+
+	for (int n=0; n<nSOBs; n++)
+	{
+		LMAN->m_SOBs[first + n] = sobs[n];
+		LMAN->m_SOB_AABBs.set(first + n, aabbs[n]);
+	}
+}
+
+// Renumber the rooms in reverse Cuthill-McKee order of the portal graph, so rooms linked by portals
+// are close together in memory, along with their portals and SOBs. This is done straight after the
+// portals, so the bounds, BVH, lights, shadow casters and areas are all created in the new order.
+// The API keeps using the scene tree order via the manager remap tables.
+void LRoomConverter::Convert_Reorder()
+{
+	if (!LMAN->m_bConvert_Reorder)
+		return;
+
+	int nRooms = LMAN->m_Rooms.size();
+	if (nRooms < 2)
+		return;
+
+	// the rooms by ascending number of portals, to start each part of the graph from the edge
+	LVector<LSortItem> by_degree;
+	by_degree.resize(nRooms);
+	for (int n=0; n<nRooms; n++)
+	{
+		by_degree[n].m_uiKey = LMAN->m_Rooms[n].m_iNumPortals;
+		by_degree[n].m_iID = n;
+	}
+	by_degree.sort();
+
+	// old room ID to new, -1 until visited
+	LVector<int> remap;
+	remap.resize(nRooms);
+	for (int n=0; n<nRooms; n++)
+		remap[n] = -1;
+
+	// new room ID to old, in Cuthill-McKee order to begin with
+	LVector<int> order;
+	LVector<LSortItem> neighbours;
+
+	int next_start = 0;
+	while (order.size() < nRooms)
+	{
+		// breadth first from the unvisited room with fewest portals
+		while (remap[by_degree[next_start].m_iID] != -1)
+			next_start++;
+
+		int start = by_degree[next_start].m_iID;
+		remap[start] = order.size();
+		order.push_back(start);
+
+		for (int head = order.size() - 1; head < order.size(); head++)
+		{
+			const LRoom &lroom = LMAN->m_Rooms[order[head]];
+
+			// visit the neighbours with fewest portals first
+			neighbours.clear();
+			for (int p=0; p<lroom.m_iNumPortals; p++)
+			{
+				int linked = LMAN->m_Portals[lroom.m_iFirstPortal + p].m_iRoomNum;
+				if ((linked < 0) || (remap[linked] != -1))
+					continue;
+
+				LSortItem item;
+				item.m_uiKey = LMAN->m_Rooms[linked].m_iNumPortals;
+				item.m_iID = linked;
+				neighbours.push_back(item);
+			}
+			neighbours.sort();
+
+			for (int n=0; n<neighbours.size(); n++)
+			{
+				int linked = neighbours[n].m_iID;
+				if (remap[linked] != -1)
+					continue;
+
+				remap[linked] = order.size();
+				order.push_back(linked);
+			}
+		}
+	}
+
+	// reverse
+	LVector<int> to_old;
+	to_old.resize(nRooms);
+	for (int n=0; n<nRooms; n++)
+	{
+		to_old[n] = order[nRooms - 1 - n];
+		remap[to_old[n]] = n;
+	}
+
+	LPRINT(5, "Convert_Reorder " + itos(nRooms) + " rooms");
+
+	// rooms, with their portals and SOBs following in the same order
+	LVector<LRoom> rooms;
+	LVector<LPortal> portals;
+	LVector<LSob> sobs;
+	LVector<AABB> aabbs;
+	LVector<LTempRoom> temp_rooms;
+
+	for (int n=0; n<nRooms; n++)
+	{
+		int old_id = to_old[n];
+		rooms.push_back(LMAN->m_Rooms[old_id]);
+		temp_rooms.push_back(m_TempRooms[old_id]);
+
+		LRoom &lroom = rooms[n];
+		lroom.m_RoomID = n;
+
+		if (lroom.m_iNumPortals)
+		{
+			int first = portals.size();
+			for (int p=0; p<lroom.m_iNumPortals; p++)
+			{
+				LPortal port = LMAN->m_Portals[lroom.m_iFirstPortal + p];
+				if (port.m_iRoomNum >= 0)
+					port.m_iRoomNum = remap[port.m_iRoomNum];
+				portals.push_back(port);
+			}
+			lroom.m_iFirstPortal = first;
+		}
+
+		if (lroom.m_iNumSOBs)
+		{
+			int first = sobs.size();
+			for (int s=0; s<lroom.m_iNumSOBs; s++)
+			{
+				sobs.push_back(LMAN->m_SOBs[lroom.m_iFirstSOB + s]);
+				aabbs.push_back(LMAN->m_SOB_AABBs[lroom.m_iFirstSOB + s]);
+			}
+			lroom.m_iFirstSOB = first;
+		}
+	}
+
+	LMAN->m_Rooms.copy_from(rooms);
+	LMAN->m_Portals.copy_from(portals);
+	LMAN->m_SOBs.copy_from(sobs);
+	LMAN->m_SOB_AABBs.copy_from(aabbs);
+	m_TempRooms.copy_from(temp_rooms);
+
+	// lights created in the rooms
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		LSource &source = LMAN->m_Lights[n].m_Source;
+		if ((unsigned int) source.m_RoomID < (unsigned int) nRooms)
+			source.m_RoomID = remap[source.m_RoomID];
+	}
+
+	m_bRoomNamesDirty = true;
+
+	// the public room IDs are the original order
+	LMAN->RoomID_SetRemap(to_old);
+}
+
+bool LRoomConverter::Bound_AddPlaneIfUnique(LBakedVector<Plane> &planes, LPlaneHash &plane_hash, const Plane &p)
+{
+	// the hash only finds candidate planes in neighbouring cells, the match test is unchanged
+	if (!plane_hash.AddIfUnique(p))
+		return false;
+
+	// is unique
+//	print("\t\t\t\tAdding bound plane : " + p);
+
+	planes.push_back(p);
+	return true;
+}
+
+bool LRoomConverter::Convert_Bound_FromPoints(LRoom &lroom, const Vector<Vector3> &points)
 {
 	if (points.size() > 3)
 	{
@@ -410,17 +1065,23 @@ bool LRoomConverter::Convert_Bound_FromPoints(LRoom &lroom, const Vector<Vector3
 		if (err == OK)
 		{
 			// get the planes
+			// this is a fudge factor for how close planes can be to be considered the same ...
+			// to prevent ridiculous amounts of planes
+			LPlaneHash plane_hash(0.08f, 0.98f);
+
+			// any planes already in the bound
+			for (int n=0; n<lroom.m_Bound.m_Planes.size(); n++)
+				plane_hash.AddIfUnique(lroom.m_Bound.m_Planes[n]);
+
 			for (int n=0; n<md.faces.size(); n++)
 			{
 				const Plane &p = md.faces[n].plane;
-				Bound_AddPlaneIfUnique(lroom.m_Bound.m_Planes, p);
+				Bound_AddPlaneIfUnique(lroom.m_Bound.m_Planes, plane_hash, p);
 			}
 
-			LPRINT(2, "\t\t\tcontained " + itos(lroom.m_Bound.m_Planes.size()) + " planes.");
-
 			// make a copy of the mesh data for debugging
 			// note this could be avoided in release builds? NYI
-			lroom.m_Bound_MeshData = md;
+			lroom.m_BoundHull.Create(md);
 
 //			for (int f=0; f<md.faces.size(); f++)
 //			{
@@ -466,21 +1127,6 @@ void LRoomConverter::GetWorldVertsFromMesh(const MeshInstance &mi, Vector<Vector
 	}
 }
 
-bool LRoomConverter::Convert_ManualBound(LRoom &lroom, MeshInstance * pMI)
-{
-	LPRINT(2, "\tCONVERT_MANUAL_BOUND : '" + pMI->get_name() + "' for room '" + lroom.get_name() + "'");
-
-	Vector<Vector3> points;
-	GetWorldVertsFromMesh(*pMI, points);
-	for (int n=0; n<points.size(); n++)
-	{
-		// expand the room AABB to make sure it encompasses the bound
-		lroom.m_AABB.expand_to(points[n]);
-	}
-
-	return Convert_Bound_FromPoints(lroom, points);
-}
-
 // hide all in preparation for first frame
 //void LRoomConverter::Convert_HideAll()
 //{
@@ -502,30 +1148,53 @@ bool LRoomConverter::Convert_ManualBound(LRoom &lroom, MeshInstance * pMI)
 
 void LRoomConverter::Convert_AreaLights()
 {
-	// list the rooms in each area
-	for (int a=0; a<LMAN->m_Areas.size(); a++)
+	int nAreas = LMAN->m_Areas.size();
+	int nRooms = LMAN->m_Rooms.size();
+	int nLights = LMAN->m_Lights.size();
+
+	// list the rooms in each area.
+	// The lists are built in one pass over the rooms rather than one pass per area,
+	// counting first so that each area's rooms are contiguous, in room order.
+	LVector<int> counts;
+	counts.resize(nAreas);
+	for (int a=0; a<nAreas; a++)
+		counts[a] = 0;
+
+	for (int r=0; r<nRooms; r++)
 	{
-		LArea &area = LMAN->m_Areas[a];
+		const LRoom &room = LMAN->m_Rooms[r];
+		for (int i=0; i<room.m_Areas.size(); i++)
+			counts[room.m_Areas[i]]++;
+	}
 
-		// add every room in this area to the light affected rooms list
-		for (int r=0; r<LMAN->m_Rooms.size(); r++)
+	int first = LMAN->m_AreaRooms.size();
+	for (int a=0; a<nAreas; a++)
+	{
+		LArea &area = LMAN->m_Areas[a];
+		if (counts[a])
 		{
-			LRoom &room = LMAN->m_Rooms[r];
-			if (room.IsInArea(a))
-			{
-				// add the room to the area room list
-				if (area.m_iNumRooms == 0)
-					area.m_iFirstRoom = LMAN->m_AreaRooms.size();
+			area.m_iFirstRoom = first;
+			first += counts[a];
+		}
 
-				area.m_iNumRooms += 1;
-				LMAN->m_AreaRooms.push_back(r);
-			}
+		// filled in below
+		area.m_iNumRooms = 0;
+	}
+	LMAN->m_AreaRooms.resize(first);
+
+	for (int r=0; r<nRooms; r++)
+	{
+		const LRoom &room = LMAN->m_Rooms[r];
+		for (int i=0; i<room.m_Areas.size(); i++)
+		{
+			LArea &area = LMAN->m_Areas[room.m_Areas[i]];
+			LMAN->m_AreaRooms.set(area.m_iFirstRoom + area.m_iNumRooms++, r);
 		}
 	}
 
 
 	// first identify which lights are area lights, and match area strings to area IDs
-	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	for (int n=0; n<nLights; n++)
 	{
 		LLight &l = LMAN->m_Lights[n];
 
@@ -536,15 +1205,7 @@ void LRoomConverter::Convert_AreaLights()
 		assert (l.m_iArea == -1);
 
 		// match area string to area
-		// find the area
-		for (int n=0; n<LMAN->m_Areas.size(); n++)
-		{
-			if (LMAN->m_Areas[n].m_szName == l.m_szArea)
-			{
-				l.m_iArea = n;
-				break;
-			}
-		}
+		l.m_iArea = Area_Find(l.m_szArea);
 
 		// area not found?
 		if (l.m_iArea == -1)
@@ -558,32 +1219,44 @@ void LRoomConverter::Convert_AreaLights()
 	}
 
 
-	// add each light within an area to the area light list
-	for (int a=0; a<LMAN->m_Areas.size(); a++)
+	// add each light within an area to the area light list, in the same way as the rooms
+	for (int a=0; a<nAreas; a++)
+		counts[a] = 0;
+
+	for (int n=0; n<nLights; n++)
 	{
-		LArea &area = LMAN->m_Areas[a];
+		int areaID = LMAN->m_Lights[n].m_iArea;
+		if (areaID != -1)
+			counts[areaID]++;
+	}
 
-		for (int n=0; n<LMAN->m_Lights.size(); n++)
+	first = LMAN->m_AreaLights.size();
+	for (int a=0; a<nAreas; a++)
+	{
+		LArea &area = LMAN->m_Areas[a];
+		if (counts[a])
 		{
-			LLight &l = LMAN->m_Lights[n];
-
-			int areaID = l.m_iArea;
-			if (areaID != a)
-				continue;
-
-			// this light affects this area
-			if (area.m_iNumLights == 0)
-				area.m_iFirstLight = LMAN->m_AreaLights.size();
+			area.m_iFirstLight = first;
+			first += counts[a];
+		}
 
-			LMAN->m_AreaLights.push_back(n);
-			area.m_iNumLights++;
+		area.m_iNumLights = 0;
+	}
+	LMAN->m_AreaLights.resize(first);
 
+	for (int n=0; n<nLights; n++)
+	{
+		int areaID = LMAN->m_Lights[n].m_iArea;
+		if (areaID == -1)
+			continue;
 
-		} // for n
-	} // for a
+		// this light affects this area
+		LArea &area = LMAN->m_Areas[areaID];
+		LMAN->m_AreaLights.set(area.m_iFirstLight + area.m_iNumLights++, n);
+	}
 
 	// for each global light we can calculate the affected rooms
-	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	for (int n=0; n<nLights; n++)
 	{
 		LLight &l = LMAN->m_Lights[n];
 
@@ -596,66 +1269,143 @@ void LRoomConverter::Convert_AreaLights()
 		LPRINT(5,"Area light " + itos (n) + " affected rooms:");
 
 		// add every room in this area to the light affected rooms list
-		for (int r=0; r<LMAN->m_Rooms.size(); r++)
+		const LArea &area = LMAN->m_Areas[areaID];
+		for (int i=0; i<area.m_iNumRooms; i++)
 		{
+			int r = LMAN->m_AreaRooms[area.m_iFirstRoom + i];
 			LRoom &room = LMAN->m_Rooms[r];
-			if (room.IsInArea(areaID))
-			{
-				//l.AddAffectedRoom(r); // no need as this is now done by area
-				LPRINT(5,"\t" + itos (r));
 
-				// store the global lights on the room
-				room.m_GlobalLights.push_back(n);
-			}
+			//l.AddAffectedRoom(r); // no need as this is now done by area
+			LPRINT(5,"\t" + itos (r));
 
+			// store the global lights on the room
+			room.m_GlobalLights.push_back(n);
 		}
 	}
 }
 
 
+int LRoomConverter::Worker_GetNumWorkers() const
+{
+	if (LMAN->m_iConvertThreads > 0)
+		return LMAN->m_iConvertThreads;
+
+	return LWorkerPool::GetDefaultNumWorkers();
+}
+
+void LRoomConverter::Light_Job(void * pUserData, int item, int worker)
+{
+	LRoomConverter * pConverter = (LRoomConverter *) pUserData;
+	pConverter->Light_Trace(pConverter->m_LightJobs[item], *pConverter->m_LightWorkers[worker]);
+}
+
 void LRoomConverter::Convert_Lights()
+{
+	Convert_Lights_Gather();
+	Light_TraceJobs();
+}
+
+void LRoomConverter::Convert_Lights_Gather()
 {
 	// trace local lights out from rooms and add to each room the light affects
+	m_LightJobs.clear();
 	for (int n=0; n<LMAN->m_Lights.size(); n++)
 	{
 		LLight &l = LMAN->m_Lights[n];
 		if (l.m_Source.IsGlobal())
 			continue; // ignore globals .. affect all rooms
 
-		Light_Trace(n);
+		if (l.m_bRemoved)
+			continue;
+
+		LLightJob * pJob = m_LightJobs.request();
+		pJob->m_LightID = n;
+	}
+}
+
+// traces the lights in m_LightJobs, and stores the results
+void LRoomConverter::Light_TraceJobs()
+{
+	int num_workers = Light_TraceJobs_Begin();
+
+	LWorkerPool pool;
+	pool.Run(Light_Job, this, m_LightJobs.size(), num_workers);
+
+	Light_TraceJobs_End();
+}
+
+// creates the per worker data, returns the number of workers to use
+int LRoomConverter::Light_TraceJobs_Begin()
+{
+	int num_workers = Worker_GetNumWorkers();
+
+	// debug planes go in a shared list, and verbose output is only readable from one thread
+	if (LMAN->m_bDebugPlanes || !Lawn::LDebug::m_bRunning)
+		num_workers = 1;
+
+	num_workers = MAX(MIN(num_workers, m_LightJobs.size()), 1);
+
+	// each worker needs its own trace and temporaries
+	for (int n=0; n<num_workers; n++)
+	{
+		LLightWorker * pWorker = memnew(LLightWorker);
+		pWorker->m_Scratch.Create(LMAN->m_Rooms.size(), LMAN->m_SOBs.size());
+		m_LightWorkers.push_back(pWorker);
 	}
+
+	return num_workers;
+}
+
+void LRoomConverter::Light_TraceJobs_End()
+{
+	// store in light order
+	for (int n=0; n<m_LightJobs.size(); n++)
+		Light_StoreTrace(m_LightJobs[n]);
+
+	for (int n=0; n<m_LightWorkers.size(); n++)
+		memdelete(m_LightWorkers[n]);
+
+	m_LightWorkers.clear(true);
+	m_LightJobs.clear(true);
 }
 
 
-void LRoomConverter::Light_Trace(int iLightID)
+// may be called from a worker thread
+void LRoomConverter::Light_Trace(LLightJob &job, LLightWorker &worker)
 {
 	// get the light
-	LLight &l = LMAN->m_Lights[iLightID];
+	const LLight &l = LMAN->m_Lights[job.m_LightID];
 	LPRINT(5,"_____________________________________________________________");
-	LPRINT(5,"\nLight_Trace " + itos (iLightID));
+	LPRINT(5,"\nLight_Trace " + itos (job.m_LightID));
 
-	LMAN->m_Trace.Trace_Light(*LMAN, l, LTrace::LR_CONVERT);
+	worker.m_Trace.Trace_Light(*LMAN, l, LTrace::LR_CONVERT, &worker.m_Scratch);
 
-	// now save the data from the trace
-	LRoomManager::LLightRender &lr = LMAN->m_LightRender;
+	job.m_Rooms.copy_from(worker.m_Scratch.m_Visible_Rooms);
+	job.m_SOBs.copy_from(worker.m_Scratch.m_Visible_SOBs);
+}
+
+void LRoomConverter::Light_StoreTrace(const LLightJob &job)
+{
+	int iLightID = job.m_LightID;
+	LLight &l = LMAN->m_Lights[iLightID];
 
 	// visible rooms
-	for (int n=0; n<lr.m_Temp_Visible_Rooms.size(); n++)
+	for (int n=0; n<job.m_Rooms.size(); n++)
 	{
-		int room_id = lr.m_Temp_Visible_Rooms[n];
+		int room_id = job.m_Rooms[n];
 		LRoom &room = *LMAN->GetRoom(room_id);
 
 		room.AddLocalLight(iLightID);
 
 		// store the affected room on the light
-		l.AddAffectedRoom(room_id);
+		LMAN->Light_AddAffectedRoom(l, room_id);
 	}
 
 
 	// sobs
-	for (int n=0; n<lr.m_Temp_Visible_SOBs.size(); n++)
+	for (int n=0; n<job.m_SOBs.size(); n++)
 	{
-		int sob_id = lr.m_Temp_Visible_SOBs[n];
+		int sob_id = job.m_SOBs[n];
 
 		// first?
 		if (!l.m_NumCasters)
@@ -665,7 +1415,7 @@ void LRoomConverter::Light_Trace(int iLightID)
 		l.m_NumCasters++;
 	}
 
-	LPRINT(5, itos(lr.m_Temp_Visible_Rooms.size()) + " visible rooms, " + itos (lr.m_Temp_Visible_SOBs.size()) + " visible SOBs.\n");
+	LPRINT(5, "Light " + itos(iLightID) + " : " + itos(job.m_Rooms.size()) + " visible rooms, " + itos (job.m_SOBs.size()) + " visible SOBs.\n");
 
 /*
 	// blank this each time as it is used to create the list of casters
@@ -718,7 +1468,7 @@ void LRoomConverter::Light_TraceRecursive(int depth, LRoom &lroom, LLight &light
 		lroom.m_LocalLights.push_back(iLightID);
 
 		// store the affected room on the light
-		light.AddAffectedRoom(lroom.m_RoomID);
+		LMAN->Light_AddAffectedRoom(light, lroom.m_RoomID);
 	}
 
 	// add each light caster that is within the planes to the light caster list
@@ -740,7 +1490,7 @@ void LRoomConverter::Light_TraceRecursive(int depth, LRoom &lroom, LLight &light
 
 
 		// estimate the radius .. for now
-		const AABB &bb = sob.m_aabb;
+		const AABB &bb = LMAN->m_SOB_AABBs[n];
 
 //		print("\t\t\tculling object " + pObj->get_name());
 
@@ -866,92 +1616,172 @@ void LRoomConverter::Convert_ShadowCasters()
 
 
 	for (int l=0; l<nLights; l++)
-	{
-		const LLight &light = LMAN->m_Lights[l];
-		String sz = "Light " + itos (l);
-		if (light.m_Source.IsGlobal())
-			sz += " GLOBAL";
-		else
-			sz += " LOCAL from room " + itos(light.m_Source.m_RoomID);
+		Convert_ShadowCasters_Light(l);
+}
+
+void LRoomConverter::Convert_ShadowCasters_Light(int l)
+{
+	const LLight &light = LMAN->m_Lights[l];
+	String sz = "Light " + itos (l);
+	if (light.m_Source.IsGlobal())
+		sz += " GLOBAL";
+	else
+		sz += " LOCAL from room " + itos(light.m_Source.m_RoomID);
 
-		LPRINT(5, sz + " direction " + light.m_Source.m_ptDir);
+	LPRINT(5, sz + " direction " + light.m_Source.m_ptDir);
 
-		for (int n=0; n<LMAN->m_Rooms.size(); n++)
-		{
-			LRoom &lroom = LMAN->m_Rooms[n];
+	// global lights are dealt with by area
+	if (light.m_Source.IsGlobal())
+		return;
 
-			// global lights affect every room
-			bool bAffectsRoom = false; // true
+	// the rooms a local light affects are stored on the light by the trace, so there is no need
+	// to search the local lights of every room. Sorted to find the casters in room order as before.
+	LVector<int> rooms;
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+		rooms.push_back(LMAN->Light_GetAffectedRoom(light, n));
 
-			// if the light is local, does it affect this room?
-			if (!light.m_Source.IsGlobal())
-			{
-				// a local light .. does it affect this room?
-				bAffectsRoom = false;
-				for (int i=0; i<lroom.m_LocalLights.size(); i++)
-				{
-					// if the light id is found among the local lights for this room
-					if (lroom.m_LocalLights[i] == l)
-					{
-						bAffectsRoom = true;
-						break;
-					}
-				}
-			}
+	rooms.sort();
 
-			if (bAffectsRoom)
-			{
-				LPRINT(2,"\n\tAFFECTS room " + itos(n) + ", " + lroom.get_name());
-				LRoom_FindShadowCasters_FromLight(lroom, light);
-				//LRoom_FindShadowCasters(lroom, l, light);
-			}
-		}
+	for (int n=0; n<rooms.size(); n++)
+	{
+		// a room can only be affected once
+		if (n && (rooms[n] == rooms[n-1]))
+			continue;
+
+		LRoom &lroom = LMAN->m_Rooms[rooms[n]];
+
+		LPRINT(2,"\n\tAFFECTS room " + itos(rooms[n]) + ", " + lroom.get_name());
+		LRoom_FindShadowCasters_FromLight(lroom, light);
+		//LRoom_FindShadowCasters(lroom, l, light);
 	}
 }
 
 
+void LRoomConverter::Bound_Job(void * pUserData, int item, int worker)
+{
+	LRoomConverter * pConverter = (LRoomConverter *) pUserData;
+	LBoundJob &job = pConverter->m_BoundJobs[item];
+	pConverter->Bound_Build(pConverter->m_pManager->m_Rooms[item], job);
+}
+
+void LRoomConverter::Bound_Build(LRoom &lroom, LBoundJob &job)
+{
+	job.m_fError = 0.0f;
+	job.m_bOK = Convert_Bound_FromPoints(lroom, job.m_Pts);
+
+	// fewer planes is faster to test against at runtime when finding the room of a point
+	if (job.m_bOK && LMAN->m_iBound_MaxPlanes)
+		job.m_fError = lroom.m_Bound.Simplify(LMAN->m_iBound_MaxPlanes, lroom.m_BoundHull);
+}
+
 void LRoomConverter::Convert_Bounds()
 {
+	// gather the points on the main thread as this needs the scene tree
+	m_BoundJobs.resize(LMAN->m_Rooms.size());
+
 	for (int n=0; n<LMAN->m_Rooms.size(); n++)
-	{
-		LRoom &lroom = LMAN->m_Rooms[n];
+		Bound_Gather(LMAN->m_Rooms[n], m_BoundJobs[n]);
+
+	// the hulls are independent per room
+	LWorkerPool pool;
+	pool.Run(Bound_Job, this, m_BoundJobs.size(), Worker_GetNumWorkers());
+
+	for (int n=0; n<LMAN->m_Rooms.size(); n++)
+		Bound_Finish(LMAN->m_Rooms[n], m_BoundJobs[n]);
+
+	m_BoundJobs.clear(true);
+}
+
+void LRoomConverter::Bound_Gather(LRoom &lroom, LBoundJob &job)
+{
+	job.m_Pts.clear();
+	job.m_bManual = false;
+	job.m_bOK = false;
+	job.m_fError = 0.0f;
+
+	//print("DetectBounds from room " + lroom.get_name());
 
-		//print("DetectBounds from room " + lroom.get_name());
+	Spatial * pGRoom = lroom.GetGodotRoom();
+	assert (pGRoom);
 
-		Spatial * pGRoom = lroom.GetGodotRoom();
-		assert (pGRoom);
 
+	for (int c=0; c<pGRoom->get_child_count(); c++)
+	{
+		Node * pChild = pGRoom->get_child(c);
 
-		for (int n=0; n<pGRoom->get_child_count(); n++)
+		if (Node_IsBound(pChild))
 		{
-			Node * pChild = pGRoom->get_child(n);
+			MeshInstance * pMesh = Object::cast_to<MeshInstance>(pChild);
+			assert (pMesh);
 
-			if (Node_IsBound(pChild))
-			{
-				MeshInstance * pMesh = Object::cast_to<MeshInstance>(pChild);
-				assert (pMesh);
-				Convert_ManualBound(lroom, pMesh);
+			LPRINT(2, "\tCONVERT_MANUAL_BOUND : '" + pMesh->get_name() + "' for room '" + lroom.get_name() + "'");
 
-				// delete the mesh
-				pGRoom->remove_child(pChild);
-				pChild->queue_delete();
-				break;
+			GetWorldVertsFromMesh(*pMesh, job.m_Pts);
+			for (int p=0; p<job.m_Pts.size(); p++)
+			{
+				// expand the room AABB to make sure it encompasses the bound
+				lroom.m_AABB.expand_to(job.m_Pts[p]);
 			}
+			job.m_bManual = true;
+
+			// delete the mesh
+			Node_Delete(pChild, true);
+			break;
 		}
+	}
 
-		// if no manual bound is found, we will create one by using qhull on all the points
-		if (!lroom.m_Bound.IsActive())
-		{
-			Vector<Vector3> pts;
-			Bound_FindPoints_Recursive(pGRoom, pts);
+	// the bound_ mesh was deleted when the room was first converted, so use the hull kept from then
+	for (int n=LMAN->m_DetachedBounds.size()-1; n>=0; n--)
+	{
+		LRoomManager::LDetachedBound &detached = LMAN->m_DetachedBounds[n];
+		if (detached.m_szOwnerRoom != lroom.m_szName)
+			continue;
 
-			LPRINT(2, "\tCONVERT_AUTO_BOUND room : '" + lroom.get_name() + "' (" + itos(pts.size()) + " verts)");
+		if (!job.m_bManual)
+		{
+			LPRINT(2, "\tCONVERT_MANUAL_BOUND : kept from before for room '" + lroom.get_name() + "'");
 
-			// use qhull
-			Convert_Bound_FromPoints(lroom, pts);
+			job.m_Pts = detached.m_Pts;
+			for (int p=0; p<job.m_Pts.size(); p++)
+				lroom.m_AABB.expand_to(job.m_Pts[p]);
+			job.m_bManual = true;
 		}
+
+		LMAN->m_DetachedBounds.remove_unsorted(n);
+	}
+
+	// if no manual bound is found, we will create one by using qhull on all the points
+	if (!job.m_bManual)
+	{
+		Bound_FindPoints_Recursive(pGRoom, job.m_Pts);
+		LPRINT(2, "\tCONVERT_AUTO_BOUND room : '" + lroom.get_name() + "' (" + itos(job.m_Pts.size()) + " verts)");
+	}
+}
+
+void LRoomConverter::Bound_Finish(LRoom &lroom, LBoundJob &job)
+{
+	// a manual bound that failed falls back to the auto bound, this is rare so not worth threading
+	if (!lroom.m_Bound.IsActive() && job.m_bManual)
+	{
+		job.m_bManual = false;
+		job.m_Pts.clear();
+		Bound_FindPoints_Recursive(lroom.GetGodotRoom(), job.m_Pts);
+
+		LPRINT(2, "\tCONVERT_AUTO_BOUND room : '" + lroom.get_name() + "' (" + itos(job.m_Pts.size()) + " verts)");
+
+		// use qhull
+		Bound_Build(lroom, job);
+	}
+
+	if (job.m_bOK)
+	{
+		LPRINT(2, "\troom '" + lroom.get_name() + "' bound contained " + itos(lroom.m_Bound.m_Planes.size()) + " planes.");
+
+		if (job.m_fError > 0.0f)
+			LPRINT(2, "\t\tsimplified, max error " + String(Variant(job.m_fError)));
 	}
 
+	lroom.m_bManualBound = job.m_bManual && job.m_bOK;
 }
 
 void LRoomConverter::Bound_FindPoints_Recursive(Node * pNode, Vector<Vector3> &pts)
@@ -1167,7 +1997,7 @@ void LRoomConverter::LRoom_FindShadowCasters_Recursive(LRoom &source_lroom, int
 			continue;
 
 		bool bShow = true;
-		const AABB &bb = sob.m_aabb;
+		const AABB &bb = LMAN->m_SOB_AABBs[n];
 
 //		print("\t\t\tculling object " + pObj->get_name());
 
@@ -1349,8 +2179,7 @@ void LRoomConverter::LRoom_DetectPortalMeshes(LRoom &lroom, LTempRoom &troom)
 				{
 					// delete the original child, as it is no longer needed at runtime (except maybe for debugging .. NYI?)
 					//	pMeshInstance->hide();
-					pChild->get_parent()->remove_child(pChild);
-					pChild->queue_delete();
+					Node_Delete(pChild, true);
 					bDetectedOne = true;
 				}
 
@@ -1363,13 +2192,14 @@ void LRoomConverter::LRoom_DetectPortalMeshes(LRoom &lroom, LTempRoom &troom)
 
 }
 
-void LRoomConverter::LRoom_PushBackSOB(LRoom &lroom, const LSob &sob)
+void LRoomConverter::LRoom_PushBackSOB(LRoom &lroom, const LSob &sob, const AABB &bb)
 {
 	// first added for this room?
 	if (lroom.m_iNumSOBs == 0)
 		lroom.m_iFirstSOB = LMAN->m_SOBs.size();
 
 	LMAN->m_SOBs.push_back(sob);
+	LMAN->m_SOB_AABBs.push_back(bb);
 	lroom.m_iNumSOBs++;
 }
 
@@ -1426,7 +2256,7 @@ void LRoomConverter::LRoom_DetectedLight(LRoom &lroom, Node * pNode)
 	{
 		LPRINT(2, "Deleting Light : " + pLight->get_name());
 		// delete light now we are using lightmaps for test
-		pLight->queue_delete();
+		Node_Delete(pLight, false);
 	}
 	else
 	{
@@ -1442,7 +2272,7 @@ void LRoomConverter::LRoom_DetectedPortalMesh(LRoom &lroom, LTempRoom &troom, Me
 
 	// which room does this portal want to link to?
 	int iLinkRoom = FindRoom_ByName(szLinkRoom);
-	if (iLinkRoom == -1)
+	if ((iLinkRoom == -1) && !m_bIncremental)
 	{
 		LWARN(5, "portal to room " + szLinkRoom + ", room not found");
 		//WARN_PRINTS("portal to room " + szLinkRoom + ", room not found");
@@ -1454,15 +2284,27 @@ void LRoomConverter::LRoom_DetectedPortalMesh(LRoom &lroom, LTempRoom &troom, Me
 	Array arrays = rmesh->surface_get_arrays(0);
 	PoolVector<Vector3> p_vertices = arrays[VS::ARRAY_VERTEX];
 
+	// when adding rooms incrementally the linked room may not be added yet,
+	// the portal is kept detached until it is
+	LPortal detached;
+	LPortal &lport = (iLinkRoom != -1) ? *troom.m_Portals.request() : detached;
 
 	// create a new LPortal to fill with this wonderful info
-	LPortal &lport = *troom.m_Portals.request();
 	lport.m_szName = szLinkRoom;
 	lport.m_iRoomNum = iLinkRoom;
 
 	// create the portal geometry
 	lport.CreateGeometry(p_vertices, pMeshInstance->get_global_transform(), LMAN->m_bPortalPlane_Convention);
 
+	if (iLinkRoom == -1)
+	{
+		LPRINT(2, "\t\troom not added yet, detached");
+
+		LRoomManager::LDetachedPortal * pDetached = LMAN->m_DetachedPortals.request();
+		pDetached->m_szOwnerRoom = lroom.m_szName;
+		pDetached->m_Portal = lport;
+	}
+
 
 //	LPRINT(2, "\t\t\tnum portals now " + itos(troom.m_Portals.size()));
 }
@@ -1516,10 +2358,14 @@ void LRoomConverter::LRoom_MakePortalsTwoWay(LRoom &lroom, LTempRoom &troom, int
 void LRoomConverter::TRoom_MakeOppositePortal(const LPortal &port, int iRoomOrig)
 {
 	LTempRoom &nroom = m_TempRooms[port.m_iRoomNum];
+	Portal_MakeOpposite(port, iRoomOrig, *nroom.m_Portals.request());
+}
+
+void LRoomConverter::Portal_MakeOpposite(const LPortal &port, int iRoomOrig, LPortal &new_port) const
+{
 	const LRoom &orig_lroom = LMAN->m_Rooms[iRoomOrig];
 
 	// the new portal should have the name of the room the original came from
-	LPortal &new_port = *nroom.m_Portals.request();
 	new_port.m_szName = orig_lroom.m_szName;
 	new_port.m_iRoomNum = iRoomOrig;
 	new_port.m_bMirror = true;
@@ -1530,8 +2376,912 @@ void LRoomConverter::TRoom_MakeOppositePortal(const LPortal &port, int iRoomOrig
 
 
 ///////////////////////////////////////////////////
+// incremental conversion
+// Rooms are added into free slots (or the end of the room list), and their SOBs and portals to the end of
+// the contiguous lists. Spans of other rooms that need to grow (e.g. to add mirror portals) are moved
+// to the end of their list, leaving gaps that are compacted when they get too big.
+
+int LRoomConverter::Incremental_AddRoom(LRoomManager &manager, Spatial * pNode)
+{
+	LMAN = &manager;
+	LROOMLIST = manager.GetRoomList();
+
+	if (!Node_IsRoom(pNode) || !LROOMLIST->is_a_parent_of(pNode))
+	{
+		LWARN(2, "rooms_add_room : node must be a room_ within the room list : " + pNode->get_name());
+		return -1;
+	}
+
+	String szRoom = LPortal::FindNameAfter(pNode, "room_");
+	for (int n=0; n<LMAN->m_Rooms.size(); n++)
+	{
+		const LRoom &lroom = LMAN->m_Rooms[n];
+		if (lroom.m_bRemoved)
+			continue;
+
+		if ((lroom.m_GodotID == pNode->get_instance_id()) || (lroom.m_szName == szRoom))
+		{
+			LWARN(2, "rooms_add_room : room already converted : " + szRoom);
+			return -1;
+		}
+	}
+
+	Incremental_Begin(manager);
+
+	// reuse the slot of a removed room
+	int slot = -1;
+	for (int n=0; n<LMAN->m_Rooms.size(); n++)
+	{
+		if (LMAN->m_Rooms[n].m_bRemoved)
+		{
+			slot = n;
+			break;
+		}
+	}
+
+	if (slot == -1)
+	{
+		slot = LMAN->m_Rooms.size();
+		LMAN->m_Rooms.resize(slot + 1);
+		LMAN->RoomID_Append(slot);
+	}
+
+	Incremental_ConvertRoom(pNode, slot, false);
+	Incremental_End();
+
+	LPRINT(5, "rooms_add_room : " + szRoom + " room_id " + itos(slot));
+	return slot;
+}
+
+bool LRoomConverter::Incremental_RemoveRoom(LRoomManager &manager, int room_id)
+{
+	LRoom * pRoom = manager.GetRoom(room_id);
+	if (!pRoom || pRoom->m_bRemoved)
+	{
+		WARN_PRINT_ONCE("rooms_remove_room : room not found");
+		return false;
+	}
+
+	LPRINT(5, "rooms_remove_room : " + pRoom->get_name() + " room_id " + itos(room_id));
+
+	Incremental_Begin(manager);
+	Incremental_ReleaseRoom(room_id, false);
+	Incremental_End();
+
+	// the dobs that were in the room go to whichever room they are now closest to
+	for (int n=0; n<m_Incremental_DOBs.size(); n++)
+	{
+		int dob_id = m_Incremental_DOBs[n];
+		if (!LMAN->m_DobList.IsValid(dob_id))
+			continue;
+
+		LDob &dob = LMAN->m_DobList.GetDob(dob_id);
+		dob.m_iRoomID = LMAN->FindClosestRoom(dob.m_ptPos);
+
+		LRoom * pNewRoom = LMAN->GetRoom(dob.m_iRoomID);
+		if (pNewRoom)
+			pNewRoom->DOB_Add(*LMAN, dob_id);
+	}
+
+	return true;
+}
+
+bool LRoomConverter::Incremental_RebuildRoom(LRoomManager &manager, int room_id)
+{
+	LRoom * pRoom = manager.GetRoom(room_id);
+	if (!pRoom || pRoom->m_bRemoved)
+	{
+		WARN_PRINT_ONCE("rooms_rebuild_room : room not found");
+		return false;
+	}
+
+	Spatial * pNode = pRoom->GetGodotRoom();
+	if (!pNode)
+	{
+		WARN_PRINT_ONCE("rooms_rebuild_room : room node no longer exists");
+		return false;
+	}
+
+	LPRINT(5, "rooms_rebuild_room : " + pRoom->get_name() + " room_id " + itos(room_id));
+
+	Incremental_Begin(manager);
+	Incremental_ReleaseRoom(room_id, true);
+	Incremental_ConvertRoom(pNode, room_id, true);
+	Incremental_End();
+
+	// the dobs stay in the room
+	LRoom &lroom = LMAN->m_Rooms[room_id];
+	for (int n=0; n<m_Incremental_DOBs.size(); n++)
+	{
+		int dob_id = m_Incremental_DOBs[n];
+		if (LMAN->m_DobList.IsValid(dob_id))
+			lroom.DOB_Add(*LMAN, dob_id);
+	}
+
+	return true;
+}
+
+void LRoomConverter::Incremental_Begin(LRoomManager &manager)
+{
+	LMAN = &manager;
+	LROOMLIST = manager.GetRoomList();
+
+	m_bFinalRun = true;
+	m_bDeleteLights = manager.m_Incremental.m_bDeleteLights;
+	m_bSingleRoomMode = false;
+	m_bIncremental = true;
+
+	m_Incremental_Lights.clear();
+	m_Incremental_Rooms.clear();
+	m_Incremental_DOBs.clear();
+
+	// loaded baked data points into the shared file data, take copies so they can be changed
+	if (LMAN->m_pBakedData)
+	{
+		LMAN->m_ShadowCasters_SOB.make_owned();
+		LMAN->m_LightCasters_SOB.make_owned();
+		LMAN->m_AreaLights.make_owned();
+		LMAN->m_AreaRooms.make_owned();
+		LMAN->m_SOB_AABBs.make_owned();
+
+		for (int n=0; n<LMAN->m_Rooms.size(); n++)
+		{
+			LRoom &lroom = LMAN->m_Rooms[n];
+			lroom.m_Bound.m_Planes.make_owned();
+			lroom.m_BoundHull.MakeOwned();
+		}
+
+		for (int n=0; n<LMAN->m_Portals.size(); n++)
+			LMAN->m_Portals[n].m_ptsWorld.make_owned();
+
+		LMAN->m_pBakedData->Release();
+		LMAN->m_pBakedData = 0;
+	}
+
+	LMAN->m_Incremental.m_bChanged = true;
+}
+
+void LRoomConverter::Incremental_End()
+{
+	LMAN->m_RoomBVH.Create(LMAN->m_Rooms);
+	LMAN->CreateBitfields(true);
+
+	// must be done after the bitfields
+	Incremental_Relight();
+
+	// don't let the lists fill up with gaps
+	const LRoomManager::LIncremental &inc = LMAN->m_Incremental;
+	int unused = inc.m_iUnused_Portals + inc.m_iUnused_SOBs + inc.m_iUnused_LightCasters + inc.m_iUnused_ShadowCasters + inc.m_iUnused_AreaRooms + inc.m_iUnused_AreaLights;
+	int total = LMAN->m_Portals.size() + LMAN->m_SOBs.size() + LMAN->m_LightCasters_SOB.size() + LMAN->m_ShadowCasters_SOB.size() + LMAN->m_AreaRooms.size() + LMAN->m_AreaLights.size();
+
+	if ((unused > 256) && (unused > (total / 2)))
+		Incremental_Compact();
+
+	// new rooms and SOBs, and compacting renumbers the SOBs
+	LMAN->ObjectCache_WatchAll();
+}
+
+// area of a room is given by an area_ parent, as in Convert_Rooms_Recursive
+int LRoomConverter::Incremental_FindArea(Node * pNode)
+{
+	Node * pParent = pNode->get_parent();
+	if (!pParent || (pParent == LROOMLIST) || !Node_IsArea(pParent))
+		return -1;
+
+	String szArea = LPortal::FindNameAfter(pParent, "area_");
+	return Area_FindOrCreate(szArea);
+}
+
+int LRoomConverter::Incremental_ConvertRoom(Spatial * pNode, int slot, bool bRebuild)
+{
+	int old_num_lights = LMAN->m_Lights.size();
+
+	LMAN->m_Rooms[slot] = LRoom();
+	Convert_Room(pNode, slot, Incremental_FindArea(pNode));
+
+	LRoom &lroom = LMAN->m_Rooms[slot];
+
+	// not visible until the camera trace finds it
+	lroom.Room_MakeVisible(false);
+
+	// new lights go in the slots of removed lights
+	LVector<LLight> new_lights;
+	for (int n=old_num_lights; n<LMAN->m_Lights.size(); n++)
+		new_lights.push_back(LMAN->m_Lights[n]);
+
+	LMAN->m_Lights.resize(old_num_lights);
+
+	int free_light = 0;
+	for (int n=0; n<new_lights.size(); n++)
+	{
+		while ((free_light < LMAN->m_Lights.size()) && !LMAN->m_Lights[free_light].m_bRemoved)
+			free_light++;
+
+		int light_id = free_light;
+		if (light_id < LMAN->m_Lights.size())
+			LMAN->m_Lights[light_id] = new_lights[n];
+		else
+			LMAN->m_Lights.push_back(new_lights[n]);
+
+		m_Incremental_Lights.push_back(light_id);
+	}
+
+	// PORTALS
+	// the room's own detached portals (from when it was removed or rebuilt) are only used if
+	// there are no portal meshes to replace them, e.g. rebuilding, or adding the same node again
+	LVector<LPortal> own_detached;
+	for (int n=LMAN->m_DetachedPortals.size()-1; n>=0; n--)
+	{
+		if (LMAN->m_DetachedPortals[n].m_szOwnerRoom == lroom.m_szName)
+		{
+			own_detached.push_back(LMAN->m_DetachedPortals[n].m_Portal);
+			LMAN->m_DetachedPortals.remove_unsorted(n);
+		}
+	}
+
+	bool bPortalMeshes = false;
+	for (int n=0; n<pNode->get_child_count(); n++)
+	{
+		if (Node_IsPortal(pNode->get_child(n)))
+			bPortalMeshes = true;
+	}
+
+	// portals from the portal meshes in the room
+	LTempRoom troom;
+	LRoom_DetectPortalMeshes(lroom, troom);
+
+	if (bRebuild || !bPortalMeshes)
+	{
+		for (int n=0; n<own_detached.size(); n++)
+		{
+			LPortal &port = own_detached[n];
+			port.m_iRoomNum = FindRoom_ByName(port.m_szName);
+
+			if (port.m_iRoomNum != -1)
+			{
+				troom.m_Portals.push_back(port);
+			}
+			else
+			{
+				// linked room still not added
+				LRoomManager::LDetachedPortal * pDetached = LMAN->m_DetachedPortals.request();
+				pDetached->m_szOwnerRoom = lroom.m_szName;
+				pDetached->m_Portal = port;
+			}
+		}
+	}
+
+	// the room's portal list is its own portals, then the mirrors of portals from other rooms into it
+	LVector<LPortal> portals;
+	LVector<LPortal> add;
+	LVector<int> neighbours;
+
+	for (int n=0; n<troom.m_Portals.size(); n++)
+	{
+		const LPortal &port = troom.m_Portals[n];
+		portals.push_back(port);
+
+		// mirror in the linked room
+		add.resize(1);
+		Portal_MakeOpposite(port, slot, add[0]);
+		Incremental_AppendPortals(LMAN->m_Rooms[port.m_iRoomNum], add);
+
+		if (neighbours.find(port.m_iRoomNum) == -1)
+			neighbours.push_back(port.m_iRoomNum);
+	}
+
+	// detached portals of other rooms linking to this room can now be linked
+	for (int n=LMAN->m_DetachedPortals.size()-1; n>=0; n--)
+	{
+		LRoomManager::LDetachedPortal &detached = LMAN->m_DetachedPortals[n];
+		if (detached.m_Portal.m_szName != lroom.m_szName)
+			continue;
+
+		int owner = FindRoom_ByName(detached.m_szOwnerRoom);
+		if (owner == -1)
+			continue;
+
+		add.resize(1);
+		add[0] = detached.m_Portal;
+		add[0].m_iRoomNum = slot;
+		Incremental_AppendPortals(LMAN->m_Rooms[owner], add);
+
+		LPortal mirror;
+		Portal_MakeOpposite(add[0], owner, mirror);
+		portals.push_back(mirror);
+
+		if (neighbours.find(owner) == -1)
+			neighbours.push_back(owner);
+
+		LMAN->m_DetachedPortals.remove_unsorted(n);
+	}
+
+	lroom.m_iNumPortals = 0;
+	Incremental_AppendPortals(lroom, portals);
+
+	// BOUND
+	LBoundJob job;
+	Bound_Gather(lroom, job);
+	Bound_Build(lroom, job);
+	Bound_Finish(lroom, job);
+
+	// AREAS
+	for (int n=0; n<lroom.m_Areas.size(); n++)
+		Incremental_AddRoomToArea(lroom.m_Areas[n], slot);
+
+	// global lights waiting for an area that has now been created
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		const LLight &l = LMAN->m_Lights[n];
+		if (!l.m_Source.IsGlobal() || (l.m_iArea != -1) || l.m_bRemoved)
+			continue;
+
+		int a = Area_Find(l.m_szArea);
+		if (a != -1)
+			Incremental_AddAreaLight(n, a);
+	}
+
+	// global lights in the areas of the room, in light order as Convert_AreaLights
+	lroom.m_GlobalLights.clear();
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		const LLight &l = LMAN->m_Lights[n];
+		if ((l.m_iArea != -1) && lroom.IsInArea(l.m_iArea))
+			lroom.m_GlobalLights.push_back(n);
+	}
+
+	// LIGHTS
+	// lights shining into the neighbouring rooms may now reach through into this room
+	for (int n=0; n<neighbours.size(); n++)
+	{
+		const LRoom &neighbour = LMAN->m_Rooms[neighbours[n]];
+		for (int l=0; l<neighbour.m_LocalLights.size(); l++)
+		{
+			int light_id = neighbour.m_LocalLights[l];
+			if (m_Incremental_Lights.find(light_id) == -1)
+				m_Incremental_Lights.push_back(light_id);
+		}
+	}
+
+	m_Incremental_Rooms.push_back(slot);
+
+	return slot;
+}
+
+void LRoomConverter::Incremental_ReleaseRoom(int room_id, bool bRebuild)
+{
+	LRoom &lroom = LMAN->m_Rooms[room_id];
+
+	// back to how they were before conversion, so they can be freed or found again.
+	// Rebuilding converts the sobs again straight away, which sets their layers anyway.
+	Incremental_RestoreNodes(lroom, !bRebuild);
+
+	// SOBS
+	int first_sob = lroom.m_iFirstSOB;
+	int last_sob = first_sob + lroom.m_iNumSOBs;
+	for (int n=first_sob; n<last_sob; n++)
+	{
+		LSob &sob = LMAN->m_SOBs[n];
+		sob.m_ID = 0;
+		sob.m_pNode = 0;
+		sob.m_pParent = 0;
+		sob.Cache_Invalidate();
+
+		LMAN->m_BF_master_SOBs.SetBit(n, false);
+		LMAN->m_BF_master_SOBs_prev.SetBit(n, false);
+	}
+
+	LVector<int> * pMasterLists[2] = {&LMAN->m_MasterList_SOBs, &LMAN->m_MasterList_SOBs_prev};
+	for (int l=0; l<2; l++)
+	{
+		LVector<int> &list = *pMasterLists[l];
+		for (int n=list.size()-1; n>=0; n--)
+		{
+			if ((list[n] >= first_sob) && (list[n] < last_sob))
+				list.remove_unsorted(n);
+		}
+	}
+
+	LMAN->m_Incremental.m_iUnused_SOBs += lroom.m_iNumSOBs;
+	LMAN->m_Incremental.m_iUnused_ShadowCasters += lroom.m_iNumShadowCasters_SOB;
+
+	// LIGHTS
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		const LLight &l = LMAN->m_Lights[n];
+		if (!l.m_bRemoved && !l.m_Source.IsGlobal() && (l.m_Source.m_RoomID == room_id))
+			Incremental_RemoveLight(n);
+	}
+
+	// lights from other rooms shining into this room may reach less far
+	for (int n=0; n<lroom.m_LocalLights.size(); n++)
+	{
+		int light_id = lroom.m_LocalLights[n];
+		if (m_Incremental_Lights.find(light_id) == -1)
+			m_Incremental_Lights.push_back(light_id);
+	}
+
+	// PORTALS
+	// the original (non mirror) portals either way are kept detached, for when the room is added again
+	for (int n=0; n<lroom.m_iNumPortals; n++)
+	{
+		LPortal port = LMAN->m_Portals[lroom.m_iFirstPortal + n];
+		int linked = port.m_iRoomNum;
+
+		Incremental_RemovePortalsTo(LMAN->m_Rooms[linked], room_id);
+
+		if (!port.m_bMirror)
+		{
+			port.m_iRoomNum = -1;
+
+			LRoomManager::LDetachedPortal * pDetached = LMAN->m_DetachedPortals.request();
+			pDetached->m_szOwnerRoom = lroom.m_szName;
+			pDetached->m_Portal = port;
+		}
+	}
+
+	LMAN->m_Incremental.m_iUnused_Portals += lroom.m_iNumPortals;
+
+	// BOUND
+	if (lroom.m_bManualBound)
+	{
+		LRoomManager::LDetachedBound * pDetached = LMAN->m_DetachedBounds.request();
+		pDetached->m_szOwnerRoom = lroom.m_szName;
+		pDetached->m_Pts.clear();
+		for (int n=0; n<lroom.m_BoundHull.m_Verts.size(); n++)
+			pDetached->m_Pts.push_back(lroom.m_BoundHull.m_Verts[n]);
+	}
+
+	// AREAS
+	for (int n=0; n<lroom.m_Areas.size(); n++)
+		Incremental_RemoveRoomFromArea(lroom.m_Areas[n], room_id);
+
+	// DOBS
+	m_Incremental_DOBs.copy_from(lroom.m_DOBs);
+
+	// no longer visible
+	LVector<int> * pRoomLists[2] = {&LMAN->m_VisibleRoomList_A, &LMAN->m_VisibleRoomList_B};
+	for (int l=0; l<2; l++)
+	{
+		int found = pRoomLists[l]->find(room_id);
+		if (found != -1)
+			pRoomLists[l]->remove_unsorted(found);
+	}
+
+	LMAN->m_BF_visible_rooms.SetBit(room_id, false);
+
+	// keep the slot
+	lroom = LRoom();
+	lroom.m_RoomID = room_id;
+	lroom.m_GodotID = 0;
+	lroom.m_ptCentre = Vector3(0, 0, 0);
+	lroom.m_bRemoved = true;
+	m_bRoomNamesDirty = true;
+}
+
+void LRoomConverter::Incremental_RestoreNodes(LRoom &lroom, bool bRestoreLayers)
+{
+	int last_sob = lroom.m_iFirstSOB + lroom.m_iNumSOBs;
+	for (int n=lroom.m_iFirstSOB; n<last_sob; n++)
+	{
+		LSob &sob = LMAN->m_SOBs[n];
+		sob.Show(true);
+
+		if (!bRestoreLayers)
+			continue;
+
+		// the original layer mask is lost on conversion, so show on both the camera and lights
+		VisualInstance * pVI = sob.GetVI();
+		if (pVI)
+			LRoom::SoftShow(pVI, LRoom::LAYER_MASK_CAMERA | LRoom::LAYER_MASK_LIGHT);
+	}
+
+	for (int n=0; n<LMAN->m_Lights.size(); n++)
+	{
+		LLight &l = LMAN->m_Lights[n];
+		if (!l.m_bRemoved && !l.m_Source.IsGlobal() && (l.m_Source.m_RoomID == lroom.m_RoomID))
+			l.Show(true);
+	}
+}
+
+void LRoomConverter::Incremental_RemoveLight(int light_id)
+{
+	LLight &light = LMAN->m_Lights[light_id];
+
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+	{
+		int room_id = LMAN->Light_GetAffectedRoom(light, n);
+		LMAN->m_Rooms[room_id].RemoveLocalLight(light_id);
+
+		// the shadow casters of the room change
+		if (m_Incremental_Rooms.find(room_id) == -1)
+			m_Incremental_Rooms.push_back(room_id);
+	}
+
+	LMAN->Light_ClearAffectedRooms(light);
+
+	LMAN->m_Incremental.m_iUnused_LightCasters += light.m_NumCasters;
+	light.m_NumCasters = 0;
+
+	// the light may be in the frame lists
+	int found = LMAN->m_ActiveLights.find(light_id);
+	if (found != -1)
+		LMAN->m_ActiveLights.remove_unsorted(found);
+
+	found = LMAN->m_ActiveLights_prev.find(light_id);
+	if (found != -1)
+		LMAN->m_ActiveLights_prev.remove_unsorted(found);
+
+	LMAN->m_BF_ActiveLights.SetBit(light_id, false);
+	LMAN->m_BF_ActiveLights_prev.SetBit(light_id, false);
+
+	found = LMAN->m_LightRetrace_Pending.find(light_id);
+	if (found != -1)
+		LMAN->m_LightRetrace_Pending.remove_unsorted(found);
+
+	light.m_bRetracePending = false;
+	light.m_bRemoved = true;
+	light.m_GodotID = 0;
+	light.m_pNode = 0;
+	light.m_pParent = 0;
+	light.m_Source.m_RoomID = -1;
+	light.Cache_Invalidate();
+}
+
+// adds portals to the end of the room's span, moving it to the end of the portal list if necessary
+void LRoomConverter::Incremental_AppendPortals(LRoom &lroom, const LVector<LPortal> &portals)
+{
+	if (!portals.size())
+		return;
+
+	LVector<LPortal> &list = LMAN->m_Portals;
+
+	bool bAtEnd = lroom.m_iNumPortals && ((lroom.m_iFirstPortal + lroom.m_iNumPortals) == list.size());
+
+	if (!bAtEnd)
+	{
+		int new_first = list.size();
+		for (int n=0; n<lroom.m_iNumPortals; n++)
+		{
+			// copy, as push_back may move the list
+			LPortal port = list[lroom.m_iFirstPortal + n];
+			list.push_back(port);
+		}
+
+		LMAN->m_Incremental.m_iUnused_Portals += lroom.m_iNumPortals;
+		lroom.m_iFirstPortal = new_first;
+	}
+
+	for (int n=0; n<portals.size(); n++)
+		list.push_back(portals[n]);
+
+	lroom.m_iNumPortals += portals.size();
+}
+
+// removes the portals (and mirrors) linking to a room, keeping the original portals detached
+void LRoomConverter::Incremental_RemovePortalsTo(LRoom &lroom, int linked_room_id)
+{
+	LVector<LPortal> &list = LMAN->m_Portals;
+
+	int kept = 0;
+	for (int n=0; n<lroom.m_iNumPortals; n++)
+	{
+		const LPortal &port = list[lroom.m_iFirstPortal + n];
+
+		if (port.m_iRoomNum != linked_room_id)
+		{
+			list[lroom.m_iFirstPortal + kept++] = port;
+			continue;
+		}
+
+		if (!port.m_bMirror)
+		{
+			LRoomManager::LDetachedPortal * pDetached = LMAN->m_DetachedPortals.request();
+			pDetached->m_szOwnerRoom = lroom.m_szName;
+			pDetached->m_Portal = port;
+			pDetached->m_Portal.m_iRoomNum = -1;
+		}
+	}
+
+	LMAN->m_Incremental.m_iUnused_Portals += lroom.m_iNumPortals - kept;
+	lroom.m_iNumPortals = kept;
+}
+
+void LRoomConverter::Incremental_AddRoomToArea(int area_id, int room_id)
+{
+	LArea &area = LMAN->m_Areas[area_id];
+	LBakedVector<uint32_t> &list = LMAN->m_AreaRooms;
+
+	bool bAtEnd = area.m_iNumRooms && ((area.m_iFirstRoom + area.m_iNumRooms) == list.size());
+
+	if (!bAtEnd)
+	{
+		int new_first = list.size();
+		for (int n=0; n<area.m_iNumRooms; n++)
+		{
+			uint32_t r = list[area.m_iFirstRoom + n];
+			list.push_back(r);
+		}
+
+		LMAN->m_Incremental.m_iUnused_AreaRooms += area.m_iNumRooms;
+		area.m_iFirstRoom = new_first;
+	}
+
+	list.push_back(room_id);
+	area.m_iNumRooms++;
+}
+
+void LRoomConverter::Incremental_RemoveRoomFromArea(int area_id, int room_id)
+{
+	LArea &area = LMAN->m_Areas[area_id];
+	LBakedVector<uint32_t> &list = LMAN->m_AreaRooms;
+
+	int kept = 0;
+	for (int n=0; n<area.m_iNumRooms; n++)
+	{
+		uint32_t r = list[area.m_iFirstRoom + n];
+		if (r != (uint32_t) room_id)
+			list.set(area.m_iFirstRoom + kept++, r);
+	}
+
+	LMAN->m_Incremental.m_iUnused_AreaRooms += area.m_iNumRooms - kept;
+	area.m_iNumRooms = kept;
+}
+
+void LRoomConverter::Incremental_AddAreaLight(int light_id, int area_id)
+{
+	LMAN->m_Lights[light_id].m_iArea = area_id;
+
+	LArea &area = LMAN->m_Areas[area_id];
+	LBakedVector<uint32_t> &list = LMAN->m_AreaLights;
+
+	bool bAtEnd = area.m_iNumLights && ((area.m_iFirstLight + area.m_iNumLights) == list.size());
+
+	if (!bAtEnd)
+	{
+		int new_first = list.size();
+		for (int n=0; n<area.m_iNumLights; n++)
+		{
+			uint32_t l = list[area.m_iFirstLight + n];
+			list.push_back(l);
+		}
+
+		LMAN->m_Incremental.m_iUnused_AreaLights += area.m_iNumLights;
+		area.m_iFirstLight = new_first;
+	}
+
+	list.push_back(light_id);
+	area.m_iNumLights++;
+
+	// store the global light on the rooms in the area
+	for (int n=0; n<area.m_iNumRooms; n++)
+		LMAN->m_Rooms[LMAN->m_AreaRooms[area.m_iFirstRoom + n]].m_GlobalLights.push_back(light_id);
+}
+
+// adds the affected rooms of a light to the rooms whose shadow casters need finding again
+void LRoomConverter::Incremental_MarkLightRooms(int light_id)
+{
+	const LLight &light = LMAN->m_Lights[light_id];
+
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+	{
+		int room_id = LMAN->Light_GetAffectedRoom(light, n);
+		if (m_Incremental_Rooms.find(room_id) == -1)
+			m_Incremental_Rooms.push_back(room_id);
+	}
+}
+
+void LRoomConverter::Incremental_Relight()
+{
+	// clear the old traces of the lights that need retracing
+	m_LightJobs.clear();
+	for (int n=0; n<m_Incremental_Lights.size(); n++)
+	{
+		int light_id = m_Incremental_Lights[n];
+		LLight &light = LMAN->m_Lights[light_id];
+
+		if (light.m_bRemoved || light.m_Source.IsGlobal())
+			continue;
+
+		Incremental_MarkLightRooms(light_id);
+
+		for (int r=0; r<light.m_NumAffectedRooms; r++)
+			LMAN->m_Rooms[LMAN->Light_GetAffectedRoom(light, r)].RemoveLocalLight(light_id);
+
+		LMAN->Light_ClearAffectedRooms(light);
+
+		LMAN->m_Incremental.m_iUnused_LightCasters += light.m_NumCasters;
+		light.m_NumCasters = 0;
+
+		// dynamic lights retrace from the new conversion trace
+		light.m_bTraced = false;
+
+		LLightJob * pJob = m_LightJobs.request();
+		pJob->m_LightID = light_id;
+	}
+
+	LPRINT(2, "Incremental_Relight " + itos(m_LightJobs.size()) + " lights");
+
+	// new traces, added to the end of the caster list
+	Light_TraceJobs();
+
+	for (int n=0; n<m_Incremental_Lights.size(); n++)
+	{
+		if (!LMAN->m_Lights[m_Incremental_Lights[n]].m_bRemoved)
+			Incremental_MarkLightRooms(m_Incremental_Lights[n]);
+	}
+
+	// shadow casters of the rooms the lights have changed in
+	for (int n=0; n<m_Incremental_Rooms.size(); n++)
+	{
+		LRoom &lroom = LMAN->m_Rooms[m_Incremental_Rooms[n]];
+		if (lroom.m_bRemoved)
+			continue;
+
+		LMAN->m_Incremental.m_iUnused_ShadowCasters += lroom.m_iNumShadowCasters_SOB;
+		lroom.m_iNumShadowCasters_SOB = 0;
+
+		for (int l=0; l<lroom.m_LocalLights.size(); l++)
+			LRoom_FindShadowCasters_FromLight(lroom, LMAN->m_Lights[lroom.m_LocalLights[l]]);
+	}
+}
+
+// removes the gaps left in the contiguous lists by incremental conversion
+void LRoomConverter::Incremental_Compact()
+{
+	LPRINT(2, "Incremental_Compact");
+
+	LVector<LRoom> &rooms = LMAN->m_Rooms;
+
+	// SOBS, the IDs change so need remapping everywhere they are used
+	LVector<int> remap;
+	remap.resize(LMAN->m_SOBs.size());
+	for (int n=0; n<remap.size(); n++)
+		remap[n] = -1;
+
+	LVector<LSob> sobs;
+	LVector<AABB> aabbs;
+	for (int r=0; r<rooms.size(); r++)
+	{
+		LRoom &lroom = rooms[r];
+		int new_first = sobs.size();
+
+		for (int n=0; n<lroom.m_iNumSOBs; n++)
+		{
+			remap[lroom.m_iFirstSOB + n] = sobs.size();
+			sobs.push_back(LMAN->m_SOBs[lroom.m_iFirstSOB + n]);
+			aabbs.push_back(LMAN->m_SOB_AABBs[lroom.m_iFirstSOB + n]);
+		}
+
+		lroom.m_iFirstSOB = new_first;
+	}
+	LMAN->m_SOBs.copy_from(sobs);
+	LMAN->m_SOB_AABBs.copy_from(aabbs);
+
+	// PORTALS
+	LVector<LPortal> portals;
+	for (int r=0; r<rooms.size(); r++)
+	{
+		LRoom &lroom = rooms[r];
+		int new_first = portals.size();
+
+		for (int n=0; n<lroom.m_iNumPortals; n++)
+			portals.push_back(LMAN->m_Portals[lroom.m_iFirstPortal + n]);
+
+		lroom.m_iFirstPortal = new_first;
+	}
+	LMAN->m_Portals.copy_from(portals);
+
+	// CASTERS
+	LBakedVector<uint32_t> casters;
+	for (int l=0; l<LMAN->m_Lights.size(); l++)
+	{
+		LLight &light = LMAN->m_Lights[l];
+		int new_first = casters.size();
+
+		for (int n=0; n<light.m_NumCasters; n++)
+			casters.push_back(remap[LMAN->m_LightCasters_SOB[light.m_FirstCaster + n]]);
+
+		light.m_FirstCaster = new_first;
+	}
+
+	LMAN->m_LightCasters_SOB.clear();
+	for (int n=0; n<casters.size(); n++)
+		LMAN->m_LightCasters_SOB.push_back(casters[n]);
+
+	casters.clear();
+	for (int r=0; r<rooms.size(); r++)
+	{
+		LRoom &lroom = rooms[r];
+		int new_first = casters.size();
+
+		for (int n=0; n<lroom.m_iNumShadowCasters_SOB; n++)
+			casters.push_back(remap[LMAN->m_ShadowCasters_SOB[lroom.m_iFirstShadowCaster_SOB + n]]);
+
+		lroom.m_iFirstShadowCaster_SOB = new_first;
+	}
+
+	LMAN->m_ShadowCasters_SOB.clear();
+	for (int n=0; n<casters.size(); n++)
+		LMAN->m_ShadowCasters_SOB.push_back(casters[n]);
+
+	// AREAS
+	LBakedVector<uint32_t> area_rooms;
+	LBakedVector<uint32_t> area_lights;
+	for (int a=0; a<LMAN->m_Areas.size(); a++)
+	{
+		LArea &area = LMAN->m_Areas[a];
+
+		int new_first = area_rooms.size();
+		for (int n=0; n<area.m_iNumRooms; n++)
+			area_rooms.push_back(LMAN->m_AreaRooms[area.m_iFirstRoom + n]);
+		area.m_iFirstRoom = new_first;
+
+		new_first = area_lights.size();
+		for (int n=0; n<area.m_iNumLights; n++)
+			area_lights.push_back(LMAN->m_AreaLights[area.m_iFirstLight + n]);
+		area.m_iFirstLight = new_first;
+	}
+
+	LMAN->m_AreaRooms.clear();
+	for (int n=0; n<area_rooms.size(); n++)
+		LMAN->m_AreaRooms.push_back(area_rooms[n]);
+
+	LMAN->m_AreaLights.clear();
+	for (int n=0; n<area_lights.size(); n++)
+		LMAN->m_AreaLights.push_back(area_lights[n]);
+
+	// the frame lists of SOBs, these are only kept between frames for the master lists
+	LVector<int> * pMasterLists[2] = {&LMAN->m_MasterList_SOBs, &LMAN->m_MasterList_SOBs_prev};
+	for (int l=0; l<2; l++)
+	{
+		LVector<int> &list = *pMasterLists[l];
+		for (int n=0; n<list.size(); n++)
+			list[n] = remap[list[n]];
+	}
+
+	LMAN->m_VisibleList_SOBs.clear();
+	LMAN->m_CasterList_SOBs.clear();
+
+	// recreate the bits from the lists
+	LMAN->CreateBitfields();
+
+	for (int n=0; n<LMAN->m_MasterList_SOBs.size(); n++)
+		LMAN->m_BF_master_SOBs.SetBit(LMAN->m_MasterList_SOBs[n], true);
+
+	for (int n=0; n<LMAN->m_MasterList_SOBs_prev.size(); n++)
+		LMAN->m_BF_master_SOBs_prev.SetBit(LMAN->m_MasterList_SOBs_prev[n], true);
+
+	for (int n=0; n<LMAN->m_ActiveLights.size(); n++)
+		LMAN->m_BF_ActiveLights.SetBit(LMAN->m_ActiveLights[n], true);
+
+	for (int n=0; n<LMAN->m_ActiveLights_prev.size(); n++)
+		LMAN->m_BF_ActiveLights_prev.SetBit(LMAN->m_ActiveLights_prev[n], true);
+
+	for (int n=0; n<LMAN->m_pCurr_VisibleRoomList->size(); n++)
+		LMAN->m_BF_visible_rooms.SetBit((*LMAN->m_pCurr_VisibleRoomList)[n], true);
+
+	// still changed since the last full conversion
+	LMAN->m_Incremental.Reset();
+	LMAN->m_Incremental.m_bChanged = true;
+}
+
+
+///////////////////////////////////////////////////
+
+// helper
+// the path is recorded so that loading baked rooms can delete the same nodes
+void LRoomConverter::Node_Delete(Node * pNode, bool bDetach)
+{
+	NodePath path = LROOMLIST->get_path_to(pNode);
+	LMAN->m_ConvertDeletedNodes.push_back(path);
+
+	if (bDetach)
+		pNode->get_parent()->remove_child(pNode);
+
+	pNode->queue_delete();
+}
 
-// helper
 bool LRoomConverter::Node_IsLight(Node * pNode) const
 {
 	Light * pLight = Object::cast_to<Light>(pNode);
@@ -28,11 +28,16 @@
 #include "scene/3d/spatial.h"
 #include "lvector.h"
 #include "lportal.h"
+#include "ltrace.h"
+#include "lworker_pool.h"
+#include "core/os/thread.h"
+#include "core/hash_map.h"
 
 class LRoomManager;
 class LRoom;
 class LArea;
 class MeshInstance;
+class LPlaneHash;
 
 // simple min max aabb
 class LAABB
@@ -86,8 +91,29 @@ public:
 	// this allows taking advantage of basic LPortal speedup without converting games / demos
 	void Convert(LRoomManager &manager, bool bVerbose, bool bPreparationRun, bool bDeleteLights, bool bSingleRoomMode = false);
 
+	// Time sliced conversion, so the main thread can keep running (e.g. a loading screen).
+	// Call Async_Step once per frame until it returns true. The manager must not be used until then.
+	void Async_Begin(LRoomManager &manager, bool bVerbose, bool bDeleteLights);
+	bool Async_Step(int budget_usecs);
+	// waits for any worker threads, the conversion is left incomplete
+	void Async_Cancel();
+	bool Async_HasFailed() const {return m_Async.m_bFailed;}
+	// 0 to 1
+	float Async_GetProgress() const;
+	String Async_GetStageName() const;
+
+	LRoomConverter();
+	~LRoomConverter();
+
+	// Incremental conversion, patching an already converted manager, so the cost depends on the rooms
+	// changed rather than the whole level. Returns the room ID or -1 on failure.
+	int Incremental_AddRoom(LRoomManager &manager, Spatial * pNode);
+	bool Incremental_RemoveRoom(LRoomManager &manager, int room_id);
+	bool Incremental_RebuildRoom(LRoomManager &manager, int room_id);
+
 private:
 	int CountRooms();
+	void Convert_Prepare(LRoomManager &manager, bool bVerbose, bool bPreparationRun, bool bDeleteLights, bool bSingleRoomMode);
 
 	void Convert_Rooms();
 	int Convert_Rooms_Recursive(Node * pParent, int count, int area);
@@ -97,13 +123,29 @@ private:
 	bool Convert_IsVisibleInRooms(const Node * pNode) const;
 
 	void Convert_Portals();
+	void Convert_Reorder();
+	void Convert_Room_SortSOBs(LRoom &lroom, const LAABB &bb_room);
+	uint32_t Morton_Spread(uint32_t v) const;
+
+	// sort keys for reordering
+	struct LSortItem
+	{
+		uint32_t m_uiKey;
+		int m_iID;
+		bool operator<(const LSortItem &o) const {return (m_uiKey < o.m_uiKey) || ((m_uiKey == o.m_uiKey) && (m_iID < o.m_iID));}
+	};
+
 	void Convert_Bounds();
-	bool Convert_ManualBound(LRoom &lroom, MeshInstance * pMI);
+
+	void Convert_RoomBVH();
+	void Convert_RoomBVH_Benchmark();
 	void GetWorldVertsFromMesh(const MeshInstance &mi, Vector<Vector3> &pts) const;
 	void Bound_FindPoints_Recursive(Node * pNode, Vector<Vector3> &pts);
 	bool Convert_Bound_FromPoints(LRoom &lroom, const Vector<Vector3> &points);
 	void Convert_ShadowCasters();
+	void Convert_ShadowCasters_Light(int l);
 	void Convert_Lights();
+	void Convert_Lights_Gather();
 	void Convert_AreaLights();
 
 
@@ -112,11 +154,10 @@ private:
 	void LRoom_MakePortalFinalList(LRoom &lroom, LTempRoom &troom);
 	void LRoom_DetectedPortalMesh(LRoom &lroom, LTempRoom &troom, MeshInstance * pMeshInstance, String szLinkRoom);
 	LPortal * LRoom_RequestNewPortal(LRoom &lroom);
-	void LRoom_PushBackSOB(LRoom &lroom, const LSob &sob);
+	void LRoom_PushBackSOB(LRoom &lroom, const LSob &sob, const AABB &bb);
 
 	// lights
 	void LRoom_DetectedLight(LRoom &lroom, Node * pNode);
-	void Light_Trace(int iLightID);
 	void LRoom_DetectedArea(LRoom &lroom, Node * pNode);
 
 	// shadows
@@ -126,6 +167,24 @@ private:
 
 
 	void TRoom_MakeOppositePortal(const LPortal &port, int iRoomOrig);
+	void Portal_MakeOpposite(const LPortal &port, int iRoomOrig, LPortal &new_port) const;
+
+	// incremental
+	void Incremental_Begin(LRoomManager &manager);
+	void Incremental_End();
+	int Incremental_ConvertRoom(Spatial * pNode, int slot, bool bRebuild);
+	void Incremental_ReleaseRoom(int room_id, bool bRebuild);
+	void Incremental_RestoreNodes(LRoom &lroom, bool bRestoreLayers);
+	void Incremental_RemoveLight(int light_id);
+	void Incremental_AppendPortals(LRoom &lroom, const LVector<LPortal> &portals);
+	void Incremental_RemovePortalsTo(LRoom &lroom, int linked_room_id);
+	void Incremental_AddRoomToArea(int area_id, int room_id);
+	void Incremental_RemoveRoomFromArea(int area_id, int room_id);
+	void Incremental_AddAreaLight(int light_id, int area_id);
+	void Incremental_MarkLightRooms(int light_id);
+	void Incremental_Relight();
+	void Incremental_Compact();
+	int Incremental_FindArea(Node * pNode);
 
 
 	// helper
@@ -135,9 +194,19 @@ private:
 	bool Node_IsBound(Node * pNode) const;
 	bool Node_IsIgnore(Node * pNode) const;
 	bool Node_IsLight(Node * pNode) const;
+	void Node_Delete(Node * pNode, bool bDetach);
 
-	int FindRoom_ByName(String szName) const;
+	int FindRoom_ByName(String szName);
+	int Area_Find(String szName);
 	int Area_FindOrCreate(String szName);
+	void RoomNames_Build();
+	void AreaNames_Build();
+
+	// name to ID lookups, rebuilt on demand after the rooms or areas change
+	HashMap<String, int> m_RoomsByName;
+	HashMap<String, int> m_AreasByName;
+	bool m_bRoomNamesDirty;
+	bool m_bAreaNamesDirty;
 
 
 	// set up on entry
@@ -146,7 +215,93 @@ private:
 
 	LVector<LTempRoom> m_TempRooms;
 
-	bool Bound_AddPlaneIfUnique(LVector<Plane> &planes, const Plane &p);
+	bool Bound_AddPlaneIfUnique(LBakedVector<Plane> &planes, LPlaneHash &plane_hash, const Plane &p);
+
+	// worker threads
+	// The bound hulls and the light traces are the expensive parts of conversion, and each room / light
+	// can be done independently. Anything touching the scene tree stays on the main thread,
+	// and results are stored in room / light order afterwards so the output does not depend on the threading.
+	struct LBoundJob
+	{
+		Vector<Vector3> m_Pts;
+		bool m_bManual;
+		bool m_bOK;
+		// how far the simplified bound extends outside the hull
+		float m_fError;
+	};
+
+	struct LLightJob
+	{
+		int m_LightID;
+		LVector<int> m_Rooms;
+		LVector<int> m_SOBs;
+	};
+
+	struct LLightWorker
+	{
+		LTrace m_Trace;
+		LTraceScratch m_Scratch;
+	};
+
+	int Worker_GetNumWorkers() const;
+	void Bound_Gather(LRoom &lroom, LBoundJob &job);
+	void Bound_Build(LRoom &lroom, LBoundJob &job);
+	void Bound_Finish(LRoom &lroom, LBoundJob &job);
+	static void Bound_Job(void * pUserData, int item, int worker);
+	static void Light_Job(void * pUserData, int item, int worker);
+	void Light_Trace(LLightJob &job, LLightWorker &worker);
+	void Light_StoreTrace(const LLightJob &job);
+
+	LVector<LBoundJob> m_BoundJobs;
+	LVector<LLightJob> m_LightJobs;
+	LVector<LLightWorker *> m_LightWorkers;
+
+	void Light_TraceJobs();
+	int Light_TraceJobs_Begin();
+	void Light_TraceJobs_End();
+
+	// time sliced conversion
+	enum eAsyncStage
+	{
+		AS_ROOMS,
+		AS_PORTALS,
+		AS_BOUNDS_GATHER,
+		AS_BOUNDS_HULLS,
+		AS_BOUNDS_FINISH,
+		AS_LIGHTS,
+		AS_SHADOW_CASTERS,
+		AS_DONE,
+	};
+
+	struct LAsync
+	{
+		eAsyncStage m_eStage;
+		int m_iItem; // within the stage
+		bool m_bFailed;
+
+		LVector<ObjectID> m_RoomNodes;
+		LVector<int> m_RoomAreas;
+
+		// worker pool running on a background thread
+		Thread * m_pJobThread;
+		volatile bool m_bJobsDone;
+		LWorkerPool::WorkFunc m_pJobFunc;
+		int m_iJobItems;
+		int m_iJobWorkers;
+	} m_Async;
+
+	void Async_GatherRooms_Recursive(Node * pParent, int area);
+	void Async_NextStage(eAsyncStage stage);
+	void Async_Fail(const String &szReason);
+	bool Async_CheckRoom(LRoom &lroom);
+	bool Async_DoItem();
+	void Async_StartJobs(LWorkerPool::WorkFunc pFunc, int num_items, int num_workers);
+	bool Async_JobsFinished();
+	static void Async_JobThread(void * pUserData);
+
+	// incremental, lights to retrace and rooms whose shadow casters need finding again
+	LVector<int> m_Incremental_Lights;
+	LVector<int> m_Incremental_Rooms;
 
 
 	// whether we are preparing the level, or doing a final run,
@@ -154,4 +309,8 @@ private:
 	bool m_bFinalRun;
 	bool m_bDeleteLights;
 	bool m_bSingleRoomMode;
+
+	// converting single rooms into an existing manager
+	bool m_bIncremental;
+	LVector<int> m_Incremental_DOBs;
 };
@@ -20,6 +20,7 @@
 
 #include "lroom_manager.h"
 #include "core/engine.h"
+#include "core/os/os.h"
 #include "scene/3d/camera.h"
 #include "scene/3d/mesh_instance.h"
 #include "lroom_converter.h"
@@ -30,6 +31,7 @@
 #include "lroom.h"
 #include "lhelper.h"
 #include "lscene_saver.h"
+#include "lroom_baker.h"
 #include "ldae_exporter.h"
 
 #define LROOMLIST m_pRoomList
@@ -39,6 +41,14 @@ WARN_PRINT_ONCE("rooms is unset");\
 return false;\
 }
 
+#define CHECK_NOT_CONVERTING_V(r) if (m_pAsyncConverter)\
+{\
+WARN_PRINT_ONCE("rooms_convert_async is still running");\
+return r;\
+}
+
+#define CHECK_NOT_CONVERTING CHECK_NOT_CONVERTING_V(false)
+
 
 LRoomManager::LRoomManager()
 {
@@ -51,6 +61,14 @@ LRoomManager::LRoomManager()
 	m_ID_DebugFrustums = 0;
 
 	m_ID_RoomList = 0;
+	m_pBakedData = 0;
+	m_iConvertThreads = 0;
+	m_iBound_MaxPlanes = 0;
+	m_bConvert_Reorder = false;
+	m_pAsyncConverter = 0;
+	m_iAsyncConvert_BudgetUSecs = 0;
+	m_Incremental.Reset();
+	m_Incremental.m_bDeleteLights = false;
 
 	m_uiFrameCounter = 0;
 	m_iLoggingLevel = 2;
@@ -81,6 +99,19 @@ LRoomManager::LRoomManager()
 	m_fLightmapUnMerge_ThresholdDist = 0.001f;
 	m_fLightmapUnMerge_ThresholdDot = 0.99f;
 
+	// torches flickering etc should not cause retracing
+	dynamic_light_set_retrace_thresholds(0.05f, 1.0f);
+	m_iLightRetrace_BudgetUSecs = 0;
+	m_bLightBakedCasters = true;
+	m_bShadowVolumeCulling = true;
+	m_iLightBudget_Max = 0;
+	m_bLightBudget_ShadowsOnly = false;
+	m_iStats_CasterCandidates = 0;
+	m_iStats_CasterShadowCulled = 0;
+
+	m_iLightAffectedRooms_Unused = 0;
+	m_uiLightMark = 0;
+
 	if (!Engine::get_singleton()->is_editor_hint())
 	{
 		CreateDebug();
@@ -88,6 +119,16 @@ LRoomManager::LRoomManager()
 }
 
 int LRoomManager::FindClosestRoom(const Vector3 &pt) const
+{
+	// the BVH is created during conversion
+	if (m_RoomBVH.IsActive())
+		return m_RoomBVH.FindClosestRoom(m_Rooms, pt);
+
+	return FindClosestRoom_Linear(pt);
+}
+
+// reference version, also used for benchmarking the BVH
+int LRoomManager::FindClosestRoom_Linear(const Vector3 &pt) const
 {
 
 	//print_line("FindClosestRoom");
@@ -101,6 +142,8 @@ int LRoomManager::FindClosestRoom(const Vector3 &pt) const
 	for (int n=0; n<m_Rooms.size(); n++)
 	{
 		const LRoom &lroom = m_Rooms[n];
+		if (lroom.m_bRemoved)
+			continue;
 
 		float d = pt.distance_squared_to(lroom.m_ptCentre);
 
@@ -161,6 +204,58 @@ LRoom * LRoomManager::GetRoom(int i)
 }
 
 
+int LRoomManager::RoomID_ToPublic(int room_id) const
+{
+	if ((unsigned int) room_id >= (unsigned int) m_RoomID_ToPublic.size())
+		return room_id;
+
+	return m_RoomID_ToPublic[room_id];
+}
+
+int LRoomManager::RoomID_FromPublic(int room_id) const
+{
+	// out of range IDs are passed through to fail the usual checks
+	if ((unsigned int) room_id >= (unsigned int) m_RoomID_FromPublic.size())
+		return room_id;
+
+	return m_RoomID_FromPublic[room_id];
+}
+
+void LRoomManager::RoomID_SetRemap(const LVector<int> &to_public)
+{
+	m_RoomID_ToPublic.clear(true);
+	m_RoomID_FromPublic.clear(true);
+
+	bool bIdentity = true;
+	for (int n=0; n<to_public.size(); n++)
+	{
+		if (to_public[n] != n)
+		{
+			bIdentity = false;
+			break;
+		}
+	}
+
+	if (bIdentity)
+		return;
+
+	m_RoomID_ToPublic.copy_from(to_public);
+	m_RoomID_FromPublic.resize(to_public.size());
+	for (int n=0; n<to_public.size(); n++)
+		m_RoomID_FromPublic[to_public[n]] = n;
+}
+
+void LRoomManager::RoomID_Append(int room_id)
+{
+	if (!m_RoomID_ToPublic.size())
+		return;
+
+	assert (room_id == m_RoomID_ToPublic.size());
+	m_RoomID_ToPublic.push_back(room_id);
+	m_RoomID_FromPublic.push_back(room_id);
+}
+
+
 LRoom &LRoomManager::Portal_GetLinkedRoom(const LPortal &port)
 {
 	return m_Rooms[port.m_iRoomNum];
@@ -209,6 +304,7 @@ int LRoomManager::Meta_GetRoomNum(Node * pNode) const
 // register but let LPortal know which room the dob should start in
 bool LRoomManager::dob_register_hint(Node * pDOB, float radius, Node * pRoom)
 {
+	CHECK_NOT_CONVERTING
 	CHECK_ROOM_LIST
 
 	if (!pDOB)
@@ -360,15 +456,31 @@ int LRoomManager::DobRegister(Spatial * pDOB, const Vector3 &pos, float radius,
 	if (iRoom == -1)
 	{
 		WARN_PRINT_ONCE("LRoomManager::DobRegister : room ID is -1");
-		return false;
+		return -1;
 	}
 
 	int did = m_DobList.Request();
+	if (did == -1)
+		return -1;
+
 	LDob &dob = m_DobList.GetDob(did);
 
 	dob.m_iRoomID = iRoom;
 	dob.m_ID_Spatial = pDOB->get_instance_id();
 	dob.m_fRadius = radius;
+	dob.m_ptPos = pos;
+#ifdef LPORTAL_DOBS_NO_SOFTSHOW
+	dob.m_bVisible = true;
+	dob.m_uiLayerMask = LRoom::LAYER_MASK_CAMERA | LRoom::LAYER_MASK_LIGHT;
+#else
+	// layer mask was cleared in DobRegister_FindVIRecursive
+	dob.m_bVisible = false;
+	dob.m_uiLayerMask = 0;
+#endif
+
+	LRoom * pRoom = GetRoom(iRoom);
+	if (pRoom)
+		pRoom->DOB_Add(*this, did);
 
 //	LRoom * pRoom = GetRoom(iRoom);
 //	if (!pRoom)
@@ -381,6 +493,9 @@ int LRoomManager::DobRegister(Spatial * pDOB, const Vector3 &pos, float radius,
 //	dob.m_fRadius = radius;
 
 	dob.m_ID_VI = DobRegister_FindVIRecursive(pDOB);
+	dob.Cache_Invalidate();
+	ObjectCache_Watch(dob.m_ID_Spatial, "_dob_exiting_tree", did);
+	ObjectCache_Watch(dob.m_ID_VI, "_dob_exiting_tree", did);
 
 //	pRoom->DOB_Add(dob);
 
@@ -401,12 +516,18 @@ int LRoomManager::DobRegister(Spatial * pDOB, const Vector3 &pos, float radius,
 	m_DobList.UpdateDob(*this, did, pos);
 //	DobUpdateVisibility(pDOB, pRoom);
 
+	// hide if starting in a room that is not visible, the camera trace will take care of it after this
+	pRoom = GetRoom(dob.m_iRoomID);
+	if (pRoom && !pRoom->IsVisible() && (did != m_DOB_id_camera))
+		m_DobList.ShowDob(did, false, false);
+
 	return did;
 }
 
 
 int LRoomManager::dob_register(Node * pDOB, const Vector3 &pos, float radius)
 {
+	CHECK_NOT_CONVERTING_V(-1)
 	CHECK_ROOM_LIST
 
 	if (!pDOB)
@@ -518,13 +639,19 @@ int LRoomManager::DobUpdate(Spatial * pDOB_Spatial, LRoom * pRoom)
 
 int LRoomManager::dob_update(int dob_id, const Vector3 &pos)
 {
+	CHECK_NOT_CONVERTING_V(-1)
+
 #ifdef LPORTAL_DOBS_AUTO_UPDATE
 	return -1;
 #endif
 
+	if (!m_DobList.IsValid(dob_id))
+	{
+		WARN_PRINT_ONCE("dob_update : invalid or stale dob_id");
+		return -1;
+	}
 
-
-	return m_DobList.UpdateDob(*this, dob_id, pos);
+	return RoomID_ToPublic(m_DobList.UpdateDob(*this, dob_id, pos));
 
 
 
@@ -540,9 +667,60 @@ int LRoomManager::dob_update(int dob_id, const Vector3 &pos)
 //	return DobUpdate(pSpat, pRoom);
 }
 
+PoolIntArray LRoomManager::dob_update_batch(const PoolIntArray &dob_ids, const PoolVector3Array &positions)
+{
+	CHECK_NOT_CONVERTING_V(PoolIntArray())
+
+	PoolIntArray room_ids;
+
+	int num = dob_ids.size();
+	if (positions.size() != num)
+	{
+		WARN_PRINT_ONCE("dob_update_batch : dob_ids and positions must be the same size");
+		return room_ids;
+	}
+
+	room_ids.resize(num);
+	if (!num)
+		return room_ids;
+
+	PoolIntArray::Read ids_read = dob_ids.read();
+	PoolVector3Array::Read positions_read = positions.read();
+	PoolIntArray::Write room_ids_write = room_ids.write();
+
+#ifdef LPORTAL_DOBS_AUTO_UPDATE
+	for (int n=0; n<num; n++)
+		room_ids_write[n] = -1;
+#else
+	m_DobList.UpdateDobs(*this, ids_read.ptr(), positions_read.ptr(), num, room_ids_write.ptr());
+
+	for (int n=0; n<num; n++)
+		room_ids_write[n] = RoomID_ToPublic(room_ids_write[n]);
+#endif
+
+	return room_ids;
+}
+
+void LRoomManager::dob_queue_update(int dob_id, const Vector3 &pos)
+{
+#ifdef LPORTAL_DOBS_AUTO_UPDATE
+	return;
+#endif
+
+	// can't validate the dob here as the list may be being changed on the main thread,
+	// stale IDs are dropped when the queue is drained
+	m_DobQueue.Push(dob_id, pos);
+}
+
+int LRoomManager::dob_get_queued_room_id(int dob_id) const
+{
+	return RoomID_ToPublic(m_DobQueue.GetRoomID(dob_id));
+}
+
 /*
 bool LRoomManager::dob_teleport_hint(Node * pDOB, Node * pRoom)
 {
+	CHECK_NOT_CONVERTING
 	CHECK_ROOM_LIST
 
 	if (!pDOB)
@@ -628,6 +806,7 @@ bool LRoomManager::DobTeleport(Spatial * pDOB, int iNewRoomID)
 /*
 bool LRoomManager::dob_teleport(Node * pDOB)
 {
+	CHECK_NOT_CONVERTING
 	CHECK_ROOM_LIST
 
 	return true;
@@ -651,6 +830,7 @@ bool LRoomManager::dob_teleport(Node * pDOB)
 
 bool LRoomManager::dob_unregister(int dob_id)
 {
+	CHECK_NOT_CONVERTING
 	CHECK_ROOM_LIST
 
 //	LRoom * pRoom = GetRoomFromDOB(pDOB);
@@ -664,27 +844,50 @@ bool LRoomManager::dob_unregister(int dob_id)
 //		return pRoom->DOB_Remove(dob_id);
 //	}
 
+	if (!m_DobList.IsValid(dob_id))
+	{
+		WARN_PRINT_ONCE("dob_unregister : invalid or stale dob_id");
+		return false;
+	}
+
+	// remove from the room, and leave the object showing as it is no longer culled by the system
+	int room_id = m_DobList.GetDob(dob_id).m_iRoomID;
+	if ((unsigned int) room_id < (unsigned int) m_Rooms.size())
+		m_Rooms[room_id].DOB_Remove(*this, dob_id);
+
+	m_DobList.ShowDob(dob_id, true, true);
+
+	const LDob &dob = m_DobList.GetDob(dob_id);
+	ObjectCache_Watch(dob.m_ID_Spatial, "_dob_exiting_tree", dob_id, false);
+	ObjectCache_Watch(dob.m_ID_VI, "_dob_exiting_tree", dob_id, false);
+
 	m_DobList.DeleteDob(dob_id);
 
 	return true;
 }
 
 
+// the casters are found later, in FrameUpdate_LightBudget, so lights over budget are not traced
 void LRoomManager::Light_FrameProcess(int lightID)
 {
 	if (!m_BF_ProcessedLights.GetBit(lightID))
 	{
 		m_BF_ProcessedLights.SetBit(lightID, true);
-
-		// some lights may be processed but found not to intersect the camera frustum
-		if (Light_FindCasters(lightID))
-		{
-			m_BF_ActiveLights.SetBit(lightID, true);
-			m_ActiveLights.push_back(lightID);
-		}
+		m_LightCandidates.push_back(lightID);
 	}
 }
 
+// some lights may be processed but found not to intersect the camera frustum
+bool LRoomManager::Light_Activate(int lightID, bool bFindCasters)
+{
+	if (bFindCasters && !Light_FindCasters(lightID))
+		return false;
+
+	m_BF_ActiveLights.SetBit(lightID, true);
+	m_ActiveLights.push_back(lightID);
+	return true;
+}
+
 // now we are centralizing the tracing out from static and dynamic lights for each frame to this function
 // returns false if the entire light should be culled
 bool LRoomManager::Light_FindCasters(int lightID)
@@ -734,7 +937,12 @@ bool LRoomManager::Light_FindCasters(int lightID)
 		if (!pRoom)
 			return true;
 
-		if (m_Trace.Trace_Light(*this, light, LTrace::LR_ALL) == false)
+		// static lights can use the casters found on conversion, moving lights need a full trace
+		LTrace::eLightRun eRun = LTrace::LR_ALL;
+		if (m_bLightBakedCasters && (light.m_Source.m_eClass == LSource::SC_STATIC))
+			eRun = LTrace::LR_BAKED;
+
+		if (m_Trace.Trace_Light(*this, light, eRun) == false)
 			return false;
 
 	} // non-area light
@@ -878,6 +1086,7 @@ bool LRoomManager::LightCreate(Light * pLight, int roomID, String szArea)
 	}
 
 	m_Lights.push_back(l);
+	ObjectCache_Watch(l.m_GodotID, "_light_exiting_tree", m_Lights.size() - 1);
 
 	return true;
 }
@@ -885,6 +1094,7 @@ bool LRoomManager::LightCreate(Light * pLight, int roomID, String szArea)
 
 int LRoomManager::dynamic_light_register(Node * pLightNode, float radius)
 {
+	CHECK_NOT_CONVERTING_V(-1)
 	CHECK_ROOM_LIST
 	if (!pLightNode)
 	{
@@ -921,173 +1131,488 @@ bool LRoomManager::dynamic_light_unregister(int light_id)
 	return true;
 }
 
-// returns room within or -1 if no dob
-int LRoomManager::dynamic_light_update(int light_id, const Vector3 &pos, const Vector3 &dir) // returns room within
+// appends to the light's span of affected rooms, moving it to the end of the pool if it is full
+void LRoomManager::Light_AddAffectedRoom(LLight &light, int room_id)
 {
-	// doesn't now matter if not in tree as position and dir are passed directly
-	if ((unsigned int) light_id >= (unsigned int) m_Lights.size())
+	if (light.m_NumAffectedRooms == light.m_MaxAffectedRooms)
 	{
-		WARN_PRINT_ONCE("dynamic_light_update : meta light ID out of range");
-		return -1;
-	}
+		// no space left in the span, grow it at the end of the pool
+		int new_max = MAX(light.m_MaxAffectedRooms * 2, 4);
 
-	LLight &light = m_Lights[light_id];
+		if ((light.m_FirstAffectedRoom + light.m_MaxAffectedRooms) == m_LightAffectedRooms.size())
+		{
+			// already at the end, can grow in place
+			m_LightAffectedRooms.resize(light.m_FirstAffectedRoom + new_max);
+		}
+		else
+		{
+			int new_first = m_LightAffectedRooms.size();
+			m_LightAffectedRooms.resize(new_first + new_max);
 
-	int iRoom = light.m_Source.m_RoomID;
-	if (iRoom == -1)
-	{
-		WARN_PRINT_ONCE("dynamic_light_update : can't update global light");
-		return -1;
-	}
+			for (int n=0; n<light.m_NumAffectedRooms; n++)
+				m_LightAffectedRooms[new_first + n] = m_LightAffectedRooms[light.m_FirstAffectedRoom + n];
 
-	light.m_Source.m_ptPos = pos;
-	light.m_Source.m_ptDir = dir.normalized();
+			m_iLightAffectedRooms_Unused += light.m_MaxAffectedRooms;
+			light.m_FirstAffectedRoom = new_first;
+		}
 
-	// update dob
-	if (light.m_DOB_id != -1)
-	{
-		int iNewRoom = m_DobList.UpdateDob(*this, light.m_DOB_id, pos);
-		light.m_Source.m_RoomID = iNewRoom;
+		light.m_MaxAffectedRooms = new_max;
 	}
 
-	// update with a new Trace (we are assuming update is only called if the light has moved)
-	// remove the old local lights
-	for (int n=0; n<light.m_NumAffectedRooms; n++)
-	{
-		int r = light.m_AffectedRooms[n];
-		GetRoom(r)->RemoveLocalLight(light_id);
-	}
-	light.ClearAffectedRooms();
+	m_LightAffectedRooms[light.m_FirstAffectedRoom + light.m_NumAffectedRooms++] = room_id;
 
+	// don't let the pool fill up with gaps
+	if ((m_iLightAffectedRooms_Unused > 256) && (m_iLightAffectedRooms_Unused > (m_LightAffectedRooms.size() / 2)))
+		LightAffectedRooms_Compact();
+}
 
-	// now do a new trace, and add all the rooms that are hit
-	m_Trace.Trace_Light(*this, light, LTrace::LR_ROOMS);
+void LRoomManager::Light_MarkAffectedRooms(const LLight &light)
+{
+	m_uiLightMark++;
 
-	// we should now have a list of the rooms hit in m_LightRender.m_Temp_Visible_Rooms
-	for (int n=0; n<m_LightRender.m_Temp_Visible_Rooms.size(); n++)
-	{
-		int r = m_LightRender.m_Temp_Visible_Rooms[n];
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+		m_Rooms[Light_GetAffectedRoom(light, n)].m_uiLightMark = m_uiLightMark;
+}
 
-		// add to the list on the light
-		light.AddAffectedRoom(r);
+void LRoomManager::LightAffectedRooms_Compact()
+{
+	LVector<int> compacted;
 
-		// add to the list of local lights in the room
-		GetRoom(r)->AddLocalLight(light_id);
+	for (int l=0; l<m_Lights.size(); l++)
+	{
+		LLight &light = m_Lights[l];
+
+		int new_first = compacted.size();
+		for (int n=0; n<light.m_NumAffectedRooms; n++)
+			compacted.push_back(Light_GetAffectedRoom(light, n));
 
+		light.m_FirstAffectedRoom = new_first;
+		light.m_MaxAffectedRooms = light.m_NumAffectedRooms;
 	}
 
-	// this may or may not have changed
-	return light.m_Source.m_RoomID;
+	m_LightAffectedRooms.copy_from(compacted);
+	m_iLightAffectedRooms_Unused = 0;
+}
 
-	/*
-	if (!pLightNode)
+void LRoomManager::LightAffectedRooms_Reset()
+{
+	for (int l=0; l<m_Lights.size(); l++)
 	{
-		WARN_PRINT_ONCE("dynamic_light_update : pLightNode is NULL");
-		return -1;
+		LLight &light = m_Lights[l];
+		light.m_FirstAffectedRoom = 0;
+		light.m_NumAffectedRooms = 0;
+		light.m_MaxAffectedRooms = 0;
 	}
 
-	if (pLightNode->is_inside_tree() == false)
-	{
-#ifdef LDEBUG_LIGHT_AFFECTED_ROOMS
-		if (m_bDebugFrameString)
-			DebugString_Add("DynamicLight not in tree\n");
-#endif
-		return -1;
-	}
+	m_LightAffectedRooms.clear(true);
+	m_iLightAffectedRooms_Unused = 0;
+}
 
-	// find the light ID from meta data
-	int light_id = Meta_GetLightID(pLightNode);
+void LRoomManager::rooms_set_light_baked_casters(bool bActive)
+{
+	m_bLightBakedCasters = bActive;
+}
 
-	if ((unsigned int) light_id >= (unsigned int) m_Lights.size())
+void LRoomManager::rooms_set_shadow_volume_culling(bool bActive)
+{
+	m_bShadowVolumeCulling = bActive;
+}
+
+void LRoomManager::rooms_set_light_budget(int max_lights, bool bShadowsOnly)
+{
+	m_iLightBudget_Max = MAX(max_lights, 0);
+
+	// changing mode, restore any shadows
+	if (bShadowsOnly != m_bLightBudget_ShadowsOnly)
 	{
-		WARN_PRINT_ONCE("dynamic_light_update : meta light ID out of range");
-		return -1;
+		for (int n=0; n<m_Lights.size(); n++)
+			Light_SuppressShadow(m_Lights[n], false);
 	}
 
-	LLight &light = m_Lights[light_id];
+	m_bLightBudget_ShadowsOnly = bShadowsOnly;
+}
 
-	// update the llight transform from the node
-	Light * pGLight = light.GetGodotLight();
-	Light_UpdateTransform(light, *pGLight);
+void LRoomManager::dynamic_light_set_retrace_thresholds(float dist, float angle)
+{
+	m_fLightRetrace_ThresholdDist = MAX(dist, 0.0f);
+	m_fLightRetrace_ThresholdAngle = CLAMP(angle, 0.0f, 45.0f);
+	m_fLightRetrace_ThresholdDot = Math::cos(Math::deg2rad(m_fLightRetrace_ThresholdAngle));
+}
 
-	Spatial * pSpat = Object::cast_to<Spatial>(pGLight);
-	if (!pSpat)
-		return -1;
+void LRoomManager::dynamic_light_set_retrace_budget(int usecs)
+{
+	m_iLightRetrace_BudgetUSecs = MAX(usecs, 0);
 
-	int iRoom = light.m_Source.m_RoomID;
-	if (iRoom == -1)
+	// switching to immediate, flush any backlog
+	if (!m_iLightRetrace_BudgetUSecs)
 	{
-		WARN_PRINT_ONCE("dynamic_light_update : can't update global light");
-		return -1;
+		for (int n=0; n<m_LightRetrace_Pending.size(); n++)
+			DynamicLight_Retrace(m_LightRetrace_Pending[n]);
+
+		m_LightRetrace_Pending.clear();
 	}
+}
 
+int LRoomManager::dynamic_light_get_retrace_backlog() const
+{
+	return m_LightRetrace_Pending.size();
+}
 
-	LRoom * pRoom = GetRoom(iRoom);
-	if (pRoom == 0)
+void LRoomManager::DynamicLight_RequestRetrace(int light_id)
+{
+	LLight &light = m_Lights[light_id];
+
+	// Until the retrace the old affected rooms are kept, which covers most of the light.
+	// The room it is now in and the rooms one portal away are added straight away,
+	// so a light that has moved across a portal doesn't drop out of view meanwhile.
+	int room_id = light.m_Source.m_RoomID;
+	if (room_id != -1)
 	{
-		WARN_PRINT_ONCE("dynamic_light_update : pRoom is NULL");
-		return -1;
+		Light_MarkAffectedRooms(light);
+		DynamicLight_AddPendingRoom(light_id, room_id);
+
+		const LRoom &lroom = m_Rooms[room_id];
+		for (int p=0; p<lroom.m_iNumPortals; p++)
+		{
+			int linked_room_id = m_Portals[lroom.m_iFirstPortal + p].m_iRoomNum;
+			DynamicLight_AddPendingRoom(light_id, linked_room_id);
+		}
 	}
 
-	LRoom * pNewRoom = pRoom->DOB_Update(*this, pSpat);
+	if (light.m_bRetracePending)
+		return;
 
-	if (pNewRoom)
-	{
-		// remove from the list in old room and add to list in new room, and change the metadata
-		int iNewRoomID = pNewRoom->m_RoomID;
-		light.m_Source.m_RoomID = iNewRoomID;
+	light.m_bRetracePending = true;
+	m_LightRetrace_Pending.push_back(light_id);
+}
 
-		// change visibility
-		//DobChangeVisibility(pSpat, pRoom, pNewRoom);
-	}
+// adds a room to a light awaiting retrace, if it is not already affected
+// (the light's rooms must have been marked with Light_MarkAffectedRooms)
+void LRoomManager::DynamicLight_AddPendingRoom(int light_id, int room_id)
+{
+	if (Room_IsLightMarked(room_id))
+		return;
 
+	LRoom &lroom = m_Rooms[room_id];
+	lroom.m_uiLightMark = m_uiLightMark;
 
-	// update with a new Trace (we are assuming update is only called if the light has moved)
-	// remove the old local lights
-	for (int n=0; n<light.m_NumAffectedRooms; n++)
-	{
-		int r = light.m_AffectedRooms[n];
-		GetRoom(r)->RemoveLocalLight(light_id);
-	}
-	light.ClearAffectedRooms();
+	Light_AddAffectedRoom(m_Lights[light_id], room_id);
+	lroom.AddLocalLight(light_id);
+}
 
+void LRoomManager::FrameUpdate_LightRetraces(const Vector3 &ptCam)
+{
+	if (!m_LightRetrace_Pending.size())
+		return;
 
-	// now do a new trace, and add all the rooms that are hit
-	m_Trace.Trace_Light(*this, light, LTrace::LR_ROOMS);
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	int nRetraced = 0;
 
-	// we should now have a list of the rooms hit in m_LightRender.m_Temp_Visible_Rooms
-	for (int n=0; n<m_LightRender.m_Temp_Visible_Rooms.size(); n++)
+	while (m_LightRetrace_Pending.size())
 	{
-		int r = m_LightRender.m_Temp_Visible_Rooms[n];
+		// choose the most important pending light, lights in visible rooms (as of last frame) first,
+		// then the closest to the camera
+		int best = 0;
+		bool best_visible = false;
+		float best_dist = FLT_MAX;
 
-		// add to the list on the light
-		light.AddAffectedRoom(r);
+		for (int n=0; n<m_LightRetrace_Pending.size(); n++)
+		{
+			const LSource &source = m_Lights[m_LightRetrace_Pending[n]].m_Source;
 
-		// add to the list of local lights in the room
-		GetRoom(r)->AddLocalLight(light_id);
+			bool bVisible = false;
+			if (source.m_RoomID != -1)
+			{
+				const LRoom * pRoom = GetRoom(source.m_RoomID);
+				bVisible = pRoom && pRoom->IsVisible();
+			}
+
+			if (best_visible && !bVisible)
+				continue;
+
+			float dist = source.m_ptPos.distance_squared_to(ptCam);
 
+			if ((bVisible && !best_visible) || (dist < best_dist))
+			{
+				best = n;
+				best_visible = bVisible;
+				best_dist = dist;
+			}
+		}
+
+		int light_id = m_LightRetrace_Pending[best];
+		m_LightRetrace_Pending.remove_unsorted(best);
+
+		DynamicLight_Retrace(light_id);
+		nRetraced++;
+
+		// always do at least one per frame, so the backlog can't stall
+		if ((OS::get_singleton()->get_ticks_usec() - start) >= (uint64_t) m_iLightRetrace_BudgetUSecs)
+			break;
 	}
 
-	// this may or may not have changed
-	return light.m_Source.m_RoomID;
-	*/
-	return 0;
+#ifdef LDEBUG_LIGHTS
+	if (m_bDebugFrameString)
+		DebugString_Add("Light retraces " + itos(nRetraced) + ", backlog " + itos(m_LightRetrace_Pending.size()) + "\n");
+#endif
 }
 
-void LRoomManager::DebugString_Light_AffectedRooms(int light_id)
+bool LRoomManager::DynamicLight_NeedsRetrace(const LLight &light) const
 {
-#ifdef LDEBUG_LIGHT_AFFECTED_ROOMS
-	if (m_bDebugFrameString)
-	{
-		const LLight &light = m_Lights[light_id];
-		if (!light.m_bShow)
-			return;
+	if (!light.m_bTraced)
+		return true;
 
-		DebugString_Add("Light " + itos(light_id) + " affect room ");
-		// affected rooms
-		for (int n=0; n<light.m_NumAffectedRooms; n++)
+	const LSource &source = light.m_Source;
+
+	if (source.m_RoomID != light.m_iTracedRoom)
+		return true;
+
+	if (source.m_ptPos.distance_squared_to(light.m_ptTracedPos) > (m_fLightRetrace_ThresholdDist * m_fLightRetrace_ThresholdDist))
+		return true;
+
+	// direction only matters for spotlights
+	if (source.m_eType == LSource::ST_SPOTLIGHT)
+	{
+		if (source.m_ptDir.dot(light.m_ptTracedDir) < m_fLightRetrace_ThresholdDot)
+			return true;
+	}
+
+	return false;
+}
+
+void LRoomManager::DynamicLight_Retrace(int light_id)
+{
+	LLight &light = m_Lights[light_id];
+
+	// Trace with an expanded volume, so that moves within the thresholds are still covered.
+	// For spotlights the cone is always widened by the angle threshold, and the apex pulled back so the cone
+	// encloses all apexes within the distance threshold. If the pulled back apex would leave the room,
+	// the light is instead traced without the cone, as an omni light.
+	// Omni lights are traced from anywhere within the distance threshold, with the range grown to match.
+	LLight expanded = light;
+	LSource &source = expanded.m_Source;
+	float fSourceRadius = 0.0f;
+
+	if (source.m_eType == LSource::ST_SPOTLIGHT)
+	{
+		source.m_fSpread = MIN(source.m_fSpread + m_fLightRetrace_ThresholdAngle, 89.0f);
+
+		if (m_fLightRetrace_ThresholdDist > 0.0f)
 		{
-			int room_id = light.m_AffectedRooms[n];
+			float pull_back = m_fLightRetrace_ThresholdDist / Math::sin(Math::deg2rad(source.m_fSpread));
+
+			Vector3 ptApex = source.m_ptPos - (source.m_ptDir * pull_back);
+
+			const LRoom * pRoom = GetRoom(source.m_RoomID);
+			if (pRoom && pRoom->m_Bound.IsPointWithin(ptApex))
+				source.m_ptPos = ptApex;
+			else
+				source.m_eType = LSource::ST_OMNI;
+		}
+	}
+
+	if ((source.m_eType == LSource::ST_OMNI) && (m_fLightRetrace_ThresholdDist > 0.0f))
+	{
+		fSourceRadius = m_fLightRetrace_ThresholdDist;
+		if (source.m_fRange < FLT_MAX)
+			source.m_fRange += fSourceRadius;
+	}
+
+	m_Trace.Trace_Light(*this, expanded, LTrace::LR_ROOMS, 0, fSourceRadius);
+
+	// the rooms hit are in m_LightRender.m_Temp_Visible_Rooms, and marked in the bitfield.
+	// Only rooms that have left or entered the affected set need changing.
+	const Lawn::LBitField_Dynamic &bf_hit = m_LightRender.m_BF_Temp_Visible_Rooms;
+	const LVector<int> &hit = m_LightRender.m_Temp_Visible_Rooms;
+
+	// remove rooms no longer affected
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+	{
+		int r = Light_GetAffectedRoom(light, n);
+
+		if (!bf_hit.GetBit(r))
+			GetRoom(r)->RemoveLocalLight(light_id);
+	}
+
+	// the old rooms are marked before overwriting
+	Light_MarkAffectedRooms(light);
+	Light_ClearAffectedRooms(light);
+
+	for (int n=0; n<hit.size(); n++)
+	{
+		int r = hit[n];
+		Light_AddAffectedRoom(light, r);
+
+		// add to the list of local lights in the room
+		if (!Room_IsLightMarked(r))
+			GetRoom(r)->AddLocalLight(light_id);
+	}
+
+	light.m_bTraced = true;
+	light.m_bRetracePending = false;
+	light.m_ptTracedPos = light.m_Source.m_ptPos;
+	light.m_ptTracedDir = light.m_Source.m_ptDir;
+	light.m_iTracedRoom = light.m_Source.m_RoomID;
+}
+
+// returns room within or -1 if no dob
+int LRoomManager::dynamic_light_update(int light_id, const Vector3 &pos, const Vector3 &dir) // returns room within
+{
+	CHECK_NOT_CONVERTING_V(-1)
+
+	// doesn't now matter if not in tree as position and dir are passed directly
+	if ((unsigned int) light_id >= (unsigned int) m_Lights.size())
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : meta light ID out of range");
+		return -1;
+	}
+
+	LLight &light = m_Lights[light_id];
+
+	if (light.m_bRemoved)
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : light was removed with its room");
+		return -1;
+	}
+
+	int iRoom = light.m_Source.m_RoomID;
+	if (iRoom == -1)
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : can't update global light");
+		return -1;
+	}
+
+	light.m_Source.m_ptPos = pos;
+	light.m_Source.m_ptDir = dir.normalized();
+
+	// update dob
+	if (light.m_DOB_id != -1)
+	{
+		int iNewRoom = m_DobList.UpdateDob(*this, light.m_DOB_id, pos);
+		light.m_Source.m_RoomID = iNewRoom;
+	}
+
+	// only retrace the affected rooms if the light has moved significantly
+	if (DynamicLight_NeedsRetrace(light))
+	{
+		if (m_iLightRetrace_BudgetUSecs)
+			DynamicLight_RequestRetrace(light_id);
+		else
+			DynamicLight_Retrace(light_id);
+	}
+
+	// this may or may not have changed
+	return RoomID_ToPublic(light.m_Source.m_RoomID);
+
+	/*
+	if (!pLightNode)
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : pLightNode is NULL");
+		return -1;
+	}
+
+	if (pLightNode->is_inside_tree() == false)
+	{
+#ifdef LDEBUG_LIGHT_AFFECTED_ROOMS
+		if (m_bDebugFrameString)
+			DebugString_Add("DynamicLight not in tree\n");
+#endif
+		return -1;
+	}
+
+	// find the light ID from meta data
+	int light_id = Meta_GetLightID(pLightNode);
+
+	if ((unsigned int) light_id >= (unsigned int) m_Lights.size())
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : meta light ID out of range");
+		return -1;
+	}
+
+	LLight &light = m_Lights[light_id];
+
+	// update the llight transform from the node
+	Light * pGLight = light.GetGodotLight();
+	Light_UpdateTransform(light, *pGLight);
+
+	Spatial * pSpat = Object::cast_to<Spatial>(pGLight);
+	if (!pSpat)
+		return -1;
+
+	int iRoom = light.m_Source.m_RoomID;
+	if (iRoom == -1)
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : can't update global light");
+		return -1;
+	}
+
+
+	LRoom * pRoom = GetRoom(iRoom);
+	if (pRoom == 0)
+	{
+		WARN_PRINT_ONCE("dynamic_light_update : pRoom is NULL");
+		return -1;
+	}
+
+	LRoom * pNewRoom = pRoom->DOB_Update(*this, pSpat);
+
+	if (pNewRoom)
+	{
+		// remove from the list in old room and add to list in new room, and change the metadata
+		int iNewRoomID = pNewRoom->m_RoomID;
+		light.m_Source.m_RoomID = iNewRoomID;
+
+		// change visibility
+		//DobChangeVisibility(pSpat, pRoom, pNewRoom);
+	}
+
+
+	// update with a new Trace (we are assuming update is only called if the light has moved)
+	// remove the old local lights
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+	{
+		int r = Light_GetAffectedRoom(light, n);
+		GetRoom(r)->RemoveLocalLight(light_id);
+	}
+	Light_ClearAffectedRooms(light);
+
+
+	// now do a new trace, and add all the rooms that are hit
+	m_Trace.Trace_Light(*this, light, LTrace::LR_ROOMS);
+
+	// we should now have a list of the rooms hit in m_LightRender.m_Temp_Visible_Rooms
+	for (int n=0; n<m_LightRender.m_Temp_Visible_Rooms.size(); n++)
+	{
+		int r = m_LightRender.m_Temp_Visible_Rooms[n];
+
+		// add to the list on the light
+		Light_AddAffectedRoom(light, r);
+
+		// add to the list of local lights in the room
+		GetRoom(r)->AddLocalLight(light_id);
+
+	}
+
+	// this may or may not have changed
+	return light.m_Source.m_RoomID;
+	*/
+	return 0;
+}
+
+void LRoomManager::DebugString_Light_AffectedRooms(int light_id)
+{
+#ifdef LDEBUG_LIGHT_AFFECTED_ROOMS
+	if (m_bDebugFrameString)
+	{
+		const LLight &light = m_Lights[light_id];
+		if (!light.m_bShow)
+			return;
+
+		DebugString_Add("Light " + itos(light_id) + " affect room ");
+		// affected rooms
+		for (int n=0; n<light.m_NumAffectedRooms; n++)
+		{
+			int room_id = Light_GetAffectedRoom(light, n);
 			DebugString_Add(itos(room_id) + ", ");
 		}
 		DebugString_Add("\n");
@@ -1098,6 +1623,7 @@ void LRoomManager::DebugString_Light_AffectedRooms(int light_id)
 
 bool LRoomManager::global_light_register(Node * pLightNode, String szArea)
 {
+	CHECK_NOT_CONVERTING
 	//CHECK_ROOM_LIST
 
 	if (!pLightNode)
@@ -1157,7 +1683,15 @@ void LRoomManager::DobUpdateVisibility(int dob_id)
 
 int LRoomManager::dob_get_room_id(int dob_id)
 {
-	return m_DobList.GetDob(dob_id).m_iRoomID;
+	CHECK_NOT_CONVERTING_V(-1)
+
+	if (!m_DobList.IsValid(dob_id))
+	{
+		WARN_PRINT_ONCE("dob_get_room_id : invalid or stale dob_id");
+		return -1;
+	}
+
+	return RoomID_ToPublic(m_DobList.GetDob(dob_id).m_iRoomID);
 }
 
 // helpers to enable the client to manage switching on and off physics and AI
@@ -1168,7 +1702,9 @@ int LRoomManager::rooms_get_num_rooms() const
 
 Vector3 LRoomManager::rooms_get_room_centre(int room_id) const
 {
-	const LRoom * pRoom = GetRoom(room_id);
+	CHECK_NOT_CONVERTING_V(Vector3(0, 0, 0))
+
+	const LRoom * pRoom = GetRoom(RoomID_FromPublic(room_id));
 
 	if (!pRoom)
 		return Vector3(0, 0, 0);
@@ -1179,6 +1715,10 @@ Vector3 LRoomManager::rooms_get_room_centre(int room_id) const
 
 bool LRoomManager::rooms_is_room_visible(int room_id) const
 {
+	CHECK_NOT_CONVERTING
+
+	room_id = RoomID_FromPublic(room_id);
+
 	if (room_id >= m_Rooms.size())
 	{
 		LWARN(5, "LRoomManager::rooms_is_room_visible : room id higher than number of rooms");
@@ -1190,19 +1730,53 @@ bool LRoomManager::rooms_is_room_visible(int room_id) const
 
 Array LRoomManager::rooms_get_visible_rooms() const
 {
+	CHECK_NOT_CONVERTING_V(Array())
+
 	Array rooms;
 	for (int n=0; n<m_pCurr_VisibleRoomList->size(); n++)
 	{
-		rooms.push_back((*m_pCurr_VisibleRoomList)[n]);
+		rooms.push_back(RoomID_ToPublic((*m_pCurr_VisibleRoomList)[n]));
 	}
 
 	return rooms;
 }
 
 
+void LRoomManager::rooms_set_streaming(bool bActive, int load_portals, int unload_portals)
+{
+	m_Streamer.SetActive(*this, bActive, load_portals, unload_portals);
+}
+
+void LRoomManager::rooms_set_streaming_budget(int megabytes)
+{
+	m_Streamer.SetBudget((uint64_t) MAX(megabytes, 0) * 1024 * 1024);
+}
+
+bool LRoomManager::rooms_is_room_resident(int room_id) const
+{
+	CHECK_NOT_CONVERTING
+
+	room_id = RoomID_FromPublic(room_id);
+
+	if ((unsigned int) room_id >= (unsigned int) m_Rooms.size())
+	{
+		LWARN(5, "LRoomManager::rooms_is_room_resident : room id higher than number of rooms");
+		return false;
+	}
+
+	return m_Streamer.IsResident(room_id);
+}
+
+Dictionary LRoomManager::rooms_get_streaming_stats() const
+{
+	return m_Streamer.GetStats();
+}
+
 Node * LRoomManager::rooms_get_room(int room_id)
 {
-	const LRoom * pRoom = GetRoom(room_id);
+	CHECK_NOT_CONVERTING_V(NULL)
+
+	const LRoom * pRoom = GetRoom(RoomID_FromPublic(room_id));
 
 	if (!pRoom)
 		return NULL;
@@ -1245,6 +1819,11 @@ void LRoomManager::rooms_set_active(bool bActive)
 
 	m_bActive = bActive;
 
+	// nothing is streamed while culling is off, so everything must be shown loaded.
+	// Streaming resumes from scratch when reactivated.
+	if (!m_bActive)
+		m_Streamer.MakeAllResident(*this);
+
 //	if (m_bActive)
 //	{
 		// clear these to ensure the system is initialized
@@ -1257,6 +1836,14 @@ void LRoomManager::rooms_set_active(bool bActive)
 	{
 		LRoom &lroom = m_Rooms[n];
 		lroom.Debug_ShowAll(bActive);
+
+		// DOBS
+		// when reactivating, the camera trace will cull them again
+		if (!bActive)
+		{
+			for (int d=0; d<lroom.m_DOBs.size(); d++)
+				m_DobList.ShowDob(lroom.m_DOBs[d], true, true);
+		}
 	}
 
 
@@ -1323,8 +1910,15 @@ void LRoomManager::rooms_log_frame()
 
 bool LRoomManager::rooms_set_camera(int dob_id, Node * pCam)
 {
+	CHECK_NOT_CONVERTING
 	CHECK_ROOM_LIST
 
+	if (!m_DobList.IsValid(dob_id))
+	{
+		WARN_PRINT("rooms_set_camera : invalid dob_id, register the camera as a dob first");
+		return false;
+	}
+
 	// is it the first setting of the camera? if so hide all
 	if (m_DOB_id_camera == -1)
 		ShowAll(false);
@@ -1367,11 +1961,16 @@ bool LRoomManager::rooms_set_camera(int dob_id, Node * pCam)
 // convert empties and meshes to rooms and portals
 bool LRoomManager::RoomsConvert(bool bVerbose, bool bDeleteLights, bool bSingleRoomMode)
 {
+	AsyncConvert_Cancel();
+
 	ResolveRoomListPath();
 	CHECK_ROOM_LIST
 
 	LRoomConverter conv;
 	conv.Convert(*this, bVerbose, false, bDeleteLights, bSingleRoomMode);
+
+	// used when adding rooms incrementally
+	m_Incremental.m_bDeleteLights = bDeleteLights;
 	return true;
 }
 
@@ -1380,6 +1979,81 @@ bool LRoomManager::rooms_single_room_convert(bool bVerbose, bool bDeleteLights)
 	return RoomsConvert(bVerbose, bDeleteLights, true);
 }
 
+bool LRoomManager::rooms_convert_async(bool bVerbose, bool bDeleteLights, int budget_usecs)
+{
+	AsyncConvert_Cancel();
+
+	ResolveRoomListPath();
+	CHECK_ROOM_LIST
+
+	m_iAsyncConvert_BudgetUSecs = MAX(budget_usecs, 1);
+
+	m_pAsyncConverter = memnew(LRoomConverter);
+	m_pAsyncConverter->Async_Begin(*this, bVerbose, bDeleteLights);
+
+	// used when adding rooms incrementally
+	m_Incremental.m_bDeleteLights = bDeleteLights;
+	return true;
+}
+
+void LRoomManager::FrameUpdate_AsyncConvert()
+{
+	bool bDone = m_pAsyncConverter->Async_Step(m_iAsyncConvert_BudgetUSecs);
+
+	if (!bDone)
+	{
+		emit_signal("convert_progress", m_pAsyncConverter->Async_GetProgress(), m_pAsyncConverter->Async_GetStageName());
+		return;
+	}
+
+	bool bOK = !m_pAsyncConverter->Async_HasFailed();
+	memdelete(m_pAsyncConverter);
+	m_pAsyncConverter = 0;
+
+	// a partial conversion is no use
+	if (bOK)
+		emit_signal("convert_progress", 1.0f, "done");
+	else
+		ReleaseResources(true);
+
+	emit_signal("convert_finished", bOK);
+}
+
+void LRoomManager::AsyncConvert_Cancel()
+{
+	if (!m_pAsyncConverter)
+		return;
+
+	LPRINT(5, "rooms_convert_async cancelled");
+
+	// waits for the worker threads
+	memdelete(m_pAsyncConverter);
+	m_pAsyncConverter = 0;
+}
+
+bool LRoomManager::rooms_save_baked(String szFilename)
+{
+	CHECK_ROOM_LIST
+	CHECK_NOT_CONVERTING
+
+	// the sobs are saved by node path, so any streamed out must be instanced again
+	m_Streamer.MakeAllResident(*this);
+
+	LRoomBaker baker;
+	return baker.Save(*this, szFilename);
+}
+
+bool LRoomManager::rooms_load_baked(String szFilename)
+{
+	AsyncConvert_Cancel();
+
+	ResolveRoomListPath();
+	CHECK_ROOM_LIST
+
+	LRoomBaker baker;
+	return baker.Load(*this, szFilename);
+}
+
 
 void LRoomManager::rooms_set_hide_method_detach(bool bDetach)
 {
@@ -1392,6 +2066,97 @@ void LRoomManager::rooms_set_portal_plane_convention(bool bFlip)
 	m_bPortalPlane_Convention = bFlip;
 }
 
+void LRoomManager::rooms_set_convert_threads(int num_threads)
+{
+	m_iConvertThreads = MAX(num_threads, 0);
+}
+
+void LRoomManager::rooms_set_convert_reorder(bool bActive)
+{
+	m_bConvert_Reorder = bActive;
+}
+
+void LRoomManager::rooms_set_bound_max_planes(int max_planes)
+{
+	if (max_planes > LBound::SIMPLIFY_MAX_PLANES)
+	{
+		WARN_PRINT("rooms_set_bound_max_planes : max_planes above " + itos(LBound::SIMPLIFY_MAX_PLANES) + ", clamping");
+		max_planes = LBound::SIMPLIFY_MAX_PLANES;
+	}
+
+	if (max_planes > 0)
+		max_planes = MAX(max_planes, 6);
+
+	m_iBound_MaxPlanes = MAX(max_planes, 0);
+}
+
+int LRoomManager::rooms_add_room(Node * pRoomNode)
+{
+	if (!CheckRoomList())
+	{
+		WARN_PRINT_ONCE("rooms is unset");
+		return -1;
+	}
+
+	if (m_pAsyncConverter)
+	{
+		WARN_PRINT_ONCE("rooms_convert_async is still running");
+		return -1;
+	}
+
+	Spatial * pSpat = Object::cast_to<Spatial>(pRoomNode);
+	if (!pSpat)
+	{
+		WARN_PRINT_ONCE("rooms_add_room : not a spatial");
+		return -1;
+	}
+
+	// new portals change the distances for streaming
+	m_Streamer.SetDirty();
+
+	LRoomConverter conv;
+	return RoomID_ToPublic(conv.Incremental_AddRoom(*this, pSpat));
+}
+
+bool LRoomManager::rooms_remove_room(int room_id)
+{
+	CHECK_ROOM_LIST
+	CHECK_NOT_CONVERTING
+
+	room_id = RoomID_FromPublic(room_id);
+
+	// the room content must be loaded to restore it
+	m_Streamer.MakeResident(*this, room_id);
+
+	LRoomConverter conv;
+	return conv.Incremental_RemoveRoom(*this, room_id);
+}
+
+bool LRoomManager::rooms_rebuild_room(int room_id)
+{
+	CHECK_ROOM_LIST
+	CHECK_NOT_CONVERTING
+
+	room_id = RoomID_FromPublic(room_id);
+
+	// the meshes are needed for the bound
+	m_Streamer.MakeResident(*this, room_id);
+
+	LRoomConverter conv;
+	return conv.Incremental_RebuildRoom(*this, room_id);
+}
+
+void LRoomManager::LIncremental::Reset()
+{
+	m_iUnused_Portals = 0;
+	m_iUnused_SOBs = 0;
+	m_iUnused_LightCasters = 0;
+	m_iUnused_ShadowCasters = 0;
+	m_iUnused_AreaRooms = 0;
+	m_iUnused_AreaLights = 0;
+	m_bChanged = false;
+}
+
 // convert empties and meshes to rooms and portals
 bool LRoomManager::rooms_convert(bool bVerbose, bool bDeleteLights)
 {
@@ -1420,6 +2185,7 @@ bool LRoomManager::rooms_save_scene(Node * pNode, String szFilename)
 // free memory for current set of rooms, prepare for converting a new game level
 void LRoomManager::rooms_release()
 {
+	AsyncConvert_Cancel();
 	CheckRoomList();
 
 	// unhide all the objects and reattach to scene graph
@@ -1454,19 +2220,52 @@ void LRoomManager::rooms_release()
 
 void LRoomManager::ReleaseResources(bool bPrepareConvert)
 {
+	// converting needs all the meshes, and when releasing the level may be kept and used without lportal
+	m_Streamer.MakeAllResident(*this);
+	m_Streamer.Reset();
+
+	// any cached godot pointers may now be stale
+	ObjectCache_InvalidateAll();
+
 	m_ShadowCasters_SOB.clear();
 	m_LightCasters_SOB.clear();
 	m_Rooms.clear(true);
+	m_RoomID_ToPublic.clear(true);
+	m_RoomID_FromPublic.clear(true);
 	m_Portals.clear(true);
 	m_Areas.clear(true);
+	m_RoomBVH.Clear();
 	m_SOBs.clear();
+	m_SOB_AABBs.clear();
 
 	m_AreaLights.clear(true);
 	m_AreaRooms.clear(true);
+	m_ConvertDeletedNodes.clear(true);
+	m_DetachedPortals.clear(true);
+	m_DetachedBounds.clear(true);
+	m_Incremental.Reset();
+
+	// the lists above may have been pointing into it
+	if (m_pBakedData)
+	{
+		m_pBakedData->Release();
+		m_pBakedData = 0;
+	}
 
 	if (!bPrepareConvert)
 		m_Lights.clear();
 
+	// affected rooms are recreated on conversion
+	LightAffectedRooms_Reset();
+
+	for (int n=0; n<m_LightRetrace_Pending.size(); n++)
+	{
+		int light_id = m_LightRetrace_Pending[n];
+		if (light_id < m_Lights.size())
+			m_Lights[light_id].m_bRetracePending = false;
+	}
+	m_LightRetrace_Pending.clear();
+
 	m_ActiveLights.clear();
 	m_ActiveLights_prev.clear();
 
@@ -1480,6 +2279,129 @@ void LRoomManager::ReleaseResources(bool bPrepareConvert)
 	m_CasterList_SOBs.clear();
 }
 
+void LRoomManager::ObjectCache_InvalidateAll()
+{
+	for (int n=0; n<m_Rooms.size(); n++)
+		m_Rooms[n].Cache_Invalidate();
+
+	for (int n=0; n<m_SOBs.size(); n++)
+		m_SOBs[n].Cache_Invalidate();
+
+	for (int n=0; n<m_Lights.size(); n++)
+		m_Lights[n].Cache_Invalidate();
+
+	for (int n=0; n<m_DobList.GetNumSlots(); n++)
+	{
+		int dob_id = m_DobList.GetSlotHandle(n);
+		if (dob_id != -1)
+			m_DobList.GetDob(dob_id).Cache_Invalidate();
+	}
+}
+
+// a node can only be connected once to each method, so watching again replaces the old slot
+void LRoomManager::ObjectCache_Watch(ObjectID id, const StringName &method, int slot, bool bWatch)
+{
+	Node * pNode = Object::cast_to<Node>(ObjectDB::get_instance(id));
+	if (!pNode)
+		return;
+
+	if (pNode->is_connected("tree_exiting", this, method))
+		pNode->disconnect("tree_exiting", this, method);
+
+	if (bWatch)
+		pNode->connect("tree_exiting", this, method, varray(slot));
+}
+
+void LRoomManager::ObjectCache_WatchAll()
+{
+	for (int n=0; n<m_Rooms.size(); n++)
+	{
+		if (!m_Rooms[n].m_bRemoved)
+			ObjectCache_Watch(m_Rooms[n].m_GodotID, "_room_exiting_tree", n);
+	}
+
+	for (int n=0; n<m_SOBs.size(); n++)
+		ObjectCache_Watch(m_SOBs[n].m_ID, "_sob_exiting_tree", n);
+
+	for (int n=0; n<m_Lights.size(); n++)
+	{
+		if (!m_Lights[n].m_bRemoved)
+			ObjectCache_Watch(m_Lights[n].m_GodotID, "_light_exiting_tree", n);
+	}
+}
+
+// The handlers may be called for a slot that has since been reused or removed,
+// in which case invalidating is harmless, the pointer is looked up again on next use.
+void LRoomManager::_room_exiting_tree(int room_id)
+{
+	if (LHidable::m_bDetaching)
+		return;
+
+	if ((unsigned int) room_id < (unsigned int) m_Rooms.size())
+		m_Rooms[room_id].Cache_Invalidate();
+}
+
+void LRoomManager::_sob_exiting_tree(int sob_id)
+{
+	// culling by detaching keeps the node
+	if (LHidable::m_bDetaching)
+		return;
+
+	if ((unsigned int) sob_id < (unsigned int) m_SOBs.size())
+		m_SOBs[sob_id].Cache_Invalidate();
+}
+
+void LRoomManager::_dob_exiting_tree(int dob_id)
+{
+	if (LHidable::m_bDetaching)
+		return;
+
+	if (m_DobList.IsValid(dob_id))
+		m_DobList.GetDob(dob_id).Cache_Invalidate();
+}
+
+void LRoomManager::_light_exiting_tree(int light_id)
+{
+	if (LHidable::m_bDetaching)
+		return;
+
+	if ((unsigned int) light_id < (unsigned int) m_Lights.size())
+		m_Lights[light_id].Cache_Invalidate();
+}
+
+void LRoomManager::CreateBitfields(bool bPreserve)
+{
+	// the visible and active bits carry over between frames, so must be kept when resizing between frames
+	int num_rooms = m_Rooms.size();
+	int num_sobs = m_SOBs.size();
+	int num_lights = m_Lights.size();
+
+	if (bPreserve)
+	{
+		m_BF_visible_rooms.Resize(num_rooms);
+		m_BF_master_SOBs.Resize(num_sobs);
+		m_BF_master_SOBs_prev.Resize(num_sobs);
+		m_BF_ActiveLights.Resize(num_lights);
+		m_BF_ActiveLights_prev.Resize(num_lights);
+	}
+	else
+	{
+		m_BF_visible_rooms.Create(num_rooms);
+		m_BF_master_SOBs.Create(num_sobs);
+		m_BF_master_SOBs_prev.Create(num_sobs);
+		m_BF_ActiveLights.Create(num_lights);
+		m_BF_ActiveLights_prev.Create(num_lights);
+	}
+
+	// these are blanked before each use
+	m_LightRender.m_BF_Temp_Visible_Rooms.Create(num_rooms);
+
+	m_BF_caster_SOBs.Create(num_sobs);
+	m_BF_visible_SOBs.Create(num_sobs);
+	m_LightRender.m_BF_Temp_SOBs.Create(num_sobs);
+
+	m_BF_ProcessedLights.Create(num_lights);
+}
 
 // debugging emulate view frustum
 void LRoomManager::FrameUpdate_FrustumOnly()
@@ -1512,6 +2434,8 @@ void LRoomManager::FrameUpdate_Prepare()
 	m_CasterList_SOBs.clear();
 	m_MasterList_SOBs.clear();
 
+	m_VisibleList_DOBs.clear();
+
 	m_BF_caster_SOBs.Blank();
 	m_BF_visible_SOBs.Blank();
 
@@ -1521,6 +2445,10 @@ void LRoomManager::FrameUpdate_Prepare()
 	m_ActiveLights.clear();
 	m_BF_ActiveLights.Blank();
 	m_BF_ProcessedLights.Blank();
+	m_LightCandidates.clear();
+
+	m_iStats_CasterCandidates = 0;
+	m_iStats_CasterShadowCulled = 0;
 
 	// as we hit visible rooms we will mark them in a bitset, so we can hide any rooms
 	// that are showing that haven't been hit this frame
@@ -1540,6 +2468,18 @@ bool LRoomManager::FrameUpdate()
 
 	DebugString_Set("");
 
+	// queued dob updates can only be applied when the rooms can be searched, otherwise they are
+	// collapsed to the latest for each dob, so the queue can't grow while culling is off
+	bool bRoomsReady = (m_pAsyncConverter == 0) && m_bActive && CheckRoomList();
+	m_DobQueue.Drain(*this, bRoomsReady);
+
+	// time sliced conversion in progress, the rooms aren't ready yet
+	if (m_pAsyncConverter)
+	{
+		FrameUpdate_AsyncConvert();
+		return false;
+	}
+
 	// could turn off internal processing? not that important
 	if (!m_bActive)
 		return false;
@@ -1573,6 +2513,10 @@ bool LRoomManager::FrameUpdate()
 		return false;
 	}
 
+	// camera dob unregistered?
+	if (!m_DobList.IsValid(m_DOB_id_camera))
+		return false;
+
 	LDob &dob = m_DobList.GetDob(m_DOB_id_camera);
 	pCamera = Object::cast_to<Camera>(dob.GetSpatial());
 
@@ -1588,6 +2532,9 @@ bool LRoomManager::FrameUpdate()
 	// a portal plane, causing a flicker on changing room...
 	dob_update(m_DOB_id_camera, pCamera->get_global_transform().origin);
 
+	// any deferred dynamic light retraces, under the time budget
+	FrameUpdate_LightRetraces(dob.m_ptPos);
+
 	//dob_update(pCamera);
 
 
@@ -1605,6 +2552,9 @@ bool LRoomManager::FrameUpdate()
 		DebugString_Add("Camera in room " + itos(pRoom->m_RoomID) + "\n");
 #endif
 
+	// load and unload rooms by their distance from the camera room
+	m_Streamer.Update(*this, pRoom->m_RoomID);
+
 
 	// lcamera contains the info needed for running the recursive trace using the main camera
 	LSource cam; cam.Source_SetDefaults();
@@ -1621,6 +2571,11 @@ bool LRoomManager::FrameUpdate()
 	if (!m_MainCamera.Prepare(*this, pCamera))
 		return false;
 
+	// the dob caster lists are only rotated on frames that reach the trace, so an early out
+	// can't lose track of dobs that were shown as casters on the last complete frame
+	m_CasterList_DOBs_prev.copy_from(m_CasterList_DOBs);
+	m_CasterList_DOBs.clear();
+
 	// the first set of planes are allocated and filled with the view frustum planes
 	// Note that the visual server doesn't actually need to do view frustum culling as a result...
 	// (but is still doing it for now)
@@ -1635,7 +2590,7 @@ bool LRoomManager::FrameUpdate()
 
 	// the whole visibility algorithm is recursive, spreading out from the camera room,
 	// rendering through any portals in view into other rooms, etc etc
-	m_Trace.Trace_Prepare(*this, cam, m_BF_visible_SOBs, m_BF_visible_rooms, m_VisibleList_SOBs, *m_pCurr_VisibleRoomList);
+	m_Trace.Trace_Prepare(*this, cam, m_BF_visible_SOBs, m_BF_visible_rooms, m_VisibleList_SOBs, *m_pCurr_VisibleRoomList, &m_VisibleList_DOBs);
 	m_Trace.Trace_Begin(*pRoom, planes);
 
 	// we no longer need these planes
@@ -1644,13 +2599,20 @@ bool LRoomManager::FrameUpdate()
 	// finally hide all the rooms that are currently visible but not in the visible bitfield as having been hit
 	FrameUpdate_FinalizeRooms();
 
+	// the lights in the visible rooms
 	FrameUpdate_AddShadowCasters();
 
+	// limit the number of active lights, and find the shadow casters of those left
+	FrameUpdate_LightBudget(cam.m_ptPos);
+
 	FrameUpdate_CreateMasterList();
 
 	// set soft visibility of objects within visible rooms
 	FrameUpdate_FinalizeVisibility_WithinRooms();
 
+	// dobs outside the visible rooms casting shadows into view
+	FrameUpdate_FinalizeVisibility_DOBCasters();
+
 	FrameUpdate_FinalizeVisibility_SoftShow();
 
 	// swap the current and previous visible room list
@@ -1681,6 +2643,7 @@ void LRoomManager::FrameUpdate_FinalizeRooms()
 			if (!m_BF_visible_rooms.GetBit(n))
 			{
 				m_Rooms[n].Room_MakeVisible(false);
+				m_Rooms[n].DOBs_Hide(*this);
 			}
 		}
 	}
@@ -1692,7 +2655,10 @@ void LRoomManager::FrameUpdate_FinalizeRooms()
 			int r = (*m_pPrev_VisibleRoomList)[n];
 
 			if (!m_BF_visible_rooms.GetBit(r))
+			{
 				m_Rooms[r].Room_MakeVisible(false);
+				m_Rooms[r].DOBs_Hide(*this);
+			}
 		}
 
 	}
@@ -1724,23 +2690,163 @@ void LRoomManager::FrameUpdate_CreateMasterList()
 }
 
 
-void LRoomManager::FrameUpdate_AddShadowCasters()
+// rough estimate of how much the light contributes to the view
+float LRoomManager::Light_CalculateImportance(const LLight &light, const Vector3 &ptCam) const
 {
-	// simple for the moment, add all objects in visible rooms as casters if they are not already visible
-	for (int n=0; n<m_pCurr_VisibleRoomList->size(); n++)
+	const LSource &source = light.m_Source;
+
+	// estimated screen coverage, from the range and distance
+	float coverage = 1.0f;
+	float dist = source.m_ptPos.distance_to(ptCam);
+	if (dist > source.m_fRange)
 	{
-		int r = (*m_pCurr_VisibleRoomList)[n];
-		m_Rooms[r].AddShadowCasters(*this);
+		float f = source.m_fRange / dist;
+		coverage = f * f;
+	}
+
+	float energy = 1.0f;
+	const Light * pLight = light.GetGodotLight();
+	if (pLight)
+		energy = pLight->get_param(Light::PARAM_ENERGY);
+
+	// lights seen through more portals are likely to be less important,
+	// and lights in rooms that aren't visible only contribute shadows
+	int depth = 9;
+	const LRoom * pRoom = (source.m_RoomID != -1) ? GetRoom(source.m_RoomID) : 0;
+	if (pRoom && (pRoom->m_uiFrameTouched == m_uiFrameCounter))
+		depth = pRoom->m_iFrameDepth;
+
+	float importance = (coverage * energy) / (1 + depth);
+
+	// hysteresis, favour lights already shown to prevent flicker
+	if (light.m_bWithinBudget)
+		importance *= 1.25f;
+
+	return importance;
+}
+
+void LRoomManager::Light_SuppressShadow(LLight &light, bool bSuppress)
+{
+	if (light.m_bShadowSuppressed == bSuppress)
+		return;
+
+	Light * pLight = light.GetGodotLight();
+	if (!pLight)
+		return;
+
+	if (bSuppress)
+	{
+		// don't touch lights that have no shadow to begin with
+		if (!pLight->has_shadow())
+			return;
+		pLight->set_shadow(false);
+	}
+	else
+		pLight->set_shadow(true);
+
+	light.m_bShadowSuppressed = bSuppress;
+}
+
+// Activates the lights in the visible rooms and finds their shadow casters. The budget is applied first,
+// so lights over budget don't pay for a caster trace.
+void LRoomManager::FrameUpdate_LightBudget(const Vector3 &ptCam)
+{
+	// sort the local lights by importance, global lights are not included
+	LVector<LLightScore> &scores = m_LightBudget_Scores;
+	scores.clear();
+
+	for (int n=0; n<m_LightCandidates.size(); n++)
+	{
+		int lid = m_LightCandidates[n];
+		const LLight &light = m_Lights[lid];
+		if (light.m_Source.IsGlobal())
+		{
+			Light_Activate(lid, true);
+			continue;
+		}
+
+		LLightScore s;
+		s.m_LightID = lid;
+		s.m_fImportance = Light_CalculateImportance(light, ptCam);
+
+		// insertion sort, most important first (there are usually only a few active lights)
+		int i = scores.size();
+		scores.push_back(s);
+		while ((i > 0) && (scores[i-1].m_fImportance < s.m_fImportance))
+		{
+			scores[i] = scores[i-1];
+			i--;
+		}
+		scores[i] = s;
+	}
+
+	int budget = m_iLightBudget_Max;
+	if (!budget)
+		budget = scores.size();
+
+	int nWithin = 0;
+	int nOver = 0;
+
+	for (int n=0; n<scores.size(); n++)
+	{
+		int lid = scores[n].m_LightID;
+		LLight &light = m_Lights[lid];
+
+		if (nWithin < budget)
+		{
+			// lights that turn out not to be in view don't use up the budget
+			if (!Light_Activate(lid, true))
+				continue;
+
+			nWithin++;
+			light.m_bWithinBudget = true;
+			Light_SuppressShadow(light, false);
+			continue;
+		}
+
+		light.m_bWithinBudget = false;
+		nOver++;
+
+		// still lit, but with no shadow there is no need for the casters
+		if (m_bLightBudget_ShadowsOnly)
+		{
+			Light_SuppressShadow(light, true);
+			Light_Activate(lid, false);
+		}
+	}
+
+	// lights no longer active lose their hysteresis
+	for (int n=0; n<m_ActiveLights_prev.size(); n++)
+	{
+		int lid = m_ActiveLights_prev[n];
+		if (!m_BF_ActiveLights.GetBit(lid))
+			m_Lights[lid].m_bWithinBudget = false;
 	}
 
 #ifdef LDEBUG_LIGHTS
 	if (m_bDebugFrameString)
+	{
+		if (m_iLightBudget_Max)
+			DebugString_Add("Light budget " + itos(m_iLightBudget_Max) + ", over budget " + itos(nOver) + "\n");
+
 		DebugString_Add("TOTAL shadow casters " + itos(m_CasterList_SOBs.size()) + "\n");
+		DebugString_Add("Shadow volume culling : casters before " + itos(m_iStats_CasterCandidates) + ", after " + itos(m_iStats_CasterCandidates - m_iStats_CasterShadowCulled) + "\n");
+	}
 #endif
 
 	LPRINT_RUN(2, "TOTAL shadow casters " + itos(m_CasterList_SOBs.size()));
 }
 
+void LRoomManager::FrameUpdate_AddShadowCasters()
+{
+	// simple for the moment, add all objects in visible rooms as casters if they are not already visible
+	for (int n=0; n<m_pCurr_VisibleRoomList->size(); n++)
+	{
+		int r = (*m_pCurr_VisibleRoomList)[n];
+		m_Rooms[r].AddShadowCasters(*this);
+	}
+}
+
 void LRoomManager::FrameUpdate_FinalizeVisibility_SoftShow()
 {
 	// apply the appropriate soft show for each sob in the render list
@@ -1824,6 +2930,42 @@ void LRoomManager::FrameUpdate_FinalizeVisibility_SoftShow()
 }
 
 
+void LRoomManager::FrameUpdate_FinalizeVisibility_DOBCasters()
+{
+	// dobs in visible rooms are dealt with in LRoom::FinalizeVisibility
+	for (int n=0; n<m_CasterList_DOBs.size(); n++)
+	{
+		int dob_id = m_CasterList_DOBs[n];
+		const LDob &dob = m_DobList.GetDob(dob_id);
+
+		if (!m_BF_visible_rooms.GetBit(dob.m_iRoomID))
+			m_DobList.ShowDob(dob_id, false, true);
+	}
+
+	// hide any dobs that were casting last frame from outside the visible rooms, and no longer are
+	for (int n=0; n<m_CasterList_DOBs_prev.size(); n++)
+	{
+		int dob_id = m_CasterList_DOBs_prev[n];
+
+		// may have been unregistered since
+		if (!m_DobList.IsValid(dob_id))
+			continue;
+
+		const LDob &dob = m_DobList.GetDob(dob_id);
+		if (dob.m_uiFrameCaster == m_uiFrameCounter)
+			continue;
+
+		if (!m_BF_visible_rooms.GetBit(dob.m_iRoomID))
+			m_DobList.ShowDob(dob_id, false, false);
+	}
+
+#ifdef LDEBUG_LIGHTS
+	if (m_bDebugFrameString)
+		DebugString_Add("TOTAL dob shadow casters " + itos(m_CasterList_DOBs.size()) + "\n");
+#endif
+}
+
+
 void LRoomManager::FrameUpdate_FinalizeVisibility_WithinRooms()
 {
 	// and hide all the dobs that are in visible rooms that haven't been made visible
@@ -1951,8 +3093,8 @@ void LRoomManager::FrameUpdate_DrawDebug(const LSource &cam, const LRoom &lroom)
 
 
 	// if debug bounds are on and there is a bound for this room
-	const Geometry::MeshData &md = lroom.m_Bound_MeshData;
-	if (m_bDebugBounds && md.faces.size())
+	const LBoundHull &hull = lroom.m_BoundHull;
+	if (m_bDebugBounds && hull.IsActive())
 	{
 		Object * pObj = ObjectDB::get_instance(m_ID_DebugBounds);
 		ImmediateGeometry * im = Object::cast_to<ImmediateGeometry>(pObj);
@@ -1963,19 +3105,23 @@ void LRoomManager::FrameUpdate_DrawDebug(const LSource &cam, const LRoom &lroom)
 
 		im->begin(Mesh::PRIMITIVE_TRIANGLES, NULL);
 
-		for (int n=0; n<md.faces.size(); n++)
+		int i = 0;
+		for (int n=0; n<hull.m_FacePlanes.size(); n++)
 		{
-			const Geometry::MeshData::Face &f = md.faces[n];
+			const Plane &plane = hull.m_FacePlanes[n];
 
-			int numTris = f.indices.size() - 2;
+			int numIndices = hull.m_Faces[i++];
+			int numTris = numIndices - 2;
 
 			for (int t=0; t<numTris; t++)
 			{
-				im->set_normal(f.plane.normal);
-				im->add_vertex(md.vertices[f.indices[0]]);
-				im->add_vertex(md.vertices[f.indices[t+1]]);
-				im->add_vertex(md.vertices[f.indices[t+2]]);
+				im->set_normal(plane.normal);
+				im->add_vertex(hull.m_Verts[hull.m_Faces[i]]);
+				im->add_vertex(hull.m_Verts[hull.m_Faces[i+t+1]]);
+				im->add_vertex(hull.m_Verts[hull.m_Faces[i+t+2]]);
 			}
+
+			i += numIndices;
 		}
 
 		im->end();
@@ -1999,6 +3145,20 @@ void LRoomManager::_notification(int p_what) {
 
 
 
+		} break;
+	case NOTIFICATION_EXIT_TREE: {
+			// the rooms and objects may be freed while we are out of the tree
+			ObjectCache_InvalidateAll();
+		} break;
+	case NOTIFICATION_PREDELETE: {
+			AsyncConvert_Cancel();
+
+			// hand back any shared baked data
+			if (m_pBakedData)
+			{
+				m_pBakedData->Release();
+				m_pBakedData = 0;
+			}
 		} break;
 		// NOTE!! Must use PROCESS and NOT INTERNAL_PROCESS.
 		// This is because all the internal processes are handled before all the processes.
@@ -2018,11 +3178,24 @@ void LRoomManager::_bind_methods()
 	// main functions
 	ClassDB::bind_method(D_METHOD("rooms_convert", "verbose", "delete lights"), &LRoomManager::rooms_convert);
 	ClassDB::bind_method(D_METHOD("rooms_single_room_convert", "verbose", "delete lights"), &LRoomManager::rooms_single_room_convert);
+	ClassDB::bind_method(D_METHOD("rooms_convert_async", "verbose", "delete lights", "budget_usecs"), &LRoomManager::rooms_convert_async);
+	ClassDB::bind_method(D_METHOD("rooms_is_converting"), &LRoomManager::rooms_is_converting);
+
+	ADD_SIGNAL(MethodInfo("convert_progress", PropertyInfo(Variant::REAL, "progress"), PropertyInfo(Variant::STRING, "stage")));
+	ADD_SIGNAL(MethodInfo("convert_finished", PropertyInfo(Variant::BOOL, "success")));
 	ClassDB::bind_method(D_METHOD("rooms_set_portal_plane_convention", "flip"), &LRoomManager::rooms_set_portal_plane_convention);
 
 	ClassDB::bind_method(D_METHOD("rooms_set_hide_method_detach", "detach"), &LRoomManager::rooms_set_hide_method_detach);
 
 	ClassDB::bind_method(D_METHOD("rooms_release"), &LRoomManager::rooms_release);
+	ClassDB::bind_method(D_METHOD("rooms_save_baked", "filename"), &LRoomManager::rooms_save_baked);
+	ClassDB::bind_method(D_METHOD("rooms_load_baked", "filename"), &LRoomManager::rooms_load_baked);
+	ClassDB::bind_method(D_METHOD("rooms_set_convert_threads", "num_threads"), &LRoomManager::rooms_set_convert_threads);
+	ClassDB::bind_method(D_METHOD("rooms_set_bound_max_planes", "max_planes"), &LRoomManager::rooms_set_bound_max_planes);
+	ClassDB::bind_method(D_METHOD("rooms_set_convert_reorder", "active"), &LRoomManager::rooms_set_convert_reorder);
+	ClassDB::bind_method(D_METHOD("rooms_add_room", "room"), &LRoomManager::rooms_add_room);
+	ClassDB::bind_method(D_METHOD("rooms_remove_room", "room_id"), &LRoomManager::rooms_remove_room);
+	ClassDB::bind_method(D_METHOD("rooms_rebuild_room", "room_id"), &LRoomManager::rooms_rebuild_room);
 
 	ClassDB::bind_method(D_METHOD("rooms_set_camera", "camera"), &LRoomManager::rooms_set_camera);
 
@@ -2049,6 +3222,9 @@ void LRoomManager::_bind_methods()
 	ClassDB::bind_method(D_METHOD("dob_register", "node", "pos", "radius"), &LRoomManager::dob_register);
 	ClassDB::bind_method(D_METHOD("dob_unregister", "dob_id"), &LRoomManager::dob_unregister);
 	ClassDB::bind_method(D_METHOD("dob_update", "dob_id", "pos"), &LRoomManager::dob_update);
+	ClassDB::bind_method(D_METHOD("dob_update_batch", "dob_ids", "positions"), &LRoomManager::dob_update_batch);
+	ClassDB::bind_method(D_METHOD("dob_queue_update", "dob_id", "pos"), &LRoomManager::dob_queue_update);
+	ClassDB::bind_method(D_METHOD("dob_get_queued_room_id", "dob_id"), &LRoomManager::dob_get_queued_room_id);
 //	ClassDB::bind_method(D_METHOD("dob_teleport", "dob"), &LRoomManager::dob_teleport);
 
 //	ClassDB::bind_method(D_METHOD("dob_register_hint", "dob", "radius", "room"), &LRoomManager::dob_register_hint);
@@ -2063,6 +3239,12 @@ void LRoomManager::_bind_methods()
 //	ClassDB::bind_method(D_METHOD("dynamic_light_register_hint", "light", "radius", "room"), &LRoomManager::dynamic_light_register_hint);
 	ClassDB::bind_method(D_METHOD("dynamic_light_unregister", "light"), &LRoomManager::dynamic_light_unregister);
 	ClassDB::bind_method(D_METHOD("dynamic_light_update", "light"), &LRoomManager::dynamic_light_update);
+	ClassDB::bind_method(D_METHOD("dynamic_light_set_retrace_thresholds", "dist", "angle"), &LRoomManager::dynamic_light_set_retrace_thresholds);
+	ClassDB::bind_method(D_METHOD("rooms_set_light_baked_casters", "active"), &LRoomManager::rooms_set_light_baked_casters);
+	ClassDB::bind_method(D_METHOD("rooms_set_shadow_volume_culling", "active"), &LRoomManager::rooms_set_shadow_volume_culling);
+	ClassDB::bind_method(D_METHOD("rooms_set_light_budget", "max_lights", "shadows_only"), &LRoomManager::rooms_set_light_budget);
+	ClassDB::bind_method(D_METHOD("dynamic_light_set_retrace_budget", "usecs"), &LRoomManager::dynamic_light_set_retrace_budget);
+	ClassDB::bind_method(D_METHOD("dynamic_light_get_retrace_backlog"), &LRoomManager::dynamic_light_get_retrace_backlog);
 
 	// helper
 	ClassDB::bind_method(D_METHOD("rooms_get_room", "room id"), &LRoomManager::rooms_get_room);
@@ -2070,6 +3252,12 @@ void LRoomManager::_bind_methods()
 	ClassDB::bind_method(D_METHOD("rooms_is_room_visible", "room id"), &LRoomManager::rooms_is_room_visible);
 	ClassDB::bind_method(D_METHOD("rooms_get_visible_rooms"), &LRoomManager::rooms_get_visible_rooms);
 
+	// streaming
+	ClassDB::bind_method(D_METHOD("rooms_set_streaming", "active", "load_portals", "unload_portals"), &LRoomManager::rooms_set_streaming);
+	ClassDB::bind_method(D_METHOD("rooms_set_streaming_budget", "megabytes"), &LRoomManager::rooms_set_streaming_budget);
+	ClassDB::bind_method(D_METHOD("rooms_is_room_resident", "room_id"), &LRoomManager::rooms_is_room_resident);
+	ClassDB::bind_method(D_METHOD("rooms_get_streaming_stats"), &LRoomManager::rooms_get_streaming_stats);
+
 
 	ClassDB::bind_method(D_METHOD("set_rooms", "rooms"), &LRoomManager::set_rooms);
 	ClassDB::bind_method(D_METHOD("set_rooms_path", "rooms"), &LRoomManager::set_rooms_path);
@@ -2077,6 +3265,12 @@ void LRoomManager::_bind_methods()
 
 	ClassDB::bind_method(D_METHOD("export_scene_DAE", "node", "filename"), &LRoomManager::export_scene_DAE);
 
+	// internal, invalidating the cached godot pointers
+	ClassDB::bind_method(D_METHOD("_room_exiting_tree", "room_id"), &LRoomManager::_room_exiting_tree);
+	ClassDB::bind_method(D_METHOD("_sob_exiting_tree", "sob_id"), &LRoomManager::_sob_exiting_tree);
+	ClassDB::bind_method(D_METHOD("_dob_exiting_tree", "dob_id"), &LRoomManager::_dob_exiting_tree);
+	ClassDB::bind_method(D_METHOD("_light_exiting_tree", "light_id"), &LRoomManager::_light_exiting_tree);
+
 
 	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "rooms"), "set_rooms_path", "get_rooms_path");
 }
@@ -31,11 +31,17 @@
 #include "lplanes_pool.h"
 
 #include "ldoblist.h"
+#include "ldob_queue.h"
 #include "lroom.h"
 #include "lportal.h"
 #include "larea.h"
 #include "ltrace.h"
 #include "lmain_camera.h"
+#include "lroom_bvh.h"
+#include "lbaked_data.h"
+#include "lroom_streamer.h"
+
+class LRoomConverter;
 
 class LRoomManager : public Spatial {
 	GDCLASS(LRoomManager, Spatial);
@@ -46,6 +52,9 @@ class LRoomManager : public Spatial {
 	friend class LTrace;
 	friend class LMainCamera;
 	friend class LDobList;
+	friend class LDobQueue;
+	friend class LRoomBaker;
+	friend class LRoomStreamer;
 
 public:
 	// PUBLIC INTERFACE TO GDSCRIPT
@@ -62,8 +71,33 @@ public:
 	// convert empties and meshes to rooms and portals
 	bool rooms_convert(bool bVerbose, bool bDeleteLights);
 	bool rooms_single_room_convert(bool bVerbose, bool bDeleteLights);
+	// converts over several frames, spending roughly budget_usecs of each frame on the main thread.
+	// Emits convert_progress(progress, stage) each frame and convert_finished(success) at the end,
+	// culling starts once finished.
+	bool rooms_convert_async(bool bVerbose, bool bDeleteLights, int budget_usecs);
+	bool rooms_is_converting() const {return m_pAsyncConverter != 0;}
 	// free memory for current set of rooms, prepare for converting a new game level
 	void rooms_release();
+	// save the converted rooms to a binary file, which can be loaded instead of converting
+	bool rooms_save_baked(String szFilename);
+	// load rooms saved with rooms_save_baked, the room list must be the same scene that was converted.
+	// Returns false if the file is missing, from an old version, or does not match the scene (call rooms_convert instead).
+	bool rooms_load_baked(String szFilename);
+	// number of threads used for the room bounds and light tracing in rooms_convert, 0 for one per processor
+	void rooms_set_convert_threads(int num_threads);
+	// limit the planes in each room bound (minimum 6) to speed up finding the room of a point, 0 for no limit.
+	// The simplified bounds are slightly larger than the originals, the error is logged when converting.
+	void rooms_set_bound_max_planes(int max_planes);
+	// number the rooms in portal graph order and sort the objects in each room spatially, for memory locality
+	// when rendering. Room IDs in the API are unchanged.
+	void rooms_set_convert_reorder(bool bActive);
+	// incremental conversion, changing single rooms without a full reconvert.
+	// Add converts a room_ node placed in the room list (or in an area_ within it), returns the room ID or -1.
+	int rooms_add_room(Node * pRoomNode);
+	// the room ID is freed (and may be reused by the next room added), the room nodes are restored so they can be freed
+	bool rooms_remove_room(int room_id);
+	// finds the objects, lights and bound of the room again, keeping its portals and room ID
+	bool rooms_rebuild_room(int room_id);
 
 	// choose which camera you want to use to determine visibility.
 	// normally this will be your main camera, but you can choose another for debugging
@@ -89,6 +123,12 @@ public:
 	bool dob_unregister(int dob_id);
 	// returns the room ID within
 	int dob_update(int dob_id, const Vector3 &pos);
+	// update many dobs in one call, returns the room ID within for each dob (or -1 if the dob ID is invalid)
+	PoolIntArray dob_update_batch(const PoolIntArray &dob_ids, const PoolVector3Array &positions);
+	// thread safe, can be called from e.g. the physics thread. The update is applied at the start of the next frame.
+	void dob_queue_update(int dob_id, const Vector3 &pos);
+	// thread safe, returns the room ID as of the start of the last frame
+	int dob_get_queued_room_id(int dob_id) const;
 
 	//______________________________________________________________________________________
 	// LIGHTS
@@ -101,6 +141,31 @@ public:
 	int dynamic_light_register(Node * pLightNode, float radius);
 	bool dynamic_light_unregister(int light_id);
 	int dynamic_light_update(int light_id, const Vector3 &pos, const Vector3 &dir); // returns room within
+	// moves smaller than this (distance, and angle in degrees) will not retrace the rooms affected by dynamic lights
+	void dynamic_light_set_retrace_thresholds(float dist, float angle);
+	// static lights use the shadow casters found on conversion rather than tracing each frame (default on)
+	void rooms_set_light_baked_casters(bool bActive);
+	// casters are only kept if their shadow can fall within the camera view (default on)
+	void rooms_set_shadow_volume_culling(bool bActive);
+	// maximum number of local lights (spot and omni) active per frame, 0 for no limit.
+	// The least important lights over the budget are hidden, or only have their shadows turned off.
+	void rooms_set_light_budget(int max_lights, bool bShadowsOnly);
+	// if non zero, retraces are deferred and spread over frames, spending at most this many microseconds per frame
+	void dynamic_light_set_retrace_budget(int usecs);
+	// number of dynamic lights waiting to be retraced
+	int dynamic_light_get_retrace_backlog() const;
+
+	//______________________________________________________________________________________
+	// STREAMING
+	// unload the meshes of rooms far from the camera (counted in portals), and load them back in the background as the camera nears.
+	// Rooms up to load_portals away are loaded, and rooms more than unload_portals away are unloaded.
+	void rooms_set_streaming(bool bActive, int load_portals, int unload_portals);
+	// estimated memory for the streamed meshes, 0 for no limit. Only rooms outside the load distance are unloaded to stay within it.
+	void rooms_set_streaming_budget(int megabytes);
+	// whether the meshes of the room are currently loaded
+	bool rooms_is_room_resident(int room_id) const;
+	// counts of resident / loading / unloaded rooms, queued loads, estimated memory etc
+	Dictionary rooms_get_streaming_stats() const;
 
 	//______________________________________________________________________________________
 	// HELPERS
@@ -156,6 +221,13 @@ private:
 
 	LVector<int> m_MasterList_SOBs;
 
+	// dobs found visible by the camera trace (also marked with LDob::m_uiFrameVisible)
+	LVector<int> m_VisibleList_DOBs;
+
+	// dobs found by the light traces to be casting shadows into view (also marked with LDob::m_uiFrameCaster)
+	LVector<int> m_CasterList_DOBs;
+	LVector<int> m_CasterList_DOBs_prev;
+
 
 	Lawn::LBitField_Dynamic m_BF_visible_SOBs;
 	Lawn::LBitField_Dynamic m_BF_caster_SOBs;
@@ -180,6 +252,8 @@ private:
 
 	// some lights may be processed on a frame but found not to intersect the view frustum
 	Lawn::LBitField_Dynamic m_BF_ProcessedLights;
+	// lights in the visible rooms, waiting for the light budget before their casters are found
+	LVector<int> m_LightCandidates;
 
 	// keep all the light rendering stuff together
 	struct LLightRender
@@ -206,25 +280,94 @@ private:
 	LVector<LPortal> m_Portals;
 	LVector<LArea> m_Areas;
 
+	// spatial index over the room bounds, for finding which room a point is in
+	LRoomBVH m_RoomBVH;
+
 	// static objects
 	LVector<LSob> m_SOBs;
 
+	// world space bounds of the static objects, read only, by SOB ID
+	LBakedVector<AABB> m_SOB_AABBs;
+
 	// lights
 	LVector<LLight> m_Lights;
 
 	// SHADOWS
 	// master list of shadow casters for each room
-	LVector<uint32_t> m_ShadowCasters_SOB; // not used any more?
+	LBakedVector<uint32_t> m_ShadowCasters_SOB; // not used any more?
 
 	// master list of casters for each light (precalculated list)
-	LVector<uint32_t> m_LightCasters_SOB;
+	LBakedVector<uint32_t> m_LightCasters_SOB;
 
 	// AREAS
 	// master list of lights affecting each area
-	LVector<uint32_t> m_AreaLights;
+	LBakedVector<uint32_t> m_AreaLights;
 
 	// master list of rooms in each area
-	LVector<uint32_t> m_AreaRooms;
+	LBakedVector<uint32_t> m_AreaRooms;
+
+	// when loaded from a baked file, the shared block the lists above point into (else NULL)
+	LBakedData * m_pBakedData;
+
+	// 0 for automatic
+	int m_iConvertThreads;
+
+	// 0 for no limit on the number of room bound planes
+	int m_iBound_MaxPlanes;
+
+	// renumber rooms in portal graph order and sort SOBs spatially on conversion
+	bool m_bConvert_Reorder;
+
+	// when conversion reorders the rooms, the API keeps the room IDs in scene tree order.
+	// Indexed by internal and public room ID respectively, empty when they are the same.
+	LVector<int> m_RoomID_ToPublic;
+	LVector<int> m_RoomID_FromPublic;
+
+	// time sliced conversion in progress, else NULL
+	LRoomConverter * m_pAsyncConverter;
+	int m_iAsyncConvert_BudgetUSecs;
+
+	// Incremental conversion moves and removes spans in the contiguous lists above, leaving gaps
+	// which are compacted when they get too big.
+	struct LIncremental
+	{
+		int m_iUnused_Portals;
+		int m_iUnused_SOBs;
+		int m_iUnused_LightCasters;
+		int m_iUnused_ShadowCasters;
+		int m_iUnused_AreaRooms;
+		int m_iUnused_AreaLights;
+
+		// since the last full conversion (changed lists can't be saved baked)
+		bool m_bChanged;
+
+		// from the last full conversion
+		bool m_bDeleteLights;
+
+		void Reset();
+	} m_Incremental;
+
+	// Portals linking to a room that has been removed, kept so they can be relinked
+	// when a room of the same name is added again (e.g. streaming a building back in).
+	struct LDetachedPortal
+	{
+		String m_szOwnerRoom;
+		LPortal m_Portal;
+	};
+	LVector<LDetachedPortal> m_DetachedPortals;
+
+	// Manual bounds of rooms that have been removed or are being rebuilt, the bound_ mesh
+	// no longer exists so the hull points are kept for when the room is converted again.
+	struct LDetachedBound
+	{
+		String m_szOwnerRoom;
+		Vector<Vector3> m_Pts;
+	};
+	LVector<LDetachedBound> m_DetachedBounds;
+
+	// paths (relative to the room list) of the nodes deleted by conversion,
+	// so loading baked rooms can delete them too
+	LVector<String> m_ConvertDeletedNodes;
 
 	// The recursive visibility function needs to allocate loads of planes.
 	// We use a pool for this instead of allocating on the fly.
@@ -232,6 +375,12 @@ private:
 
 	LDobList m_DobList;
 
+	// dob updates pushed from other threads
+	LDobQueue m_DobQueue;
+
+	// optional loading and unloading of room meshes
+	LRoomStreamer m_Streamer;
+
 public:
 	// whether debug planes is switched on
 	bool m_bDebugPlanes;
@@ -286,6 +435,42 @@ private:
 	float m_fLightmapUnMerge_ThresholdDist;
 	float m_fLightmapUnMerge_ThresholdDot;
 
+	// dynamic light retrace params
+	float m_fLightRetrace_ThresholdDist;
+	float m_fLightRetrace_ThresholdAngle; // degrees
+	float m_fLightRetrace_ThresholdDot;
+	int m_iLightRetrace_BudgetUSecs; // 0 for immediate retrace
+
+	// whether static lights use the conversion caster lists
+	bool m_bLightBakedCasters;
+
+	// whether casters are culled by their shadow volume against the camera frustum
+	bool m_bShadowVolumeCulling;
+
+	// light budget
+	int m_iLightBudget_Max; // 0 for unlimited
+	bool m_bLightBudget_ShadowsOnly;
+
+	class LLightScore
+	{
+	public:
+		int m_LightID;
+		float m_fImportance;
+	};
+	LVector<LLightScore> m_LightBudget_Scores;
+
+	// per frame stats, casters tested against their shadow volume and how many culled
+	int m_iStats_CasterCandidates;
+	int m_iStats_CasterShadowCulled;
+
+	// light IDs waiting for a time sliced retrace
+	LVector<int> m_LightRetrace_Pending;
+
+	// affected rooms of all the lights, each light has a span
+	LVector<int> m_LightAffectedRooms;
+	int m_iLightAffectedRooms_Unused; // left behind by spans that have moved
+	unsigned int m_uiLightMark;
+
 private:
 	// PRIVATE FUNCS
 	// this is where we do all the culling
@@ -293,10 +478,33 @@ private:
 	void FrameUpdate_Prepare();
 	void FrameUpdate_FinalizeRooms();
 	void FrameUpdate_AddShadowCasters();
+	void FrameUpdate_LightBudget(const Vector3 &ptCam);
+	void FrameUpdate_LightRetraces(const Vector3 &ptCam);
 	void FrameUpdate_CreateMasterList();
 	void FrameUpdate_FinalizeVisibility_WithinRooms();
+	void FrameUpdate_FinalizeVisibility_DOBCasters();
 	void FrameUpdate_FinalizeVisibility_SoftShow();
 
+	// light budget
+	float Light_CalculateImportance(const LLight &light, const Vector3 &ptCam) const;
+	void Light_SuppressShadow(LLight &light, bool bSuppress);
+
+	// light affected rooms
+	int Light_GetAffectedRoom(const LLight &light, int n) const {return m_LightAffectedRooms[light.m_FirstAffectedRoom + n];}
+	void Light_AddAffectedRoom(LLight &light, int room_id);
+	void Light_ClearAffectedRooms(LLight &light) {light.m_NumAffectedRooms = 0;}
+	// marks the rooms so membership can be tested with Room_IsLightMarked, until the next call
+	void Light_MarkAffectedRooms(const LLight &light);
+	bool Room_IsLightMarked(int room_id) const {return m_Rooms[room_id].m_uiLightMark == m_uiLightMark;}
+	void LightAffectedRooms_Compact();
+	void LightAffectedRooms_Reset();
+
+	// dynamic lights
+	bool DynamicLight_NeedsRetrace(const LLight &light) const;
+	void DynamicLight_Retrace(int light_id);
+	void DynamicLight_RequestRetrace(int light_id);
+	void DynamicLight_AddPendingRoom(int light_id, int room_id);
+
 	// debugging emulate view frustum
 	void FrameUpdate_FrustumOnly();
 
@@ -305,6 +513,8 @@ private:
 
 	// internal
 	bool RoomsConvert(bool bVerbose, bool bDeleteLights, bool bSingleRoomMode);
+	void FrameUpdate_AsyncConvert();
+	void AsyncConvert_Cancel();
 
 	// dobs
 	int DobRegister(Spatial * pDOB, const Vector3 &pos, float radius, int iRoom);
@@ -319,8 +529,20 @@ private:
 //	void DobsAutoUpdate();
 
 	void CreateDebug();
+	// sized to the current rooms, sobs and lights, optionally keeping the current bits (incremental conversion)
+	void CreateBitfields(bool bPreserve = false);
 	void ReleaseResources(bool bPrepareConvert);
 	void ShowAll(bool bShow);
+
+	// cached godot pointers, see LHidable
+	void ObjectCache_InvalidateAll();
+	void ObjectCache_Watch(ObjectID id, const StringName &method, int slot, bool bWatch = true);
+	// call whenever the rooms, SOBs or lights may have been renumbered
+	void ObjectCache_WatchAll();
+	void _room_exiting_tree(int room_id);
+	void _sob_exiting_tree(int sob_id);
+	void _dob_exiting_tree(int dob_id);
+	void _light_exiting_tree(int light_id);
 	void ResolveRoomListPath();
 
 	// frame debug string
@@ -333,13 +555,23 @@ private:
 	void Light_UpdateTransform(LLight &light, const Light &glight) const;
 	void Light_FrameProcess(int lightID);
 	bool Light_FindCasters(int lightID);
+	bool Light_Activate(int lightID, bool bFindCasters);
 
 
 	// helper funcs
 	const LRoom * GetRoom(int i) const;
 	LRoom * GetRoom(int i);
 
+	// converting room IDs at the API
+	int RoomID_ToPublic(int room_id) const;
+	int RoomID_FromPublic(int room_id) const;
+	// to_public is indexed by internal room ID
+	void RoomID_SetRemap(const LVector<int> &to_public);
+	// a room added to the end by incremental conversion
+	void RoomID_Append(int room_id);
+
 	int FindClosestRoom(const Vector3 &pt) const;
+	int FindClosestRoom_Linear(const Vector3 &pt) const;
 
 	LRoom &Portal_GetLinkedRoom(const LPortal &port);
 
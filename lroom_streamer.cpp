@@ -0,0 +1,848 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "lroom_streamer.h"
+#include "lroom_manager.h"
+#include "ldebug.h"
+#include "core/io/resource_loader.h"
+#include "scene/3d/mesh_instance.h"
+#include "scene/3d/light.h"
+#include "scene/resources/packed_scene.h"
+
+
+LRoomStreamer::LRoomStreamer()
+{
+	m_bActive = false;
+	m_iLoadDistance = 2;
+	m_iUnloadDistance = 4;
+	m_uiBudget = 0;
+	m_iCameraRoom = -1;
+	m_uiNextRequest = 1;
+
+	m_iStats_LoadsCompleted = 0;
+	m_iStats_LoadFailures = 0;
+	m_iStats_Unloads = 0;
+
+	m_pMutex = Mutex::create();
+	m_pSemaphore = Semaphore::create();
+	m_pThread = 0;
+	m_bExit = false;
+}
+
+LRoomStreamer::~LRoomStreamer()
+{
+	if (m_pThread)
+	{
+		m_bExit = true;
+		m_pSemaphore->post();
+		Thread::wait_to_finish(m_pThread);
+		memdelete(m_pThread);
+		m_pThread = 0;
+	}
+
+	if (m_pSemaphore)
+	{
+		memdelete(m_pSemaphore);
+		m_pSemaphore = 0;
+	}
+
+	if (m_pMutex)
+	{
+		memdelete(m_pMutex);
+		m_pMutex = 0;
+	}
+}
+
+void LRoomStreamer::SetActive(LRoomManager &manager, bool bActive, int load_portals, int unload_portals)
+{
+	m_iLoadDistance = MAX(load_portals, 0);
+
+	// a gap between the two prevents rooms loading and unloading repeatedly as the camera moves back and forth
+	m_iUnloadDistance = MAX(unload_portals, m_iLoadDistance + 1);
+
+	if (m_bActive && !bActive)
+		MakeAllResident(manager);
+
+	m_bActive = bActive;
+	SetDirty();
+}
+
+void LRoomStreamer::Reset()
+{
+	m_pMutex->lock();
+	m_Queued.clear(true);
+	m_Finished.clear(true);
+	m_pMutex->unlock();
+
+	m_Rooms.clear(true);
+	SetDirty();
+}
+
+bool LRoomStreamer::IsResident(int room_id) const
+{
+	// rooms not yet seen by the streamer have not been unloaded
+	if ((unsigned int) room_id >= (unsigned int) m_Rooms.size())
+		return true;
+
+	return m_Rooms[room_id].m_eState == RS_RESIDENT;
+}
+
+void LRoomStreamer::Grow(LRoomManager &manager)
+{
+	int old_size = m_Rooms.size();
+	int new_size = manager.m_Rooms.size();
+	if (new_size <= old_size)
+		return;
+
+	m_Rooms.resize(new_size);
+	for (int n=old_size; n<new_size; n++)
+	{
+		LResidency &res = m_Rooms[n];
+		res.m_eState = RS_RESIDENT;
+		res.m_iDistance = -1;
+		res.m_uiBytes = 0;
+		res.m_bEstimated = false;
+		res.m_iPending = 0;
+		res.m_uiRequest = 0;
+		res.m_Items.clear();
+		res.m_Nodes.clear();
+		res.m_SOBPaths.clear();
+		res.m_Loaded.clear();
+	}
+
+	SetDirty();
+}
+
+void LRoomStreamer::Update(LRoomManager &manager, int camera_room_id)
+{
+	if (!m_bActive)
+		return;
+
+	Grow(manager);
+
+	bool bChanged = ProcessFinishedLoads(manager);
+
+	// the residency only depends on the distances, which only change when the camera changes room
+	if (camera_room_id != m_iCameraRoom)
+	{
+		CalculateDistances(manager, camera_room_id);
+		bChanged = true;
+
+		for (int n=0; n<m_Rooms.size(); n++)
+		{
+			LResidency &res = m_Rooms[n];
+
+			// estimate while the content is loaded
+			if (!res.m_bEstimated && (res.m_eState == RS_RESIDENT))
+				Room_Estimate(manager, n);
+
+			bool bFar = (res.m_iDistance == -1) || (res.m_iDistance > m_iUnloadDistance);
+			bool bNear = (res.m_iDistance != -1) && (res.m_iDistance <= m_iLoadDistance);
+
+			switch (res.m_eState)
+			{
+			case RS_RESIDENT:
+				if (bFar)
+					Room_Unload(manager, n);
+				break;
+			case RS_LOADING:
+				if (bFar)
+					Room_CancelLoad(n);
+				break;
+			case RS_UNLOADED:
+				if (bNear)
+					Room_RequestLoad(manager, n);
+				break;
+			}
+		}
+	}
+
+	if (bChanged)
+		ApplyBudget(manager);
+}
+
+// breadth first through the portals from the camera room, only as far as needed to decide on unloading
+void LRoomStreamer::CalculateDistances(LRoomManager &manager, int camera_room_id)
+{
+	m_iCameraRoom = camera_room_id;
+
+	for (int n=0; n<m_Rooms.size(); n++)
+		m_Rooms[n].m_iDistance = -1;
+
+	if ((unsigned int) camera_room_id >= (unsigned int) m_Rooms.size())
+		return;
+
+	m_BFS_Queue.clear();
+	m_BFS_Queue.push_back(camera_room_id);
+	m_Rooms[camera_room_id].m_iDistance = 0;
+
+	for (int q=0; q<m_BFS_Queue.size(); q++)
+	{
+		int room_id = m_BFS_Queue[q];
+		int dist = m_Rooms[room_id].m_iDistance;
+
+		// anything further is unloaded anyway
+		if (dist > m_iUnloadDistance)
+			continue;
+
+		const LRoom &lroom = manager.m_Rooms[room_id];
+		for (int p=0; p<lroom.m_iNumPortals; p++)
+		{
+			int linked = manager.m_Portals[lroom.m_iFirstPortal + p].m_iRoomNum;
+
+			LResidency &res = m_Rooms[linked];
+			if (res.m_iDistance != -1)
+				continue;
+
+			res.m_iDistance = dist + 1;
+			m_BFS_Queue.push_back(linked);
+		}
+	}
+}
+
+// rough memory use of the mesh data on the GPU, for the budget
+uint32_t LRoomStreamer::EstimateMeshBytes(const Ref<Mesh> &rmesh)
+{
+	uint32_t bytes = 0;
+	const Mesh &mesh = *rmesh.ptr();
+
+	for (int s=0; s<mesh.get_surface_count(); s++)
+	{
+		uint32_t format = mesh.surface_get_format(s);
+
+		int vert_size = 0;
+		if (format & Mesh::ARRAY_FORMAT_VERTEX) vert_size += 12;
+		if (format & Mesh::ARRAY_FORMAT_NORMAL) vert_size += 12;
+		if (format & Mesh::ARRAY_FORMAT_TANGENT) vert_size += 16;
+		if (format & Mesh::ARRAY_FORMAT_COLOR) vert_size += 16;
+		if (format & Mesh::ARRAY_FORMAT_TEX_UV) vert_size += 8;
+		if (format & Mesh::ARRAY_FORMAT_TEX_UV2) vert_size += 8;
+		if (format & Mesh::ARRAY_FORMAT_BONES) vert_size += 16;
+		if (format & Mesh::ARRAY_FORMAT_WEIGHTS) vert_size += 16;
+
+		bytes += mesh.surface_get_array_len(s) * vert_size;
+
+		if (format & Mesh::ARRAY_FORMAT_INDEX)
+			bytes += mesh.surface_get_array_index_len(s) * 4;
+	}
+
+	return bytes;
+}
+
+// meshes built in to a scene can't be loaded on their own, so are never unloaded
+MeshInstance * LRoomStreamer::GetStreamableMeshInstance(LRoomManager &manager, int sob_id)
+{
+	MeshInstance * pMI = Object::cast_to<MeshInstance>(manager.m_SOBs[sob_id].GetVI());
+	if (!pMI)
+		return 0;
+
+	Ref<Mesh> rmesh = pMI->get_mesh();
+	if (rmesh.is_null())
+		return 0;
+
+	String szPath = rmesh->get_path();
+	if ((szPath == "") || (szPath.find("::") != -1))
+		return 0;
+
+	return pMI;
+}
+
+// the topmost node instanced from a scene between the sob and its room, or 0 if the sob can't be streamed as nodes
+Node * LRoomStreamer::GetStreamableRoot(LRoomManager &manager, int room_id, int sob_id)
+{
+	if (!manager.GetRoomList())
+		return 0;
+
+	Node * pRoomNode = manager.m_Rooms[room_id].GetGodotRoom();
+	Node * pNode = manager.m_SOBs[sob_id].GetSpatial();
+	if (!pRoomNode || !pNode)
+		return 0;
+
+	Node * pRoot = 0;
+	while (pNode != pRoomNode)
+	{
+		// not within the room
+		if (!pNode)
+			return 0;
+
+		if (pNode->get_filename() != "")
+			pRoot = pNode;
+
+		pNode = pNode->get_parent();
+	}
+
+	if (pRoot && !IsSubtreeStreamable(pRoot))
+		return 0;
+
+	return pRoot;
+}
+
+// lights, portals and nested rooms are referred to by lportal elsewhere, so must stay resident
+bool LRoomStreamer::IsSubtreeStreamable(Node * pNode)
+{
+	if (Object::cast_to<Light>(pNode))
+		return false;
+
+	if (LPortal::NameStartsWith(pNode, "portal_") || LPortal::NameStartsWith(pNode, "room_") || LPortal::NameStartsWith(pNode, "area_") || LPortal::NameStartsWith(pNode, "bound_"))
+		return false;
+
+	for (int n=0; n<pNode->get_child_count(); n++)
+	{
+		if (!IsSubtreeStreamable(pNode->get_child(n)))
+			return false;
+	}
+
+	return true;
+}
+
+Node * LRoomStreamer::FindNode(LRoomManager &manager, const NodePath &path)
+{
+	Spatial * pRoomList = manager.GetRoomList();
+	if (!pRoomList || !pRoomList->has_node(path))
+		return 0;
+
+	return pRoomList->get_node(path);
+}
+
+void LRoomStreamer::Room_Estimate(LRoomManager &manager, int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+	const LRoom &lroom = manager.m_Rooms[room_id];
+
+	res.m_uiBytes = 0;
+	res.m_bEstimated = true;
+
+	int last_sob = lroom.m_iFirstSOB + lroom.m_iNumSOBs;
+	for (int n=lroom.m_iFirstSOB; n<last_sob; n++)
+	{
+		MeshInstance * pMI;
+
+		// streamed subtrees free their built in meshes too
+		if (GetStreamableRoot(manager, room_id, n))
+			pMI = Object::cast_to<MeshInstance>(manager.m_SOBs[n].GetVI());
+		else
+			pMI = GetStreamableMeshInstance(manager, n);
+
+		if (pMI && pMI->get_mesh().is_valid())
+			res.m_uiBytes += EstimateMeshBytes(pMI->get_mesh());
+	}
+}
+
+void LRoomStreamer::Node_Unload(LRoomManager &manager, LResidency &res, Node * pRoot)
+{
+	Node * pParent = pRoot->get_parent();
+
+	LNodeItem * pItem = res.m_Nodes.request();
+	pItem->m_ParentPath = manager.GetRoomList()->get_path_to(pParent);
+	pItem->m_szName = pRoot->get_name();
+	pItem->m_iIndex = pRoot->get_index();
+	pItem->m_szPath = pRoot->get_filename();
+
+	Spatial * pS = Object::cast_to<Spatial>(pRoot);
+	pItem->m_bSpatial = pS != 0;
+	if (pS)
+		pItem->m_Transform = pS->get_transform();
+}
+
+void LRoomStreamer::Room_Unload(LRoomManager &manager, int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+	const LRoom &lroom = manager.m_Rooms[room_id];
+
+	res.m_Items.clear();
+	res.m_Nodes.clear();
+	res.m_SOBPaths.clear();
+
+	int last_sob = lroom.m_iFirstSOB + lroom.m_iNumSOBs;
+
+	// sobs hidden by detaching are put back in the tree for now, so the subtrees and paths are complete
+	m_Reattached.clear();
+	for (int n=lroom.m_iFirstSOB; n<last_sob; n++)
+	{
+		LSob &sob = manager.m_SOBs[n];
+		if (sob.m_pNode && !sob.m_bShow)
+		{
+			sob.Show(true);
+			m_Reattached.push_back(n);
+		}
+	}
+
+	m_Roots.clear();
+
+	for (int n=lroom.m_iFirstSOB; n<last_sob; n++)
+	{
+		Node * pRoot = GetStreamableRoot(manager, room_id, n);
+		if (pRoot)
+		{
+			// the slot is kept, and the sob found again by path once the subtree is instanced
+			LSOBPath * pPath = res.m_SOBPaths.request();
+			pPath->m_iOffset = n - lroom.m_iFirstSOB;
+			pPath->m_Path = manager.GetRoomList()->get_path_to(manager.m_SOBs[n].GetSpatial());
+
+			if (m_Roots.find(pRoot) == -1)
+			{
+				m_Roots.push_back(pRoot);
+				Node_Unload(manager, res, pRoot);
+			}
+			continue;
+		}
+
+		MeshInstance * pMI = GetStreamableMeshInstance(manager, n);
+		if (!pMI)
+			continue;
+
+		LItem * pItem = res.m_Items.request();
+		pItem->m_MeshInstanceID = pMI->get_instance_id();
+		pItem->m_szPath = pMI->get_mesh()->get_path();
+
+		// the mesh is freed once no other instances are using it
+		pMI->set_mesh(Ref<Mesh>());
+	}
+
+	res.m_Nodes.sort();
+
+	for (int n=0; n<res.m_SOBPaths.size(); n++)
+	{
+		LSob &sob = manager.m_SOBs[lroom.m_iFirstSOB + res.m_SOBPaths[n].m_iOffset];
+		sob.m_pNode = 0;
+		sob.m_pParent = 0;
+	}
+
+	for (int n=0; n<m_Roots.size(); n++)
+	{
+		Node * pRoot = m_Roots[n];
+		pRoot->get_parent()->remove_child(pRoot);
+		pRoot->queue_delete();
+	}
+	m_Roots.clear();
+
+	// hide again any that are still there
+	for (int n=0; n<m_Reattached.size(); n++)
+		manager.m_SOBs[m_Reattached[n]].Show(false);
+
+	LPRINT(2, "Streaming unload room " + itos(room_id) + ", " + itos(res.m_Items.size()) + " meshes, " + itos(res.m_Nodes.size()) + " scenes");
+
+	res.m_eState = RS_UNLOADED;
+	m_iStats_Unloads++;
+}
+
+void LRoomStreamer::Room_RequestLoad(LRoomManager &manager, int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+
+	// no threads on this platform
+	if (!m_pSemaphore)
+	{
+		MakeResident(manager, room_id);
+		return;
+	}
+
+	if (!m_pThread)
+	{
+		m_bExit = false;
+		m_pThread = Thread::create(Thread_Func, this);
+	}
+
+	LPRINT(2, "Streaming load room " + itos(room_id) + ", " + itos(res.m_Items.size()) + " meshes, " + itos(res.m_Nodes.size()) + " scenes");
+
+	int nLoads = res.GetNumLoads();
+
+	res.m_eState = RS_LOADING;
+	res.m_uiRequest = m_uiNextRequest++;
+	res.m_iPending = nLoads;
+	res.m_Loaded.resize(nLoads);
+
+	if (!res.m_iPending)
+	{
+		Room_FinishLoad(manager, room_id);
+		return;
+	}
+
+	m_pMutex->lock();
+	for (int n=0; n<nLoads; n++)
+	{
+		LLoad * pLoad = m_Queued.request();
+		pLoad->m_RoomID = room_id;
+		pLoad->m_iItem = n;
+		pLoad->m_uiRequest = res.m_uiRequest;
+		pLoad->m_iDistance = res.m_iDistance;
+		if (n < res.m_Items.size())
+			pLoad->m_szPath = res.m_Items[n].m_szPath;
+		else
+			pLoad->m_szPath = res.m_Nodes[n - res.m_Items.size()].m_szPath;
+		pLoad->m_Resource = RES();
+	}
+	m_pMutex->unlock();
+
+	for (int n=0; n<nLoads; n++)
+		m_pSemaphore->post();
+}
+
+void LRoomStreamer::Room_CancelLoad(int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+
+	m_pMutex->lock();
+	for (int n=m_Queued.size()-1; n>=0; n--)
+	{
+		if (m_Queued[n].m_RoomID == room_id)
+			m_Queued.remove_unsorted(n);
+	}
+	m_pMutex->unlock();
+
+	// any loads already in progress will no longer match
+	res.m_uiRequest = 0;
+	res.m_iPending = 0;
+
+	for (int n=0; n<res.m_Loaded.size(); n++)
+		res.m_Loaded[n] = RES();
+	res.m_Loaded.clear();
+
+	res.m_eState = RS_UNLOADED;
+}
+
+// the meshes and scenes are only put back when all have loaded, so a cancelled load has nothing to undo
+void LRoomStreamer::Room_FinishLoad(LRoomManager &manager, int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+
+	int nItems = res.m_Items.size();
+	for (int n=0; n<nItems; n++)
+	{
+		if (!Item_Apply(res.m_Items[n], res.m_Loaded[n]))
+			m_iStats_LoadFailures++;
+
+		res.m_Loaded[n] = RES();
+	}
+
+	for (int n=0; n<res.m_Nodes.size(); n++)
+	{
+		if (!Node_Apply(manager, res.m_Nodes[n], res.m_Loaded[nItems + n]))
+			m_iStats_LoadFailures++;
+
+		res.m_Loaded[nItems + n] = RES();
+	}
+
+	Room_FindSOBs(manager, room_id);
+
+	res.m_Items.clear();
+	res.m_Nodes.clear();
+	res.m_SOBPaths.clear();
+	res.m_Loaded.clear();
+	res.m_iPending = 0;
+	res.m_eState = RS_RESIDENT;
+	m_iStats_LoadsCompleted++;
+}
+
+// point the sob slots at the newly instanced nodes
+void LRoomStreamer::Room_FindSOBs(LRoomManager &manager, int room_id)
+{
+	LResidency &res = m_Rooms[room_id];
+	const LRoom &lroom = manager.m_Rooms[room_id];
+
+	for (int n=0; n<res.m_SOBPaths.size(); n++)
+	{
+		const LSOBPath &path = res.m_SOBPaths[n];
+		if (path.m_iOffset >= lroom.m_iNumSOBs)
+			continue;
+
+		int sob_id = lroom.m_iFirstSOB + path.m_iOffset;
+		LSob &sob = manager.m_SOBs[sob_id];
+
+		VisualInstance * pVI = Object::cast_to<VisualInstance>(FindNode(manager, path.m_Path));
+		if (!pVI)
+		{
+			LWARN(5, "Streaming SOB not found : " + path.m_Path);
+			continue;
+		}
+
+		sob.m_ID = pVI->get_instance_id();
+		sob.Cache_Invalidate();
+		sob.Hidable_Create(pVI);
+		manager.ObjectCache_Watch(sob.m_ID, "_sob_exiting_tree", sob_id);
+
+		// as on conversion, take away layer 0 from the sob, so it can be culled effectively
+		pVI->set_layer_mask(0);
+	}
+}
+
+bool LRoomStreamer::Item_Apply(const LItem &item, const RES &res)
+{
+	Object * pObj = ObjectDB::get_instance(item.m_MeshInstanceID);
+	MeshInstance * pMI = Object::cast_to<MeshInstance>(pObj);
+
+	// freed by the game while unloaded
+	if (!pMI)
+		return true;
+
+	Ref<Mesh> rmesh = res;
+	if (rmesh.is_null())
+	{
+		LWARN(5, "Streaming failed to load mesh " + item.m_szPath);
+		return false;
+	}
+
+	pMI->set_mesh(rmesh);
+	return true;
+}
+
+bool LRoomStreamer::Node_Apply(LRoomManager &manager, const LNodeItem &item, const RES &res)
+{
+	Node * pParent = FindNode(manager, item.m_ParentPath);
+
+	// freed by the game while unloaded
+	if (!pParent)
+		return true;
+
+	Ref<PackedScene> rscene = res;
+	Node * pNode = 0;
+	if (rscene.is_valid())
+		pNode = rscene->instance();
+
+	if (!pNode)
+	{
+		LWARN(5, "Streaming failed to load scene " + item.m_szPath);
+		return false;
+	}
+
+	pNode->set_name(item.m_szName);
+
+	Spatial * pS = Object::cast_to<Spatial>(pNode);
+	if (pS && item.m_bSpatial)
+		pS->set_transform(item.m_Transform);
+
+	pParent->add_child(pNode);
+	if (item.m_iIndex < pParent->get_child_count())
+		pParent->move_child(pNode, item.m_iIndex);
+
+	return true;
+}
+
+bool LRoomStreamer::ProcessFinishedLoads(LRoomManager &manager)
+{
+	LVector<LLoad> finished;
+
+	// take the finished loads so the loader thread is not held up
+	m_pMutex->lock();
+	finished.copy_from(m_Finished);
+	for (int n=0; n<m_Finished.size(); n++)
+		m_Finished[n].m_Resource = RES();
+	m_Finished.clear();
+	m_pMutex->unlock();
+
+	bool bChanged = false;
+
+	for (int n=0; n<finished.size(); n++)
+	{
+		LLoad &load = finished[n];
+
+		// the room may have been cancelled, reset, or requested again since
+		if ((unsigned int) load.m_RoomID >= (unsigned int) m_Rooms.size())
+			continue;
+
+		LResidency &res = m_Rooms[load.m_RoomID];
+		if ((res.m_eState != RS_LOADING) || (res.m_uiRequest != load.m_uiRequest))
+			continue;
+
+		res.m_Loaded[load.m_iItem] = load.m_Resource;
+		load.m_Resource = RES();
+
+		res.m_iPending--;
+		if (!res.m_iPending)
+		{
+			Room_FinishLoad(manager, load.m_RoomID);
+			bChanged = true;
+		}
+	}
+
+	return bChanged;
+}
+
+// over budget, unload the furthest rooms outside the load distance
+void LRoomStreamer::ApplyBudget(LRoomManager &manager)
+{
+	if (!m_uiBudget)
+		return;
+
+	// loading rooms will soon be resident
+	uint64_t total = 0;
+	for (int n=0; n<m_Rooms.size(); n++)
+	{
+		const LResidency &res = m_Rooms[n];
+		if (res.m_eState != RS_UNLOADED)
+			total += res.m_uiBytes;
+	}
+
+	while (total > m_uiBudget)
+	{
+		int furthest = -1;
+		int furthest_dist = -1;
+
+		for (int n=0; n<m_Rooms.size(); n++)
+		{
+			const LResidency &res = m_Rooms[n];
+			if ((res.m_eState != RS_RESIDENT) || !res.m_uiBytes)
+				continue;
+
+			// not reached by the search counts as furthest
+			int dist = res.m_iDistance;
+			if (dist == -1)
+				dist = m_iUnloadDistance + 2;
+
+			if ((dist > m_iLoadDistance) && (dist > furthest_dist))
+			{
+				furthest = n;
+				furthest_dist = dist;
+			}
+		}
+
+		// everything left is needed
+		if (furthest == -1)
+			break;
+
+		total -= m_Rooms[furthest].m_uiBytes;
+		Room_Unload(manager, furthest);
+	}
+}
+
+void LRoomStreamer::MakeResident(LRoomManager &manager, int room_id)
+{
+	if ((unsigned int) room_id >= (unsigned int) m_Rooms.size())
+		return;
+
+	LResidency &res = m_Rooms[room_id];
+
+	// the size may have changed, e.g. the room being converted again
+	res.m_bEstimated = false;
+	SetDirty();
+
+	if (res.m_eState == RS_RESIDENT)
+		return;
+
+	if (res.m_eState == RS_LOADING)
+		Room_CancelLoad(room_id);
+
+	// load on the calling thread
+	int nItems = res.m_Items.size();
+	res.m_Loaded.resize(res.GetNumLoads());
+	for (int n=0; n<nItems; n++)
+		res.m_Loaded[n] = ResourceLoader::load(res.m_Items[n].m_szPath);
+	for (int n=0; n<res.m_Nodes.size(); n++)
+		res.m_Loaded[nItems + n] = ResourceLoader::load(res.m_Nodes[n].m_szPath);
+
+	Room_FinishLoad(manager, room_id);
+}
+
+void LRoomStreamer::MakeAllResident(LRoomManager &manager)
+{
+	for (int n=0; n<m_Rooms.size(); n++)
+		MakeResident(manager, n);
+}
+
+Dictionary LRoomStreamer::GetStats() const
+{
+	int resident = 0;
+	int loading = 0;
+	int unloaded = 0;
+	uint64_t bytes = 0;
+
+	for (int n=0; n<m_Rooms.size(); n++)
+	{
+		const LResidency &res = m_Rooms[n];
+		switch (res.m_eState)
+		{
+		case RS_RESIDENT:
+			resident++;
+			bytes += res.m_uiBytes;
+			break;
+		case RS_LOADING:
+			loading++;
+			break;
+		case RS_UNLOADED:
+			unloaded++;
+			break;
+		}
+	}
+
+	m_pMutex->lock();
+	int queued = m_Queued.size();
+	m_pMutex->unlock();
+
+	Dictionary d;
+	d["resident_rooms"] = resident;
+	d["loading_rooms"] = loading;
+	d["unloaded_rooms"] = unloaded;
+	d["queued_loads"] = queued;
+	d["resident_bytes"] = (int64_t) bytes;
+	d["budget_bytes"] = (int64_t) m_uiBudget;
+	d["loads_completed"] = m_iStats_LoadsCompleted;
+	d["load_failures"] = m_iStats_LoadFailures;
+	d["unloads"] = m_iStats_Unloads;
+	return d;
+}
+
+void LRoomStreamer::Thread_Func(void * pUserData)
+{
+	LRoomStreamer * pStreamer = (LRoomStreamer *) pUserData;
+	pStreamer->Thread_Loop();
+}
+
+// LOADER THREAD
+void LRoomStreamer::Thread_Loop()
+{
+	while (true)
+	{
+		m_pSemaphore->wait();
+
+		if (m_bExit)
+			break;
+
+		// nearest room first
+		LLoad load;
+		bool bFound = false;
+
+		m_pMutex->lock();
+		int best = -1;
+		for (int n=0; n<m_Queued.size(); n++)
+		{
+			if ((best == -1) || (m_Queued[n].m_iDistance < m_Queued[best].m_iDistance))
+				best = n;
+		}
+
+		if (best != -1)
+		{
+			load = m_Queued[best];
+			m_Queued.remove_unsorted(best);
+			bFound = true;
+		}
+		m_pMutex->unlock();
+
+		// cancelled since posting
+		if (!bFound)
+			continue;
+
+		load.m_Resource = ResourceLoader::load(load.m_szPath);
+
+		m_pMutex->lock();
+		m_Finished.push_back(load);
+		m_pMutex->unlock();
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+#include "core/os/mutex.h"
+#include "core/os/semaphore.h"
+#include "core/os/thread.h"
+#include "core/dictionary.h"
+#include "scene/resources/mesh.h"
+
+class LRoomManager;
+
+// Optional streaming of room content, based on how many portals away each room is from the camera room.
+// SOBs that were instanced from a scene file are streamed as whole node subtrees, which are freed to unload
+// a room, and instanced again from a background thread load. The SOB slots are kept, and found again by their
+// path from the roomlist, as the baker does.
+// SOBs built in to the level scene can't be recreated, so only their mesh resources are streamed, by taking
+// them off the MeshInstances (only meshes saved as separate resource files, built in meshes are left alone).
+// The rooms, portals, bounds and SOB AABBs stay resident, so visibility works the same whether rooms are loaded or not.
+class LRoomStreamer
+{
+public:
+	LRoomStreamer();
+	~LRoomStreamer();
+
+	// MAIN THREAD ONLY
+	// rooms within load_portals of the camera room are loaded, and rooms over unload_portals away are unloaded
+	void SetActive(LRoomManager &manager, bool bActive, int load_portals, int unload_portals);
+	// in bytes, 0 for no limit. Over budget, rooms outside the load distance are unloaded early, furthest first.
+	void SetBudget(uint64_t bytes) {m_uiBudget = bytes;}
+	bool IsActive() const {return m_bActive;}
+
+	void Update(LRoomManager &manager, int camera_room_id);
+
+	// loads the content of the room immediately if unloaded, e.g. before converting it again
+	void MakeResident(LRoomManager &manager, int room_id);
+	void MakeAllResident(LRoomManager &manager);
+
+	// rooms or portals have changed, distances need recalculating
+	void SetDirty() {m_iCameraRoom = -1;}
+
+	// forget all the rooms, after the room content is freed or made resident
+	void Reset();
+
+	bool IsResident(int room_id) const;
+	Dictionary GetStats() const;
+
+private:
+	enum eState
+	{
+		RS_RESIDENT,
+		RS_LOADING,
+		RS_UNLOADED,
+	};
+
+	// a mesh that has been taken off a SOB
+	class LItem
+	{
+	public:
+		ObjectID m_MeshInstanceID;
+		String m_szPath;
+	};
+
+	// a subtree instanced from a scene, that has been freed
+	class LNodeItem
+	{
+	public:
+		NodePath m_ParentPath; // from the roomlist
+		String m_szName;
+		int m_iIndex; // among the children of the parent
+		bool m_bSpatial;
+		Transform m_Transform;
+		String m_szPath; // the scene file
+
+		// re-added in child order, so the indices are valid
+		bool operator<(const LNodeItem &o) const {return m_iIndex < o.m_iIndex;}
+	};
+
+	// a SOB within a freed subtree
+	class LSOBPath
+	{
+	public:
+		// from the first SOB of the room, as incremental conversion can renumber the SOBs while unloaded
+		int m_iOffset;
+		NodePath m_Path; // from the roomlist
+	};
+
+	class LResidency
+	{
+	public:
+		eState m_eState;
+		int m_iDistance; // in portals from the camera room, -1 if not reachable
+		uint32_t m_uiBytes; // rough size of the streamable meshes
+		bool m_bEstimated;
+		int m_iPending; // loads not yet finished
+		uint32_t m_uiRequest; // the load in progress, to ignore loads that are no longer wanted
+		LVector<LItem> m_Items;
+		LVector<LNodeItem> m_Nodes;
+		LVector<LSOBPath> m_SOBPaths;
+		LVector<RES> m_Loaded; // held until all the items have loaded, meshes then scenes
+
+		int GetNumLoads() const {return m_Items.size() + m_Nodes.size();}
+	};
+
+	// passed to and from the loader thread
+	class LLoad
+	{
+	public:
+		int m_RoomID;
+		int m_iItem;
+		uint32_t m_uiRequest;
+		int m_iDistance;
+		String m_szPath;
+		RES m_Resource;
+	};
+
+	void Grow(LRoomManager &manager);
+	void CalculateDistances(LRoomManager &manager, int camera_room_id);
+	void Room_Estimate(LRoomManager &manager, int room_id);
+	void Room_Unload(LRoomManager &manager, int room_id);
+	void Room_RequestLoad(LRoomManager &manager, int room_id);
+	void Room_CancelLoad(int room_id);
+	void Room_FinishLoad(LRoomManager &manager, int room_id);
+	void Room_FindSOBs(LRoomManager &manager, int room_id);
+	bool Item_Apply(const LItem &item, const RES &res);
+	bool Node_Apply(LRoomManager &manager, const LNodeItem &item, const RES &res);
+	void Node_Unload(LRoomManager &manager, LResidency &res, Node * pRoot);
+	bool ProcessFinishedLoads(LRoomManager &manager);
+	void ApplyBudget(LRoomManager &manager);
+
+	static uint32_t EstimateMeshBytes(const Ref<Mesh> &rmesh);
+	static MeshInstance * GetStreamableMeshInstance(LRoomManager &manager, int sob_id);
+	static Node * GetStreamableRoot(LRoomManager &manager, int room_id, int sob_id);
+	static bool IsSubtreeStreamable(Node * pNode);
+	static Node * FindNode(LRoomManager &manager, const NodePath &path);
+
+	// LOADER THREAD
+	static void Thread_Func(void * pUserData);
+	void Thread_Loop();
+
+	bool m_bActive;
+	int m_iLoadDistance;
+	int m_iUnloadDistance;
+	uint64_t m_uiBudget;
+
+	int m_iCameraRoom;
+	LVector<LResidency> m_Rooms;
+	LVector<int> m_BFS_Queue;
+
+	// used while unloading a room
+	LVector<int> m_Reattached;
+	LVector<Node *> m_Roots;
+
+	// never reset, so loads from before a reset can't match a new request
+	uint32_t m_uiNextRequest;
+
+	// stats
+	int m_iStats_LoadsCompleted;
+	int m_iStats_LoadFailures;
+	int m_iStats_Unloads;
+
+	// shared with the loader thread, protected by the mutex
+	LVector<LLoad> m_Queued;
+	LVector<LLoad> m_Finished;
+	Mutex * m_pMutex;
+	Semaphore * m_pSemaphore;
+	Thread * m_pThread;
+	volatile bool m_bExit;
+};
@@ -0,0 +1,169 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+#include "lspatial_hash.h"
+
+
+void LCellHash::Clear()
+{
+	m_Heads.clear();
+	m_Next.clear();
+}
+
+int LCellHash::GetFirst(const LCell &cell) const
+{
+	const int * pHead = m_Heads.getptr(cell);
+	if (!pHead)
+		return -1;
+
+	return *pHead;
+}
+
+int LCellHash::Add(const LCell &cell)
+{
+	int item = m_Next.size();
+
+	// link in at the head of the cell
+	m_Next.push_back(GetFirst(cell));
+	m_Heads.set(cell, item);
+
+	return item;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+LVertexHash::LVertexHash(float tolerance)
+{
+	m_fTolerance = tolerance;
+}
+
+void LVertexHash::GetCell(const Vector3 &pt, LCellHash::LCell &cell) const
+{
+	for (int c=0; c<3; c++)
+		cell.m_c[c] = (int32_t) Math::floor(pt[c] / m_fTolerance);
+
+	cell.m_c[3] = 0;
+}
+
+bool LVertexHash::AddIfUnique(const Vector3 &pt)
+{
+	LCellHash::LCell centre;
+	GetCell(pt, centre);
+
+	// check the 27 cells around
+	LCellHash::LCell cell;
+	cell.m_c[3] = 0;
+
+	for (int z=-1; z<=1; z++)
+	{
+		cell.m_c[2] = centre.m_c[2] + z;
+		for (int y=-1; y<=1; y++)
+		{
+			cell.m_c[1] = centre.m_c[1] + y;
+			for (int x=-1; x<=1; x++)
+			{
+				cell.m_c[0] = centre.m_c[0] + x;
+
+				for (int i=m_Hash.GetFirst(cell); i!=-1; i=m_Hash.GetNext(i))
+				{
+					Vector3 ptDiff = pt - m_Pts[i];
+					if (ptDiff.length() < m_fTolerance)
+						return false;
+				}
+			}
+		}
+	}
+
+	m_Hash.Add(centre);
+	m_Pts.push_back(pt);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+LPlaneHash::LPlaneHash(float dist_tolerance, float min_dot)
+{
+	m_fDistTolerance = dist_tolerance;
+	m_fMinDot = min_dot;
+
+	// for unit normals |a - b| squared is 2 - 2 (a.b)
+	m_fNormalCellSize = Math::sqrt(MAX(2.0f - (2.0f * min_dot), 0.0f));
+
+	// prevent tiny cells for very tight tolerances
+	m_fNormalCellSize = MAX(m_fNormalCellSize, 0.01f);
+	m_fDistTolerance = MAX(m_fDistTolerance, 0.0001f);
+}
+
+void LPlaneHash::GetCell(const Plane &p, LCellHash::LCell &cell) const
+{
+	for (int c=0; c<3; c++)
+		cell.m_c[c] = (int32_t) Math::floor(p.normal[c] / m_fNormalCellSize);
+
+	cell.m_c[3] = (int32_t) Math::floor(p.d / m_fDistTolerance);
+}
+
+// same test as the original linear search
+bool LPlaneHash::IsDuplicate(const Plane &a, const Plane &b) const
+{
+	if (Math::abs(a.d - b.d) > m_fDistTolerance)
+		return false;
+
+	float dot = a.normal.dot(b.normal);
+	if (dot < m_fMinDot)
+		return false;
+
+	return true;
+}
+
+bool LPlaneHash::AddIfUnique(const Plane &p)
+{
+	LCellHash::LCell centre;
+	GetCell(p, centre);
+
+	// check the 81 cells around, in normal and distance
+	LCellHash::LCell cell;
+
+	for (int w=-1; w<=1; w++)
+	{
+		cell.m_c[3] = centre.m_c[3] + w;
+		for (int z=-1; z<=1; z++)
+		{
+			cell.m_c[2] = centre.m_c[2] + z;
+			for (int y=-1; y<=1; y++)
+			{
+				cell.m_c[1] = centre.m_c[1] + y;
+				for (int x=-1; x<=1; x++)
+				{
+					cell.m_c[0] = centre.m_c[0] + x;
+
+					for (int i=m_Hash.GetFirst(cell); i!=-1; i=m_Hash.GetNext(i))
+					{
+						if (IsDuplicate(p, m_Planes[i]))
+							return false;
+					}
+				}
+			}
+		}
+	}
+
+	m_Hash.Add(centre);
+	m_Planes.push_back(p);
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+#include "core/hash_map.h"
+#include "core/hashfuncs.h"
+#include "core/math/plane.h"
+
+// Finds near duplicates without testing against every item so far. Items are hashed into a grid of cells
+// at least as big as the tolerance, so anything within tolerance of an item is in the same or a neighbouring cell.
+// Items in the same cell are chained together.
+class LCellHash
+{
+public:
+	class LCell
+	{
+	public:
+		int32_t m_c[4];
+		bool operator==(const LCell &o) const {return (m_c[0] == o.m_c[0]) && (m_c[1] == o.m_c[1]) && (m_c[2] == o.m_c[2]) && (m_c[3] == o.m_c[3]);}
+	};
+
+	struct LCellHasher
+	{
+		static _FORCE_INLINE_ uint32_t hash(const LCell &cell)
+		{
+			uint32_t h = hash_djb2_one_32(cell.m_c[0]);
+			h = hash_djb2_one_32(cell.m_c[1], h);
+			h = hash_djb2_one_32(cell.m_c[2], h);
+			return hash_djb2_one_32(cell.m_c[3], h);
+		}
+	};
+
+	void Clear();
+
+	// -1 if the cell is empty
+	int GetFirst(const LCell &cell) const;
+	int GetNext(int item) const {return m_Next[item];}
+
+	// items are numbered in the order they are added
+	int Add(const LCell &cell);
+
+private:
+	HashMap<LCell, int, LCellHasher> m_Heads;
+	LVector<int> m_Next;
+};
+
+// points closer than the tolerance are duplicates
+class LVertexHash
+{
+public:
+	LVertexHash(float tolerance);
+
+	// returns false if a duplicate of a point already added, else adds the point
+	bool AddIfUnique(const Vector3 &pt);
+
+private:
+	void GetCell(const Vector3 &pt, LCellHash::LCell &cell) const;
+
+	float m_fTolerance;
+	LCellHash m_Hash;
+	LVector<Vector3> m_Pts;
+};
+
+// planes are duplicates if their distances are within the tolerance and their (unit) normals point the same way
+class LPlaneHash
+{
+public:
+	LPlaneHash(float dist_tolerance, float min_dot);
+
+	// returns false if a duplicate of a plane already added, else adds the plane
+	bool AddIfUnique(const Plane &p);
+
+private:
+	void GetCell(const Plane &p, LCellHash::LCell &cell) const;
+	bool IsDuplicate(const Plane &a, const Plane &b) const;
+
+	float m_fDistTolerance;
+	float m_fMinDot;
+	// the largest distance between normals within min_dot
+	float m_fNormalCellSize;
+
+	LCellHash m_Hash;
+	LVector<Plane> m_Planes;
+};
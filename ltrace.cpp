@@ -30,7 +30,7 @@
 
 
 //void LTrace::Trace_Prepare(LRoomManager &manager, const LCamera &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_DOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_DOBs, LVector<int> &visible_Rooms)
-void LTrace::Trace_Prepare(LRoomManager &manager, const LSource &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_Rooms)
+void LTrace::Trace_Prepare(LRoomManager &manager, const LSource &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_Rooms, LVector<int> * pVisible_DOBs)
 {
 	m_pManager = &manager;
 	m_pCamera = &cam;
@@ -42,114 +42,372 @@ void LTrace::Trace_Prepare(LRoomManager &manager, const LSource &cam, Lawn::LBit
 //	m_pBF_DOBs = &BF_DOBs;
 	m_pBF_Rooms = &BF_Rooms;
 	m_pVisible_SOBs = &visible_SOBs;
-//	m_pVisible_DOBs = &visible_DOBs;
+	m_pVisible_DOBs = pVisible_DOBs;
 	m_pVisible_Rooms = &visible_Rooms;
+	m_pPool = &manager.m_Pool;
+	m_fSourceRadius = 0.0f;
 }
 
-void LTrace::CullSOBs(LRoom &room, const LVector<Plane> &planes)
+void LTraceScratch::Create(int num_rooms, int num_sobs)
 {
-	// clip all objects in this room to the clipping planes
-	int last_sob = room.m_iFirstSOB + room.m_iNumSOBs;
-	for (int n=room.m_iFirstSOB; n<last_sob; n++)
-	{
-		LSob &sob = LMAN->m_SOBs[n];
+	m_BF_SOBs.Create(num_sobs);
+	m_BF_Rooms.Create(num_rooms);
+	m_Visible_SOBs.clear();
+	m_Visible_Rooms.clear();
+	m_Pool.Reset();
+}
+
+// returns false if the source has no light volume (e.g. directional lights)
+bool LTrace::LightVolume_Prepare()
+{
+	const LSource &source = *m_pCamera;
+
+	if ((source.m_eType != LSource::ST_SPOTLIGHT) && (source.m_eType != LSource::ST_OMNI))
+		return false;
+
+	// spread is the half angle, a wide spotlight is treated as a sphere
+	m_bLightCone = (source.m_eType == LSource::ST_SPOTLIGHT) && (source.m_fSpread < 90.0f);
+
+	float angle = Math::deg2rad(source.m_fSpread);
+	m_fLightCone_Sin = Math::sin(angle);
+	m_fLightCone_Cos = Math::cos(angle);
+
+	return true;
+}
+
+// returns true if the sphere is entirely outside the light range or the spotlight cone
+bool LTrace::LightVolume_CullSphere(const Vector3 &ptCentre, float radius) const
+{
+	const LSource &source = *m_pCamera;
+
+	Vector3 ptOffset = ptCentre - source.m_ptPos;
+	float dist_sq = ptOffset.length_squared();
+
+	// range
+	float max_dist = source.m_fRange + radius;
+	if ((source.m_fRange < FLT_MAX) && (dist_sq > (max_dist * max_dist)))
+		return true;
+
+	if (!m_bLightCone)
+		return false;
+
+	// distance along the cone axis, and from the axis
+	float along = ptOffset.dot(source.m_ptDir);
+	float across = Math::sqrt(MAX(dist_sq - (along * along), 0.0f));
+
+	// signed distance from the cone surface
+	float dist_cone = (across * m_fLightCone_Cos) - (along * m_fLightCone_Sin);
+	if (dist_cone > radius)
+		return true;
 
-		//LPRINT_RUN(2, "sob " + itos(n) + " " + sob.GetSpatial()->get_name());
+	// behind the apex
+	if (along < -radius)
+		return true;
 
-		// already determined to be visible through another portal
-		if (m_pBF_SOBs->GetBit(n))
+	return false;
+}
+
+bool LTrace::LightVolume_CullAABB(const AABB &bb) const
+{
+	const LSource &source = *m_pCamera;
+
+	// exact test for the range sphere against the box
+	if (source.m_fRange < FLT_MAX)
+	{
+		Vector3 ptMaxs = bb.position + bb.size;
+		float dist_sq = 0.0f;
+
+		for (int c=0; c<3; c++)
 		{
-			//LPRINT_RUN(2, "\talready visible");
-			continue;
+			float d = 0.0f;
+			if (source.m_ptPos[c] < bb.position[c])
+				d = bb.position[c] - source.m_ptPos[c];
+			else if (source.m_ptPos[c] > ptMaxs[c])
+				d = source.m_ptPos[c] - ptMaxs[c];
+
+			dist_sq += d * d;
 		}
 
-		bool bShow = true;
+		if (dist_sq > (source.m_fRange * source.m_fRange))
+			return true;
+	}
 
+	if (!m_bLightCone)
+		return false;
 
-		// estimate the radius .. for now
-		const AABB &bb = sob.m_aabb;
+	// cone against the bounding sphere of the box
+	Vector3 ptHalfSize = bb.size * 0.5f;
+	return LightVolume_CullSphere(bb.position + ptHalfSize, ptHalfSize.length());
+}
 
-//		print("\t\t\tculling object " + pObj->get_name());
+// The shadow volume of a caster is its bound extruded away from the light (along the light direction
+// for directional lights, out to the light range for spot and omni lights).
+// Returns true if the shadow volume is entirely outside one of the camera frustum planes, in which case
+// the caster can't cast a shadow into view.
+bool LTrace::ShadowVolume_Cull(const AABB &bb) const
+{
+	const LVector<Plane> &frustum = LMAN->m_MainCamera.m_Planes;
+	const LSource &source = *m_pCamera;
 
-		for (int p=0; p<planes.size(); p++)
+	Vector3 pts[16];
+	for (int n=0; n<8; n++)
+		pts[n] = bb.get_endpoint(n);
+
+	int nPts = 16;
+
+	if (source.m_eType == LSource::ST_DIRECTIONAL)
+	{
+		// extruded to infinity, so can only be culled by planes the light direction doesn't head into
+		for (int p=0; p<frustum.size(); p++)
 		{
-//				float dist = planes[p].distance_to(pt);
-//				print("\t\t\t\t" + itos(p) + " : dist " + String(Variant(dist)));
+			const Plane &pl = frustum[p];
+			if (pl.normal.dot(source.m_ptDir) < 0.0f)
+				continue;
 
-			float r_min, r_max;
-			bb.project_range_in_plane(planes[p], r_min, r_max);
+			bool bOutside = true;
+			for (int n=0; n<8; n++)
+			{
+				if (pl.distance_to(pts[n]) <= 0.0f)
+				{
+					bOutside = false;
+					break;
+				}
+			}
+
+			if (bOutside)
+				return true;
+		}
+
+		return false;
+	}
+
+	// no range, can't bound the shadow
+	if (source.m_fRange >= FLT_MAX)
+		return false;
+
+	// The shadow volume is within the convex hull of the corners, and the corners projected out to the light range.
+	// The projection is pushed out further by 1 / cos of the angle the caster subtends, so that the hull
+	// encloses the curved far cap of the shadow.
+	Vector3 ptHalfSize = bb.size * 0.5f;
+	float radius = ptHalfSize.length();
+	float centre_dist = (bb.position + ptHalfSize).distance_to(source.m_ptPos);
 
-	//		print("\t\t\t\t" + itos(p) + " : r_min " + String(Variant(r_min)) + ", r_max " + String(Variant(r_max)));
+	// light within the caster bound
+	if (centre_dist <= radius)
+		return false;
 
+	float sin_angle = radius / centre_dist;
+	float cos_angle = Math::sqrt(1.0f - (sin_angle * sin_angle));
 
-			if (r_min > 0.0f)
+	float far_dist = MAX(source.m_fRange, centre_dist + radius) / MAX(cos_angle, 0.01f);
+
+	for (int n=0; n<8; n++)
+	{
+		Vector3 ptDir = (pts[n] - source.m_ptPos).normalized();
+		pts[n + 8] = source.m_ptPos + (ptDir * far_dist);
+	}
+
+	for (int p=0; p<frustum.size(); p++)
+	{
+		const Plane &pl = frustum[p];
+
+		bool bOutside = true;
+		for (int n=0; n<nPts; n++)
+		{
+			if (pl.distance_to(pts[n]) <= 0.0f)
 			{
-				//LPRINT_RUN(2, "\tout of view");
-				bShow = false;
+				bOutside = false;
 				break;
 			}
 		}
 
-		if (bShow)
+		if (bOutside)
+			return true;
+	}
+
+	return false;
+}
+
+void LTrace::CullSOBs(LRoom &room, const LVector<Plane> &planes)
+{
+	// clip all objects in this room to the clipping planes
+	int last_sob = room.m_iFirstSOB + room.m_iNumSOBs;
+	for (int n=room.m_iFirstSOB; n<last_sob; n++)
+		CullSOB(n, planes);
+}
+
+void LTrace::CullSOB(int sob_id, const LVector<Plane> &planes)
+{
+	const LSob &sob = LMAN->m_SOBs[sob_id];
+
+	//LPRINT_RUN(2, "sob " + itos(sob_id) + " " + sob.GetSpatial()->get_name());
+
+	// already determined to be visible through another portal
+	if (m_pBF_SOBs->GetBit(sob_id))
+	{
+		//LPRINT_RUN(2, "\talready visible");
+		return;
+	}
+
+	// estimate the radius .. for now
+	const AABB &bb = LMAN->m_SOB_AABBs[sob_id];
+
+//	print("\t\t\tculling object " + pObj->get_name());
+
+	for (int p=0; p<planes.size(); p++)
+	{
+//		float dist = planes[p].distance_to(pt);
+//		print("\t\t\t\t" + itos(p) + " : dist " + String(Variant(dist)));
+
+		float r_min, r_max;
+		bb.project_range_in_plane(planes[p], r_min, r_max);
+
+//		print("\t\t\t\t" + itos(p) + " : r_min " + String(Variant(r_min)) + ", r_max " + String(Variant(r_max)));
+
+		if (r_min > 0.0f)
 		{
-			// sob is renderable and visible (not shadow only)
-			//LPRINT_RUN(2, "\tin view");
-			m_pBF_SOBs->SetBit(n, true);
-			m_pVisible_SOBs->push_back(n);
+			//LPRINT_RUN(2, "\tout of view");
+			return;
 		}
+	}
+
+	if ((m_TraceFlags & CULL_LIGHT_VOLUME) && LightVolume_CullAABB(bb))
+		return;
 
-	} // for through sobs
+	if (m_TraceFlags & CULL_SHADOW_VOLUME)
+	{
+		LMAN->m_iStats_CasterCandidates++;
+		if (ShadowVolume_Cull(bb))
+		{
+			LMAN->m_iStats_CasterShadowCulled++;
+			return;
+		}
+	}
 
+	// sob is renderable and visible (not shadow only)
+	//LPRINT_RUN(2, "\tin view");
+	m_pBF_SOBs->SetBit(sob_id, true);
+	m_pVisible_SOBs->push_back(sob_id);
+}
+
+// static lights, no need to go through the portals as the casters were found at conversion,
+// just cull the baked list against the planes. Dobs can move so are culled in the affected rooms.
+void LTrace::Trace_Baked(const LLight &light, LVector<Plane> &planes)
+{
+	if (m_pCamera->m_eType == LSource::ST_SPOTLIGHT)
+		AddSpotlightPlanes(planes);
+
+	const LBakedVector<uint32_t> &casters = LMAN->m_LightCasters_SOB;
+
+	int last_caster = light.m_FirstCaster + light.m_NumCasters;
+	for (int c=light.m_FirstCaster; c<last_caster; c++)
+		CullSOB(casters[c], planes);
+
+	if (!(m_TraceFlags & CULL_DOBS))
+		return;
+
+	for (int n=0; n<light.m_NumAffectedRooms; n++)
+	{
+		LRoom * pRoom = LMAN->GetRoom(LMAN->Light_GetAffectedRoom(light, n));
+		if (pRoom)
+			CullDOBs(*pRoom, planes);
+	}
 }
 
 void LTrace::CullDOBs(LRoom &room, const LVector<Plane> &planes)
 {
-	// NYI this isn't efficient, there may be more than 1 portal to the same room
-/*
+	// only the camera and light traces supply a dob list
+	if (!m_pVisible_DOBs)
+		return;
+
+	// rooms with many dobs can reject or accept whole cells at a time
+	if (room.m_DobGrid.IsActive())
+	{
+		const LDobGrid &grid = room.m_DobGrid;
+
+		for (int c=0; c<grid.GetNumCells(); c++)
+		{
+			const LVector<int> &dobs = grid.Cell_GetDOBs(c);
+			if (!dobs.size())
+				continue;
+
+			LDobGrid::eCull cull = grid.Cell_Cull(c, planes);
+			if (cull == LDobGrid::CULL_OUTSIDE)
+				continue;
+
+			bool bTest = cull == LDobGrid::CULL_PARTIAL;
+			for (int n=0; n<dobs.size(); n++)
+				CullDOB(dobs[n], planes, bTest);
+		}
+
+		return;
+	}
+
 	// cull DOBs
 	int nDOBs = room.m_DOBs.size();
 
 	for (int n=0; n<nDOBs; n++)
-	{
-		LDob &dob = room.m_DOBs[n];
+		CullDOB(room.m_DOBs[n], planes, true);
+}
+
+void LTrace::CullDOB(int dob_id, const LVector<Plane> &planes, bool bTest)
+{
+	LDob &dob = LMAN->m_DobList.GetDob(dob_id);
 
-		Spatial * pObj = dob.GetSpatial();
+	unsigned int uiFrame = LMAN->m_uiFrameCounter;
+	bool bCasters = (m_TraceFlags & DOBS_ARE_CASTERS) != 0;
 
-		if (pObj)
-		{
-			bool bShow = true;
-			const Vector3 &pt = pObj->get_global_transform().origin;
+	// already determined to be visible through another portal (or by another light)
+	unsigned int &uiFrameHit = bCasters ? dob.m_uiFrameCaster : dob.m_uiFrameVisible;
+	if (uiFrameHit == uiFrame)
+		return;
 
-			float radius = dob.m_fRadius;
+	// the camera dob doesn't cast shadows
+	if (dob_id == LMAN->m_DOB_id_camera)
+		return;
 
-			for (int p=0; p<planes.size(); p++)
-			{
-				float dist = planes[p].distance_to(pt);
-				//print("\t\t\t\t" + itos(p) + " : dist " + String(Variant(dist)));
+	// dobs are treated as spheres
+	const Vector3 &pt = dob.m_ptPos;
+	float radius = dob.m_fRadius;
 
-				if (dist > radius)
-				{
-					bShow = false;
-					break;
-				}
-			}
+	if (bTest)
+	{
+		for (int p=0; p<planes.size(); p++)
+		{
+			float dist = planes[p].distance_to(pt);
 
-			if (bShow)
+			if (dist > radius)
 			{
-				LPRINT_RUN(1, "\tDOB " + pObj->get_name() + " visible");
-				dob.m_bVisible = true;
-			}
-			else
-			{
-				LPRINT_RUN(1, "\tDOB " + pObj->get_name() + " culled");
+				LPRINT_RUN(1, "\tDOB " + itos(dob_id) + " culled");
+				return;
 			}
 		}
-	} // for through dobs
-*/
+	}
+
+	if ((m_TraceFlags & CULL_LIGHT_VOLUME) && LightVolume_CullSphere(pt, radius))
+	{
+		LPRINT_RUN(1, "\tDOB " + itos(dob_id) + " outside light volume");
+		return;
+	}
+
+	if (m_TraceFlags & CULL_SHADOW_VOLUME)
+	{
+		LMAN->m_iStats_CasterCandidates++;
+		if (ShadowVolume_Cull(AABB(pt - Vector3(radius, radius, radius), Vector3(radius, radius, radius) * 2.0f)))
+		{
+			LPRINT_RUN(1, "\tDOB " + itos(dob_id) + " shadow out of view");
+			LMAN->m_iStats_CasterShadowCulled++;
+			return;
+		}
+	}
+
+	LPRINT_RUN(1, "\tDOB " + itos(dob_id) + " visible");
+	uiFrameHit = uiFrame;
+	m_pVisible_DOBs->push_back(dob_id);
 }
 
 
-bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun eRun)
+bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun eRun, LTraceScratch * pScratch, float fSourceRadius)
 {
 	m_pManager = &manager;
 
@@ -178,19 +436,26 @@ bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun e
 
 	const LSource &cam = light.m_Source;
 
-	unsigned int pool_member = manager.m_Pool.Request();
+	LPlanesPool &pool = pScratch ? pScratch->m_Pool : manager.m_Pool;
+
+	unsigned int pool_member = pool.Request();
 	assert (pool_member != (unsigned int) -1);
 
-	LVector<Plane> &planes = manager.m_Pool.Get(pool_member);
+	LVector<Plane> &planes = pool.Get(pool_member);
 	planes.clear();
 
 	// we now need to trace either just DOBs (in the case of static lights)
 	// or SOBs and DOBs (in the case of dynamic lights)
 	LRoomManager::LLightRender &lr = manager.m_LightRender;
-	lr.m_BF_Temp_SOBs.Blank();
-	lr.m_Temp_Visible_SOBs.clear();
-	lr.m_BF_Temp_Visible_Rooms.Blank();
-	lr.m_Temp_Visible_Rooms.clear();
+	Lawn::LBitField_Dynamic &BF_SOBs = pScratch ? pScratch->m_BF_SOBs : lr.m_BF_Temp_SOBs;
+	Lawn::LBitField_Dynamic &BF_Rooms = pScratch ? pScratch->m_BF_Rooms : lr.m_BF_Temp_Visible_Rooms;
+	LVector<int> &visible_SOBs = pScratch ? pScratch->m_Visible_SOBs : lr.m_Temp_Visible_SOBs;
+	LVector<int> &visible_Rooms = pScratch ? pScratch->m_Visible_Rooms : lr.m_Temp_Visible_Rooms;
+
+	BF_SOBs.Blank();
+	visible_SOBs.clear();
+	BF_Rooms.Blank();
+	visible_Rooms.clear();
 
 	bool bLightInView = true;
 
@@ -200,18 +465,33 @@ bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun e
 	case LR_ALL:
 		{
 			//Trace_Prepare(manager, cam, lr.m_BF_Temp_SOBs, manager.m_BF_visible_rooms, lr.m_Temp_Visible_SOBs, *manager.m_pCurr_VisibleRoomList);
-			Trace_Prepare(manager, cam, lr.m_BF_Temp_SOBs, lr.m_BF_Temp_Visible_Rooms, lr.m_Temp_Visible_SOBs, lr.m_Temp_Visible_Rooms);
+			// dobs are added straight to the caster list, duplicates are prevented by LDob::m_uiFrameCaster
+			Trace_Prepare(manager, cam, BF_SOBs, BF_Rooms, visible_SOBs, visible_Rooms, &manager.m_CasterList_DOBs);
 
-			Trace_SetFlags(CULL_SOBS | CULL_DOBS | MAKE_ROOM_VISIBLE);
+			Trace_SetFlags(CULL_SOBS | CULL_DOBS | MAKE_ROOM_VISIBLE | DOBS_ARE_CASTERS | CULL_LIGHT_VOLUME);
+			if (manager.m_bShadowVolumeCulling)
+				m_TraceFlags |= CULL_SHADOW_VOLUME;
 
 			// create subset planes of light frustum and camera frustum
 			bLightInView = manager.m_MainCamera.AddCameraLightPlanes(manager, cam, planes);
 		}
 		break;
+	// static lights at runtime, using the casters found at conversion
+	case LR_BAKED:
+		{
+			Trace_Prepare(manager, cam, BF_SOBs, BF_Rooms, visible_SOBs, visible_Rooms, &manager.m_CasterList_DOBs);
+
+			Trace_SetFlags(CULL_SOBS | CULL_DOBS | DOBS_ARE_CASTERS | CULL_LIGHT_VOLUME);
+			if (manager.m_bShadowVolumeCulling)
+				m_TraceFlags |= CULL_SHADOW_VOLUME;
+
+			bLightInView = manager.m_MainCamera.AddCameraLightPlanes(manager, cam, planes);
+		}
+		break;
 	// finding only visible rooms at runtime
 	case LR_ROOMS:
 		{
-			Trace_Prepare(manager, cam, lr.m_BF_Temp_SOBs, lr.m_BF_Temp_Visible_Rooms, lr.m_Temp_Visible_SOBs, lr.m_Temp_Visible_Rooms);
+			Trace_Prepare(manager, cam, BF_SOBs, BF_Rooms, visible_SOBs, visible_Rooms);
 
 			// we ONLY want a list of rooms hit
 			Trace_SetFlags(MAKE_ROOM_VISIBLE);
@@ -220,19 +500,30 @@ bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun e
 	// finding all in preconversion
 	case LR_CONVERT:
 		{
-			Trace_Prepare(manager, cam, lr.m_BF_Temp_SOBs, lr.m_BF_Temp_Visible_Rooms, lr.m_Temp_Visible_SOBs, lr.m_Temp_Visible_Rooms);
+			Trace_Prepare(manager, cam, BF_SOBs, BF_Rooms, visible_SOBs, visible_Rooms);
 
 			// we want sobs but not to touch rooms
-			m_TraceFlags = CULL_SOBS | MAKE_ROOM_VISIBLE; //  | CULL_DOBS | TOUCH_ROOMS;
+			m_TraceFlags = CULL_SOBS | MAKE_ROOM_VISIBLE | CULL_LIGHT_VOLUME; //  | CULL_DOBS | TOUCH_ROOMS;
 		}
 		break;
 	}
 
+	// prepare defaults to the manager pool
+	m_pPool = &pool;
+	m_fSourceRadius = fSourceRadius;
+
+	if ((m_TraceFlags & CULL_LIGHT_VOLUME) && !LightVolume_Prepare())
+		m_TraceFlags &= ~CULL_LIGHT_VOLUME;
+
 
 	if (bLightInView)
 	{
+		if (eRun == LR_BAKED)
+		{
+			Trace_Baked(light, planes);
+		}
 		// non area light
-		if (pRoom)
+		else if (pRoom)
 		{
 			Trace_Begin(*pRoom, planes);
 		}
@@ -266,7 +557,7 @@ bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun e
 			// go through each affected room
 			for (int r=0; r<light.m_NumAffectedRooms; r++)
 			{
-				int room_id = light.m_AffectedRooms[r];
+				int room_id = manager.Light_GetAffectedRoom(light, r);
 				LRoom * pRoom = manager.GetRoom(room_id);
 
 				// should not happen, assert?
@@ -280,7 +571,7 @@ bool LTrace::Trace_Light(LRoomManager &manager, const LLight &light, eLightRun e
 	} // if light in view
 
 	// we no longer need these planes
-	manager.m_Pool.Free(pool_member);
+	pool.Free(pool_member);
 
 	return bLightInView;
 }
@@ -399,8 +690,9 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 		return;
 	}
 
-	// for debugging
-	Lawn::LDebug::m_iTabDepth = depth;
+	// for debugging (only when verbose, light traces at conversion can run on several threads)
+	if (!Lawn::LDebug::m_bRunning)
+		Lawn::LDebug::m_iTabDepth = depth;
 	LPRINT_RUN(2, "");
 
 	LPRINT_RUN(2, "ROOM '" + itos(room.m_RoomID) + " : " + room.get_name() + "' planes " + itos(planes.size()) + " portals " + itos(room.m_iNumPortals) );
@@ -409,7 +701,7 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 	//assert (manager.m_uiFrameCounter > m_uiFrameTouched);
 
 	// first touch
-	DetectFirstTouch(room);
+	DetectFirstTouch(room, depth);
 
 	if (m_TraceFlags & CULL_SOBS)
 		CullSOBs(room, planes);
@@ -441,9 +733,10 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 		// NEW! I've come up with a much better way of culling portals by direction to camera...
 		// instead of using dot product with a varying view direction, we simply find which side of the portal
 		// plane the camera is on! If it is behind, the portal can be seen through, if in front, it can't! :)
+		// A source with a radius is only culled if wholly in front.
 		float dist_cam = port.m_Plane.distance_to(m_pCamera->m_ptPos);
 		LPRINT_RUN(2, "\tPORTAL " + itos (port_num) + " (" + itos(port_id) + ") " + port.get_name());
-		if (dist_cam >= 0.0f) // was >
+		if (dist_cam >= m_fSourceRadius) // was >
 		{
 			LPRINT_RUN(2, "\t\tCULLED (back facing)");
 			continue;
@@ -475,7 +768,7 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 
 		// while clipping to the planes we maintain a list of partial planes, so we can add them to the
 		// recursive next iteration of planes to check
-		static LVector<int> partial_planes;
+		LVector<int> &partial_planes = m_PartialPlanes;
 		partial_planes.clear();
 
 		// for portals, we want to ignore the near clipping plane, as we might be right on the edge of a doorway
@@ -514,11 +807,11 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 		}
 
 		// else recurse into that portal
-		unsigned int uiPoolMem = LMAN->m_Pool.Request();
+		unsigned int uiPoolMem = m_pPool->Request();
 		if (uiPoolMem != (unsigned int) -1)
 		{
 			// get a vector of planes from the pool
-			LVector<Plane> &new_planes = LMAN->m_Pool.Get(uiPoolMem);
+			LVector<Plane> &new_planes = m_pPool->Get(uiPoolMem);
 			new_planes.clear();
 
 			// NEW!! if portal is totally inside the planes, don't copy the old planes
@@ -535,7 +828,9 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 			// add the planes for the portal
 			// NOTE that we can also optimize by not adding portal planes for edges that
 			// were behind a partial plane. NYI
-			port.AddPlanes(*LMAN, m_pCamera->m_ptPos, new_planes);
+			// a source with a radius that may be on either side of the portal can't be limited by its edges
+			if (dist_cam <= -m_fSourceRadius)
+				port.AddPlanes(*LMAN, m_pCamera->m_ptPos, new_planes, m_fSourceRadius);
 
 
 			if (pLinkedRoom)
@@ -543,11 +838,12 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 				Trace_Recursive(depth+1, *pLinkedRoom, new_planes, 0);
 				//pLinkedRoom->DetermineVisibility_Recursive(manager, depth + 1, cam, new_planes, 0);
 				// for debugging need to reset tab depth
-				Lawn::LDebug::m_iTabDepth = depth;
+				if (!Lawn::LDebug::m_bRunning)
+					Lawn::LDebug::m_iTabDepth = depth;
 			}
 
 			// we no longer need these planes
-			LMAN->m_Pool.Free(uiPoolMem);
+			m_pPool->Free(uiPoolMem);
 		}
 		else
 		{
@@ -563,7 +859,7 @@ void LTrace::Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &plane
 
 }
 
-void LTrace::DetectFirstTouch(LRoom &room)
+void LTrace::DetectFirstTouch(LRoom &room, int depth)
 {
 	// mark if not reached yet on this trace
 	if (!m_pBF_Rooms->GetBit(room.m_RoomID))
@@ -580,18 +876,21 @@ void LTrace::DetectFirstTouch(LRoom &room)
 		if (m_TraceFlags & TOUCH_ROOMS)
 		{
 			if (room.m_uiFrameTouched < LMAN->m_uiFrameCounter)
-				FirstTouch(room);
+				FirstTouch(room, depth);
 		}
 	}
 
 }
 
 
-void LTrace::FirstTouch(LRoom &room)
+void LTrace::FirstTouch(LRoom &room, int depth)
 {
 	// set the frame counter
 	room.m_uiFrameTouched = LMAN->m_uiFrameCounter;
 
+	// number of portals from the camera room (via the first route found)
+	room.m_iFrameDepth = depth;
+
 	// show this room and add to visible list of rooms
 	room.Room_MakeVisible(true);
 
@@ -21,12 +21,27 @@
 //	SOFTWARE.
 
 #include "lvector.h"
+#include "lbitfield_dynamic.h"
+#include "lplanes_pool.h"
 
 class LSource;
 class LRoomManager;
 class LRoom;
 class LLight;
-namespace Lawn {class LBitField_Dynamic;}
+
+// Light traces normally use the temporaries in the manager. When tracing several lights
+// at once on different threads (during conversion) each thread supplies its own instead.
+class LTraceScratch
+{
+public:
+	void Create(int num_rooms, int num_sobs);
+
+	Lawn::LBitField_Dynamic m_BF_SOBs;
+	Lawn::LBitField_Dynamic m_BF_Rooms;
+	LVector<int> m_Visible_SOBs;
+	LVector<int> m_Visible_Rooms;
+	LPlanesPool m_Pool;
+};
 
 class LTrace
 {
@@ -38,6 +53,9 @@ public:
 		TOUCH_ROOMS = 1 << 2,
 		MAKE_ROOM_VISIBLE = 1 << 3,
 		DONT_TRACE_PORTALS = 1 << 4,
+		DOBS_ARE_CASTERS = 1 << 5, // light traces, culled dobs are shadow casters rather than visible
+		CULL_LIGHT_VOLUME = 1 << 6, // light traces, also cull objects against the light range sphere and spotlight cone
+		CULL_SHADOW_VOLUME = 1 << 7, // runtime light traces, only keep casters whose shadow can fall in the camera frustum
 	};
 
 	enum eLightRun
@@ -45,25 +63,40 @@ public:
 		LR_ALL, // runtime find all shadow casters
 		LR_ROOMS, // find affected rooms
 		LR_CONVERT, // initial conversion
+		LR_BAKED, // runtime static lights, cull the casters found on conversion
 	};
 
-	void Trace_Prepare(LRoomManager &manager, const LSource &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_Rooms);
+	// visible_DOBs is only supplied for the camera trace
+	void Trace_Prepare(LRoomManager &manager, const LSource &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_Rooms, LVector<int> * pVisible_DOBs = 0);
 //	void Trace_Prepare(LRoomManager &manager, const LCamera &cam, Lawn::LBitField_Dynamic &BF_SOBs, Lawn::LBitField_Dynamic &BF_DOBs, Lawn::LBitField_Dynamic &BF_Rooms, LVector<int> &visible_SOBs, LVector<int> &visible_DOBs, LVector<int> &visible_Rooms);
 
 	void Trace_SetFlags(unsigned int flags) {m_TraceFlags = flags;}
 	void Trace_Begin(LRoom &room, LVector<Plane> &planes);
 
 	// simpler method of doing a trace for lights, no need to call prepare and begin
-	bool Trace_Light(LRoomManager &manager, const LLight &light, eLightRun eRun);
+	// the results are in the manager light render temporaries, or in the scratch if supplied
+	// fSourceRadius traces from anywhere within that distance of the light, e.g. to cover a moving light until it is traced again
+	bool Trace_Light(LRoomManager &manager, const LLight &light, eLightRun eRun, LTraceScratch * pScratch = 0, float fSourceRadius = 0.0f);
 
 private:
 	void AddSpotlightPlanes(LVector<Plane> &planes) const;
 	void Trace_Recursive(int depth, LRoom &room, const LVector<Plane> &planes, int first_portal_plane);
 
+	void Trace_Baked(const LLight &light, LVector<Plane> &planes);
+
+	// the planes only approximate the light volume, these are more accurate tests
+	bool LightVolume_Prepare();
+	bool LightVolume_CullAABB(const AABB &bb) const;
+	bool LightVolume_CullSphere(const Vector3 &ptCentre, float radius) const;
+	bool ShadowVolume_Cull(const AABB &bb) const;
+
 	void CullSOBs(LRoom &room, const LVector<Plane> &planes);
+	void CullSOB(int sob_id, const LVector<Plane> &planes);
 	void CullDOBs(LRoom &room, const LVector<Plane> &planes);
-	void FirstTouch(LRoom &room);
-	void DetectFirstTouch(LRoom &room);
+	// bTest false if already known to be within the planes
+	void CullDOB(int dob_id, const LVector<Plane> &planes, bool bTest);
+	void FirstTouch(LRoom &room, int depth);
+	void DetectFirstTouch(LRoom &room, int depth);
 
 
 	LRoomManager * m_pManager;
@@ -74,8 +107,22 @@ private:
 	Lawn::LBitField_Dynamic * m_pBF_Rooms;
 
 	LVector<int> * m_pVisible_SOBs;
-	//LVector<int> * m_pVisible_DOBs;
+	LVector<int> * m_pVisible_DOBs;
 	LVector<int> * m_pVisible_Rooms;
 
+	// planes are requested from the manager pool, unless tracing with a scratch
+	LPlanesPool * m_pPool;
+
+	// which planes the current portal partially clips, only used before recursing
+	LVector<int> m_PartialPlanes;
+
 	unsigned int m_TraceFlags;
+
+	// the source may be anywhere within this distance of its position
+	float m_fSourceRadius;
+
+	// light volume, set up by LightVolume_Prepare
+	bool m_bLightCone;
+	float m_fLightCone_Sin;
+	float m_fLightCone_Cos;
 };
@@ -25,6 +25,7 @@
 #include "core/vector.h"
 #include <assert.h>
 #include <vector>
+#include <algorithm>
 
 template <class T> class LVector
 {
@@ -145,6 +146,12 @@ public:
 		}
 	}
 
+	// ascending, using operator <
+	void sort()
+	{
+		std::sort(m_Vec.begin(), m_Vec.begin() + m_iSize);
+	}
+
 	void copy_from(const LVector<T> &o)
 	{
 		// make sure enough space
@@ -238,3 +245,120 @@ private:
 	int m_iSize;
 };
 
+
+// Read only at runtime. Either owns its data (built up on conversion with push_back),
+// or refers to data owned elsewhere, e.g. a shared LBakedData block.
+template <class T> class LBakedVector
+{
+public:
+	const T& operator[](unsigned int ui) const
+	{
+#ifdef DEBUG_ENABLED
+		assert (ui < (unsigned int) m_iSize);
+#endif
+		return m_pData[ui];
+	}
+
+	int size() const {return m_iSize;}
+	bool is_external() const {return m_bExternal;}
+
+	void push_back(const T &t)
+	{
+		assert (!m_bExternal);
+		m_Owned.push_back(t);
+		m_pData = &m_Owned[0];
+		m_iSize = m_Owned.size();
+	}
+
+	// only owned data can be changed, call make_owned first if the data may be external
+	void set(unsigned int ui, const T &t)
+	{
+		assert (!m_bExternal);
+		m_Owned.set(ui, t);
+	}
+
+	// replaces the contents, so external data is simply dropped
+	void resize(int s)
+	{
+		if (m_bExternal)
+			clear();
+
+		m_Owned.resize(s);
+		m_pData = s ? &m_Owned[0] : 0;
+		m_iSize = s;
+	}
+
+	// copy external data so it can be changed
+	void make_owned()
+	{
+		if (!m_bExternal)
+			return;
+
+		m_Owned.resize(m_iSize);
+		for (int n=0; n<m_iSize; n++)
+			m_Owned[n] = m_pData[n];
+
+		m_pData = m_iSize ? &m_Owned[0] : 0;
+		m_bExternal = false;
+	}
+
+	void copy_from(const LVector<T> &o)
+	{
+		m_Owned.copy_from(o);
+		m_pData = o.size() ? &m_Owned[0] : 0;
+		m_iSize = o.size();
+		m_bExternal = false;
+	}
+
+	// the data must outlive the vector, or until clear is called
+	void set_external(const T * pData, int num)
+	{
+		m_Owned.clear(true);
+		m_pData = pData;
+		m_iSize = num;
+		m_bExternal = true;
+	}
+
+	void clear(bool bCompact = false)
+	{
+		m_Owned.clear(bCompact);
+		m_pData = 0;
+		m_iSize = 0;
+		m_bExternal = false;
+	}
+
+	LBakedVector()
+	{
+		m_pData = 0;
+		m_iSize = 0;
+		m_bExternal = false;
+	}
+
+	// copies share external data, but owned data is copied, so the pointer must be fixed up
+	LBakedVector(const LBakedVector<T> &o)
+	{
+		m_pData = 0;
+		m_iSize = 0;
+		m_bExternal = false;
+		*this = o;
+	}
+
+	LBakedVector<T> &operator=(const LBakedVector<T> &o)
+	{
+		if (this == &o)
+			return *this;
+
+		if (o.m_bExternal)
+			set_external(o.m_pData, o.m_iSize);
+		else
+			copy_from(o.m_Owned);
+
+		return *this;
+	}
+
+private:
+	LVector<T> m_Owned;
+	const T * m_pData;
+	int m_iSize;
+	bool m_bExternal;
+};
@@ -0,0 +1,83 @@
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+#include "lworker_pool.h"
+#include "core/os/os.h"
+#include "core/os/thread.h"
+#include "core/safe_refcount.h"
+
+
+int LWorkerPool::GetDefaultNumWorkers()
+{
+	int num = OS::get_singleton()->get_processor_count();
+	return CLAMP(num, 1, 16);
+}
+
+void LWorkerPool::Run(WorkFunc pFunc, void * pUserData, int num_items, int num_workers)
+{
+	m_pFunc = pFunc;
+	m_pUserData = pUserData;
+	m_iNumItems = num_items;
+	m_uiNextItem = 0;
+
+	// no point having more workers than items
+	num_workers = MIN(num_workers, num_items);
+
+	LVector<LWorker> workers;
+	LVector<Thread *> threads;
+	workers.resize(MAX(num_workers, 1));
+
+	// the calling thread is worker 0
+	for (int n=1; n<num_workers; n++)
+	{
+		LWorker &w = workers[n];
+		w.m_pPool = this;
+		w.m_iWorker = n;
+		threads.push_back(Thread::create(Thread_Func, &w));
+	}
+
+	Work(0);
+
+	for (int n=0; n<threads.size(); n++)
+	{
+		Thread::wait_to_finish(threads[n]);
+		memdelete(threads[n]);
+	}
+}
+
+void LWorkerPool::Thread_Func(void * pUserData)
+{
+	LWorker * pWorker = (LWorker *) pUserData;
+	pWorker->m_pPool->Work(pWorker->m_iWorker);
+}
+
+void LWorkerPool::Work(int worker)
+{
+	while (true)
+	{
+		// atomic_increment returns the new value
+		int item = atomic_increment(&m_uiNextItem) - 1;
+		if (item >= m_iNumItems)
+			break;
+
+		m_pFunc(m_pUserData, item, worker);
+	}
+}
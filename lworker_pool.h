@@ -0,0 +1,60 @@
+#pragma once
+
+//	Copyright (c) 2019 Lawnjelly
+
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+
+
+/**
+	@author lawnjelly <lawnjelly@gmail.com>
+*/
+
+#include "lvector.h"
+
+// Runs a function over a range of items on the calling thread plus extra worker threads,
+// and returns when all the items are done. Items are claimed one at a time from a shared counter,
+// so the order they are processed in varies from run to run. For deterministic output each item
+// should only write its own results, and any merging should be done afterwards in item order.
+class LWorkerPool
+{
+public:
+	// item is the index in the range, worker is 0 to num_workers-1, for using per worker scratch data
+	typedef void (*WorkFunc)(void * pUserData, int item, int worker);
+
+	// one per processor, within reason
+	static int GetDefaultNumWorkers();
+
+	// num_workers includes the calling thread, 1 runs everything on the calling thread
+	void Run(WorkFunc pFunc, void * pUserData, int num_items, int num_workers);
+
+private:
+	struct LWorker
+	{
+		LWorkerPool * m_pPool;
+		int m_iWorker;
+	};
+
+	static void Thread_Func(void * pUserData);
+	void Work(int worker);
+
+	WorkFunc m_pFunc;
+	void * m_pUserData;
+	int m_iNumItems;
+	volatile uint32_t m_uiNextItem;
+};
@@ -4,13 +4,15 @@
 
 #include "core/class_db.h"
 #include "lroom_manager.h"
+#include "lbaked_data.h"
 
 
 void register_lportal_types() {
 
 	ClassDB::register_class<LRoomManager>();
+	LBakedData::Shared_Create();
 }
 
 void unregister_lportal_types() {
-   //nothing to do here
+	LBakedData::Shared_Destroy();
 }